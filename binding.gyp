@@ -8,21 +8,33 @@
       ],
       'sources': [
         'src/bindings.cc',
+        'src/bufferarena.cc',
+        'src/bufferpool.cc',
+        'src/commandlist.cc',
         'src/commandqueue.cc',
+        'src/completion.cc',
         'src/context.cc',
         'src/device.cc',
         'src/event.cc',
         'src/exceptions.cc',
         'src/kernel.cc',
+        'src/launchplanner.cc',
+        'src/mapping.cc',
         'src/memoryobject.cc',
         'src/platform.cc',
         'src/program.cc',
+        'src/programcache.cc',
+        'src/programlibrary.cc',
+        'src/range.cc',
         'src/sampler.cc',
+        'src/staging.cc',
         'src/webcl.cc',
+        'src/worksizetuner.cc',
       ],
       'include_dirs' : [
         "<!(node -e \"require('nan')\")",
       ],
+      'cflags_cc' : ['-std=c++11'],
       'conditions': [
         ['OS=="mac"', {
           'make_global_settings': [
@@ -30,8 +42,8 @@
             ['CXX', '/usr/bin/clang++'],
           ],
           "xcode_settings": {
-#              'OTHER_CPLUSPLUSFLAGS' : ['-std=c++11','-stdlib=libc++'],
-#              'OTHER_LDFLAGS': ['-stdlib=libc++'],
+              'OTHER_CPLUSPLUSFLAGS' : ['-std=c++11','-stdlib=libc++'],
+              'OTHER_LDFLAGS': ['-stdlib=libc++'],
               'MACOSX_DEPLOYMENT_TARGET': '10.7'
           },
           'libraries': ['-framework OpenGL', '-framework OpenCL'],
@@ -26,7 +26,10 @@
 
 #include "webcl.h"
 
+#include "bufferarena.h"
+#include "commandlist.h"
 #include "commandqueue.h"
+#include "completion.h"
 #include "context.h"
 #include "device.h"
 #include "event.h"
@@ -34,6 +37,9 @@
 #include "memoryobject.h"
 #include "platform.h"
 #include "program.h"
+#include "programcache.h"
+#include "worksizetuner.h"
+#include "range.h"
 #include "sampler.h"
 #include "exceptions.h"
 
@@ -69,19 +75,33 @@ void init(Handle<Object> target)
   NODE_SET_METHOD(target, "createContext", webcl::createContext);
   NODE_SET_METHOD(target, "waitForEvents", webcl::waitForEvents);
   NODE_SET_METHOD(target, "releaseAll", webcl::releaseAll);
-
+  NODE_SET_METHOD(target, "_setProgramCacheDirectory", webcl::ProgramCache::setCacheDirectory);
+  NODE_SET_METHOD(target, "_getProgramCacheStats", webcl::ProgramCache::getCacheStats);
+  NODE_SET_METHOD(target, "_invalidateProgramCache", webcl::ProgramCache::invalidateCache);
+  NODE_SET_METHOD(target, "_setWorkSizeFile", webcl::WorkSizeTuner::setTuningFile);
+  NODE_SET_METHOD(target, "_getWorkSizeStats", webcl::WorkSizeTuner::getTuningStats);
+  NODE_SET_METHOD(target, "_clearWorkSizes", webcl::WorkSizeTuner::clearTuning);
+
+  webcl::Completion::Init();
+  webcl::ProgramCache::Init();
+
+  webcl::CommandList::Init(target);
+  webcl::CommandGraph::Init(target);
   webcl::CommandQueue::Init(target);
   webcl::Context::Init(target);
   webcl::Device::Init(target);
   webcl::Event::Init(target);
   webcl::UserEvent::Init(target);
+  webcl::EventList::Init(target);
   webcl::Kernel::Init(target);
   webcl::MemoryObject::Init(target);
   webcl::WebCLBuffer::Init(target);
+  webcl::BufferArena::Init(target);
   webcl::WebCLImage::Init(target);
   webcl::WebCLImageDescriptor::Init(target);
   webcl::Platform::Init(target);
   webcl::Program::Init(target);
+  webcl::Range::Init(target);
   webcl::Sampler::Init(target);
   webcl::WebCLException::Init(target);
 
@@ -0,0 +1,342 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "bufferarena.h"
+
+using namespace v8;
+using namespace node;
+
+namespace webcl {
+
+uv_mutex_t BuddyAllocator::mutex;
+uv_async_t BuddyAllocator::async;
+std::vector<BuddyAllocator::Freed> BuddyAllocator::freed;
+
+void BuddyAllocator::Init()
+{
+  uv_mutex_init(&mutex);
+  uv_async_init(uv_default_loop(), &async, dispatch);
+
+  // pending blocks don't keep the loop alive
+  uv_unref((uv_handle_t*) &async);
+}
+
+BuddyAllocator::BuddyAllocator(cl_mem parent, size_t capacity, size_t min_block)
+  : parent(parent), capacity(capacity), min_block(min_block), max_order(0),
+    bytes_allocated(0), bytes_requested(0), allocations(0), failures(0)
+{
+  while((min_block<<(max_order+1)) <= capacity && (min_block<<(max_order+1)) > min_block)
+    max_order++;
+  free_blocks.resize(max_order+1);
+
+  // capacity need not be a power of two: cover it with decreasing power of
+  // two blocks. Each one is aligned to its size, and none has a buddy that
+  // can be free at the same order, so they are never merged.
+  size_t offset=0;
+  for(int order=max_order; order>=0; order--) {
+    size_t size=min_block<<order;
+    if(capacity-offset >= size) {
+      free_blocks[order].insert(offset);
+      offset+=size;
+    }
+  }
+}
+
+BuddyAllocator::~BuddyAllocator()
+{
+  ::clReleaseMemObject(parent);
+}
+
+cl_mem BuddyAllocator::allocate(cl_mem_flags flags, size_t size, size_t *offset, cl_int *ret)
+{
+  drain();
+
+  unsigned order=0;
+  while(order<max_order && (min_block<<order) < size)
+    order++;
+
+  unsigned from=order;
+  while(from<=max_order && free_blocks[from].empty())
+    from++;
+  if((min_block<<order) < size || from>max_order) {
+    failures++;
+    *ret=CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    return NULL;
+  }
+
+  // lowest free block keeps allocations packed at the start of the arena
+  size_t off=*free_blocks[from].begin();
+  free_blocks[from].erase(free_blocks[from].begin());
+  while(from>order) {
+    from--;
+    free_blocks[from].insert(off + (min_block<<from));
+  }
+
+  cl_buffer_region region;
+  region.origin=off;
+  region.size=size;
+  cl_mem mem=::clCreateSubBuffer(parent, flags, CL_BUFFER_CREATE_TYPE_REGION, &region, ret);
+  if(*ret!=CL_SUCCESS) {
+    free_blocks[order].insert(off);
+    failures++;
+    return NULL;
+  }
+
+  Block block={ order, size };
+  used_blocks[off]=block;
+  bytes_allocated+=min_block<<order;
+  bytes_requested+=size;
+  allocations++;
+  *offset=off;
+  return mem;
+}
+
+void BuddyAllocator::reclaim(cl_mem mem, cl_mem_flags flags, size_t offset, bool reusable)
+{
+  // each queued block holds a reference on its allocator
+  Freed *f=new Freed();
+  f->allocator=this;
+  f->offset=offset;
+  retain();
+  if(::clSetMemObjectDestructorCallback(mem, destroyed, f)!=CL_SUCCESS) {
+    delete f;
+    ::clReleaseMemObject(mem);
+    freeBlock(offset);
+    release();
+    return;
+  }
+  ::clReleaseMemObject(mem);
+}
+
+void CL_CALLBACK BuddyAllocator::destroyed(cl_mem mem, void *user_data)
+{
+  Freed *f=static_cast<Freed*>(user_data);
+  uv_mutex_lock(&mutex);
+  freed.push_back(*f);
+  uv_mutex_unlock(&mutex);
+  delete f;
+  uv_async_send(&async);
+}
+
+NAUV_WORK_CB(BuddyAllocator::dispatch)
+{
+  drain();
+}
+
+void BuddyAllocator::drain()
+{
+  std::vector<Freed> batch;
+  uv_mutex_lock(&mutex);
+  batch.swap(freed);
+  uv_mutex_unlock(&mutex);
+
+  for(size_t i=0;i<batch.size();i++) {
+    batch[i].allocator->freeBlock(batch[i].offset);
+    batch[i].allocator->release();
+  }
+}
+
+void BuddyAllocator::freeBlock(size_t offset)
+{
+  std::map<size_t, Block>::iterator it=used_blocks.find(offset);
+  if(it==used_blocks.end())
+    return;
+  unsigned order=it->second.order;
+  bytes_allocated-=min_block<<order;
+  bytes_requested-=it->second.size;
+  used_blocks.erase(it);
+
+  // merge with free buddies
+  while(order<max_order) {
+    size_t buddy=offset ^ (min_block<<order);
+    std::set<size_t>::iterator b=free_blocks[order].find(buddy);
+    if(b==free_blocks[order].end())
+      break;
+    free_blocks[order].erase(b);
+    if(buddy<offset) offset=buddy;
+    order++;
+  }
+  free_blocks[order].insert(offset);
+}
+
+BuddyAllocator::Stats BuddyAllocator::stats() const
+{
+  drain();
+
+  Stats s;
+  s.capacity=capacity;
+  s.bytes_allocated=bytes_allocated;
+  s.bytes_requested=bytes_requested;
+  s.largest_free_block=0;
+  for(int order=max_order; order>=0; order--) {
+    if(!free_blocks[order].empty()) {
+      s.largest_free_block=min_block<<order;
+      break;
+    }
+  }
+  s.allocations=allocations;
+  s.failures=failures;
+  return s;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// WebCLBufferArena
+///////////////////////////////////////////////////////////////////////////////
+Persistent<FunctionTemplate> BufferArena::constructor_template;
+
+void BufferArena::Init(Handle<Object> target)
+{
+  NanScope();
+
+  BuddyAllocator::Init();
+
+  // constructor
+  Local<FunctionTemplate> ctor = NanNew<FunctionTemplate>(BufferArena::New);
+  NanAssignPersistent(constructor_template, ctor);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(NanNew("WebCLBufferArena"));
+
+  // prototype
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_allocate", allocate);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_getStats", getStats);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_release", release);
+
+  target->Set(NanNew("WebCLBufferArena"), ctor->GetFunction());
+}
+
+BufferArena::BufferArena(Handle<Object> wrapper) : allocator(NULL)
+{
+}
+
+void BufferArena::Destructor() {
+#ifdef LOGGING
+  cout<<"  Destroying buffer arena"<<endl;
+#endif
+  if(allocator) allocator->release();
+  allocator=NULL;
+}
+
+NAN_METHOD(BufferArena::allocate)
+{
+  NanScope();
+  BufferArena *arena = ObjectWrap::Unwrap<BufferArena>(args.This());
+  size_t size = SizeValue(args[0]);
+  cl_mem_flags flags = args[1]->IsUndefined() ? 0 : args[1]->Uint32Value();
+
+  cl_int ret=CL_SUCCESS;
+  if(!arena->allocator) {
+    ret=CL_INVALID_MEM_OBJECT;
+    REQ_ERROR_THROW(INVALID_MEM_OBJECT);
+  }
+  if(size==0) {
+    ret=CL_INVALID_BUFFER_SIZE;
+    REQ_ERROR_THROW(INVALID_BUFFER_SIZE);
+  }
+
+  size_t offset=0;
+  cl_mem mw = arena->allocator->allocate(flags, size, &offset, &ret);
+  if (ret != CL_SUCCESS) {
+    REQ_ERROR_THROW(INVALID_VALUE);
+    REQ_ERROR_THROW(MISALIGNED_SUB_BUFFER_OFFSET);
+    REQ_ERROR_THROW(MEM_OBJECT_ALLOCATION_FAILURE);
+    REQ_ERROR_THROW(OUT_OF_RESOURCES);
+    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
+    return NanThrowError("UNKNOWN ERROR");
+  }
+
+  WebCLBuffer *buffer=WebCLBuffer::New(mw);
+  buffer->setOwner(arena->allocator, flags, offset);
+  NanReturnValue(NanObjectWrapHandle(buffer));
+}
+
+NAN_METHOD(BufferArena::getStats)
+{
+  NanScope();
+  BufferArena *arena = ObjectWrap::Unwrap<BufferArena>(args.This());
+
+  BuddyAllocator::Stats stats={ 0, 0, 0, 0, 0, 0 };
+  if(arena->allocator)
+    stats=arena->allocator->stats();
+
+  size_t bytes_free=stats.capacity-stats.bytes_allocated;
+
+  Local<Object> obj = NanNew<Object>();
+  obj->Set(JS_STR("capacity"), JS_NUM(stats.capacity));
+  obj->Set(JS_STR("bytesAllocated"), JS_NUM(stats.bytes_allocated));
+  obj->Set(JS_STR("bytesRequested"), JS_NUM(stats.bytes_requested));
+  obj->Set(JS_STR("bytesFree"), JS_NUM(bytes_free));
+  obj->Set(JS_STR("largestFreeBlock"), JS_NUM(stats.largest_free_block));
+  // share of allocated bytes lost to rounding up to a block
+  obj->Set(JS_STR("internalFragmentation"), JS_NUM(stats.bytes_allocated ?
+    1.0 - (double) stats.bytes_requested / stats.bytes_allocated : 0));
+  // share of free bytes not usable by the largest possible allocation
+  obj->Set(JS_STR("externalFragmentation"), JS_NUM(bytes_free ?
+    1.0 - (double) stats.largest_free_block / bytes_free : 0));
+  obj->Set(JS_STR("allocations"), JS_NUM(stats.allocations));
+  obj->Set(JS_STR("failures"), JS_NUM(stats.failures));
+  if(arena->allocator)
+    obj->Set(JS_STR("minBlock"), JS_NUM(arena->allocator->minBlock()));
+
+  NanReturnValue(obj);
+}
+
+NAN_METHOD(BufferArena::release)
+{
+  NanScope();
+  BufferArena *arena = ObjectWrap::Unwrap<BufferArena>(args.This());
+
+  DESTROY_WEBCL_OBJECT(arena);
+
+  NanReturnUndefined();
+}
+
+NAN_METHOD(BufferArena::New)
+{
+  if (!args.IsConstructCall())
+    return NanThrowTypeError("Constructor cannot be called as a function.");
+
+  NanScope();
+  BufferArena *arena = new BufferArena(args.This());
+  arena->Wrap(args.This());
+  registerCLObj(arena);
+  NanReturnValue(args.This());
+}
+
+BufferArena *BufferArena::New(BuddyAllocator *allocator)
+{
+  NanScope();
+
+  Local<Value> arg = NanNew(0);
+  Local<FunctionTemplate> constructorHandle = NanNew(constructor_template);
+  Local<Object> obj = constructorHandle->GetFunction()->NewInstance(1, &arg);
+
+  BufferArena *arena = ObjectWrap::Unwrap<BufferArena>(obj);
+  arena->allocator = allocator;
+
+  return arena;
+}
+
+} // namespace
@@ -0,0 +1,145 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BUFFERARENA_H_
+#define BUFFERARENA_H_
+
+#include "common.h"
+#include "memoryobject.h"
+#include <map>
+#include <set>
+#include <vector>
+
+namespace webcl {
+
+// Buddy allocator over one large cl_mem. Allocations are rounded up to a
+// power of two number of minimum blocks and handed out as sub-buffers, so
+// any number of small buffers costs a single clCreateBuffer. Block offsets
+// are multiples of their size, hence of the minimum block, which is at
+// least CL_DEVICE_MEM_BASE_ADDR_ALIGN as sub-buffers require.
+//
+// A released sub-buffer may still be used by commands in flight or held by
+// recorded command lists, so its block is only freed once the driver
+// destroys it. Destructor callbacks run on driver threads: they queue the
+// block, which the main loop returns to the free lists.
+class BuddyAllocator : public BufferOwner
+{
+
+public:
+  static void Init();
+
+  struct Stats {
+    size_t capacity;
+    size_t bytes_allocated;   // in blocks, including rounding
+    size_t bytes_requested;
+    size_t largest_free_block;
+    double allocations, failures;
+  };
+
+  // takes ownership of parent. min_block is a power of two and capacity a
+  // multiple of it.
+  BuddyAllocator(cl_mem parent, size_t capacity, size_t min_block);
+
+  // returns a sub-buffer of at least size bytes, *offset receives its
+  // offset in the parent buffer
+  cl_mem allocate(cl_mem_flags flags, size_t size, size_t *offset, cl_int *ret);
+
+  // releases a sub-buffer from allocate(), its block is freed once the
+  // driver destroys it, which also covers mappings still open on it
+  void reclaim(cl_mem mem, cl_mem_flags flags, size_t offset, bool reusable);
+
+  Stats stats() const;
+
+  size_t minBlock() const { return min_block; }
+
+protected:
+  ~BuddyAllocator();
+
+private:
+  struct Block {
+    unsigned order;
+    size_t size;
+  };
+
+  // block of a destroyed sub-buffer, queued by a driver thread
+  struct Freed {
+    BuddyAllocator *allocator;
+    size_t offset;
+  };
+
+  // returns a block to the free lists
+  void freeBlock(size_t offset);
+
+  static void CL_CALLBACK destroyed(cl_mem mem, void *user_data);
+  static NAUV_WORK_CB(dispatch);
+  // frees the queued blocks, main thread only
+  static void drain();
+
+  static uv_mutex_t mutex;
+  static uv_async_t async;
+  static std::vector<Freed> freed; // under mutex
+
+  cl_mem parent;
+  size_t capacity;
+  size_t min_block;
+  unsigned max_order;
+
+  // free block offsets of min_block<<order bytes, per order
+  std::vector<std::set<size_t> > free_blocks;
+  std::map<size_t, Block> used_blocks;
+
+  size_t bytes_allocated, bytes_requested;
+  double allocations, failures;
+};
+
+// WebCLBufferArena: JS handle of a BuddyAllocator. Releasing the arena
+// keeps its parent buffer alive until all of its sub-buffers are released.
+class BufferArena : public WebCLObject
+{
+
+public:
+  void Destructor();
+
+  static void Init(v8::Handle<v8::Object> target);
+
+  static BufferArena *New(BuddyAllocator *allocator);
+  static NAN_METHOD(New);
+
+  static NAN_METHOD(allocate);
+  static NAN_METHOD(getStats);
+  static NAN_METHOD(release);
+
+private:
+  BufferArena(v8::Handle<v8::Object> wrapper);
+
+  static v8::Persistent<v8::FunctionTemplate> constructor_template;
+
+  BuddyAllocator *allocator;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,147 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "bufferpool.h"
+
+namespace webcl {
+
+BufferPool::BufferPool(cl_context context)
+  : context(context), closed(false), max_bytes(0), max_per_class(0)
+{
+  ::clRetainContext(context);
+  stats_.hits = stats_.misses = 0;
+  stats_.bytes_cached = stats_.buffers_cached = 0;
+  stats_.bytes_in_use = stats_.buffers_in_use = 0;
+}
+
+BufferPool::~BufferPool()
+{
+  close();
+  ::clReleaseContext(context);
+}
+
+size_t BufferPool::classSize(size_t size)
+{
+  size_t class_size=MIN_CLASS_SIZE;
+  while(class_size<size && class_size<<1)
+    class_size<<=1;
+  return class_size<size ? size : class_size;
+}
+
+cl_mem BufferPool::acquire(cl_mem_flags flags, size_t size, size_t *class_size, cl_int *ret)
+{
+  *class_size=classSize(size);
+  *ret=CL_SUCCESS;
+
+  FreeLists::iterator it=free_lists.find(Key(*class_size, flags));
+  if(it!=free_lists.end() && !it->second.empty()) {
+    cl_mem mem=it->second.back();
+    it->second.pop_back();
+    stats_.hits++;
+    stats_.bytes_cached-=*class_size;
+    stats_.buffers_cached--;
+    stats_.bytes_in_use+=*class_size;
+    stats_.buffers_in_use++;
+    return mem;
+  }
+
+  cl_mem mem=::clCreateBuffer(context, flags, *class_size, NULL, ret);
+  if(*ret==CL_MEM_OBJECT_ALLOCATION_FAILURE || *ret==CL_OUT_OF_RESOURCES) {
+    // cached buffers may be what keeps the device full
+    trim(0);
+    mem=::clCreateBuffer(context, flags, *class_size, NULL, ret);
+  }
+  if(*ret!=CL_SUCCESS)
+    return NULL;
+
+  stats_.misses++;
+  stats_.bytes_in_use+=*class_size;
+  stats_.buffers_in_use++;
+  return mem;
+}
+
+void BufferPool::reclaim(cl_mem mem, cl_mem_flags flags, size_t class_size, bool reusable)
+{
+  stats_.bytes_in_use-=class_size;
+  stats_.buffers_in_use--;
+
+  std::vector<cl_mem> &list=free_lists[Key(class_size, flags)];
+  if(closed || !reusable ||
+     (max_per_class && list.size()>=max_per_class) ||
+     (max_bytes && stats_.bytes_cached+class_size>max_bytes)) {
+    ::clReleaseMemObject(mem);
+    return;
+  }
+
+  list.push_back(mem);
+  stats_.bytes_cached+=class_size;
+  stats_.buffers_cached++;
+}
+
+void BufferPool::setLimits(size_t max_bytes, size_t max_per_class)
+{
+  this->max_bytes=max_bytes;
+  this->max_per_class=max_per_class;
+
+  if(max_per_class) {
+    for(FreeLists::iterator it=free_lists.begin(); it!=free_lists.end(); ++it) {
+      std::vector<cl_mem> &list=it->second;
+      while(list.size()>max_per_class) {
+        ::clReleaseMemObject(list.back());
+        list.pop_back();
+        stats_.bytes_cached-=it->first.first;
+        stats_.buffers_cached--;
+      }
+    }
+  }
+  if(max_bytes)
+    trim(max_bytes);
+}
+
+void BufferPool::trim(size_t max_bytes)
+{
+  // size classes are the first key, so walking backwards frees the
+  // largest buffers first
+  for(FreeLists::reverse_iterator it=free_lists.rbegin();
+      it!=free_lists.rend() && stats_.bytes_cached>max_bytes; ++it) {
+    std::vector<cl_mem> &list=it->second;
+    while(!list.empty() && stats_.bytes_cached>max_bytes) {
+      ::clReleaseMemObject(list.back());
+      list.pop_back();
+      stats_.bytes_cached-=it->first.first;
+      stats_.buffers_cached--;
+    }
+  }
+}
+
+void BufferPool::close()
+{
+  trim(0);
+  free_lists.clear();
+  closed=true;
+}
+
+} // namespace
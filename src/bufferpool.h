@@ -0,0 +1,98 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BUFFERPOOL_H_
+#define BUFFERPOOL_H_
+
+#include "common.h"
+#include "memoryobject.h"
+#include <map>
+#include <vector>
+
+namespace webcl {
+
+// Recycles released cl_mem buffers of a context. Requests are rounded up to
+// a power of two size class and buffers are kept per (flags, size class), so
+// a released buffer is handed out again for any request of the same class
+// without going through clCreateBuffer. The pool is shared by its context
+// and every buffer it handed out, and goes away with the last of them.
+//
+// The pool cannot tell whether commands still use a buffer, so a pooled
+// buffer may only be released once the commands enqueued on it have
+// finished and no command list refers to it any more.
+class BufferPool : public BufferOwner
+{
+
+public:
+  static const size_t MIN_CLASS_SIZE = 256;
+
+  struct Stats {
+    double hits, misses;
+    size_t bytes_cached, buffers_cached;
+    size_t bytes_in_use, buffers_in_use;
+  };
+
+  BufferPool(cl_context context);
+
+  // returns a buffer of at least size bytes, *class_size receives its size
+  cl_mem acquire(cl_mem_flags flags, size_t size, size_t *class_size, cl_int *ret);
+
+  // takes back a buffer from acquire(). The buffer is released instead of
+  // cached if it is not reusable (mapped, or parent of a sub-buffer) or
+  // caching it would exceed the high-water marks.
+  void reclaim(cl_mem mem, cl_mem_flags flags, size_t class_size, bool reusable);
+
+  // high-water marks, 0 meaning unlimited
+  void setLimits(size_t max_bytes, size_t max_per_class);
+
+  // releases cached buffers, largest classes first, until at most
+  // max_bytes are cached
+  void trim(size_t max_bytes);
+
+  // releases all cached buffers, no buffer is cached afterwards
+  void close();
+
+  const Stats& stats() const { return stats_; }
+
+  static size_t classSize(size_t size);
+
+protected:
+  ~BufferPool();
+
+private:
+  typedef std::pair<size_t, cl_mem_flags> Key;
+  typedef std::map<Key, std::vector<cl_mem> > FreeLists;
+
+  cl_context context;
+  bool closed;
+  size_t max_bytes, max_per_class;
+  FreeLists free_lists;
+  Stats stats_;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,551 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "commandlist.h"
+#include "memoryobject.h"
+#include "kernel.h"
+#include "range.h"
+#include <node_buffer.h>
+#include <cstring>
+
+using namespace v8;
+using namespace node;
+
+namespace webcl {
+
+// Returns the backing store of a typed array, array or node Buffer
+static void *getHostPtr(Local<Value> arg)
+{
+  if(arg->IsArray()) {
+    Local<Array> arr=Local<Array>::Cast(arg);
+    return arr->GetIndexedPropertiesExternalArrayData();
+  }
+  if(arg->IsObject()) {
+    Local<Object> obj=arg->ToObject();
+    String::Utf8Value name(obj->GetConstructorName());
+    if(!strcmp("Buffer",*name))
+      return Buffer::Data(obj);
+    return obj->GetIndexedPropertiesExternalArrayData();
+  }
+  return NULL;
+}
+
+// Reads work_dim values of an NDRange argument into dims, returns false on a
+// bad length
+static bool getDims(Local<Value> arg, size_t *dims, cl_uint work_dim)
+{
+  NDRangeArg range;
+  if(!range.set(arg) || range.size()==0 || range.size()<work_dim)
+    return false;
+  for(cl_uint i=0;i<work_dim;i++)
+    dims[i]=range.data()[i];
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Command
+///////////////////////////////////////////////////////////////////////////////
+void Command::retain() const
+{
+  if(src) ::clRetainMemObject(src);
+  if(dst) ::clRetainMemObject(dst);
+  if(kernel) ::clRetainKernel(kernel);
+  for(size_t i=0;i<args.size();i++) {
+    if(args[i].mem) ::clRetainMemObject(args[i].mem);
+    if(args[i].sampler) ::clRetainSampler(args[i].sampler);
+  }
+}
+
+void Command::release() const
+{
+  if(src) ::clReleaseMemObject(src);
+  if(dst) ::clReleaseMemObject(dst);
+  if(kernel) ::clReleaseKernel(kernel);
+  for(size_t i=0;i<args.size();i++) {
+    if(args[i].mem) ::clReleaseMemObject(args[i].mem);
+    if(args[i].sampler) ::clReleaseSampler(args[i].sampler);
+  }
+}
+
+cl_int Command::enqueue(cl_command_queue queue, cl_uint num_events_wait_list,
+                        const cl_event *events_wait_list, cl_event *event) const
+{
+  switch(type) {
+  case WriteBuffer:
+    return ::clEnqueueWriteBuffer(queue, src, blocking, src_offset, size, ptr,
+                                  num_events_wait_list, events_wait_list, event);
+  case ReadBuffer:
+    return ::clEnqueueReadBuffer(queue, src, blocking, src_offset, size, ptr,
+                                 num_events_wait_list, events_wait_list, event);
+  case CopyBuffer:
+    return ::clEnqueueCopyBuffer(queue, src, dst, src_offset, dst_offset, size,
+                                 num_events_wait_list, events_wait_list, event);
+  case NDRangeKernel:
+    return ::clEnqueueNDRangeKernel(queue, kernel, work_dim,
+                                    has_offsets ? offsets : NULL,
+                                    globals,
+                                    has_locals ? locals : NULL,
+                                    num_events_wait_list, events_wait_list, event);
+  }
+  return CL_INVALID_OPERATION;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CommandList
+///////////////////////////////////////////////////////////////////////////////
+Persistent<FunctionTemplate> CommandList::constructor_template;
+
+void CommandList::Init(Handle<Object> target)
+{
+  NanScope();
+
+  // constructor
+  Local<FunctionTemplate> ctor = NanNew<FunctionTemplate>(CommandList::New);
+  NanAssignPersistent(constructor_template, ctor);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(NanNew("WebCLCommandList"));
+
+  // prototype
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_enqueueWriteBuffer", enqueueWriteBuffer);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_enqueueReadBuffer", enqueueReadBuffer);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_enqueueCopyBuffer", enqueueCopyBuffer);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_enqueueNDRangeKernel", enqueueNDRangeKernel);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_clear", clear);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_release", release);
+
+  Local<ObjectTemplate> proto = ctor->PrototypeTemplate();
+  proto->SetAccessor(JS_STR("length"), GetLength);
+
+  target->Set(NanNew("WebCLCommandList"), ctor->GetFunction());
+}
+
+CommandList::CommandList(Handle<Object> wrapper)
+{
+}
+
+void CommandList::Destructor() {
+#ifdef LOGGING
+  cout<<"  Destroying command list"<<endl;
+#endif
+  clearCommands();
+}
+
+void CommandList::append(const Command &cmd)
+{
+  cmd.retain();
+  commands.push_back(cmd);
+}
+
+void CommandList::clearCommands()
+{
+  for(size_t i=0;i<commands.size();i++)
+    commands[i].release();
+  commands.clear();
+}
+
+cl_int CommandList::submit(cl_command_queue queue, cl_uint num_events_wait_list,
+                           const cl_event *events_wait_list, cl_event *event) const
+{
+  cl_int ret;
+  size_t n=commands.size();
+
+  if(n==0) {
+    if(num_events_wait_list>0) {
+      ret=::clEnqueueWaitForEvents(queue, num_events_wait_list, events_wait_list);
+      if(ret != CL_SUCCESS) return ret;
+    }
+    return event ? ::clEnqueueMarker(queue, event) : CL_SUCCESS;
+  }
+
+  cl_command_queue_properties props=0;
+  ret=::clGetCommandQueueInfo(queue, CL_QUEUE_PROPERTIES, sizeof(props), &props, NULL);
+  if(ret != CL_SUCCESS) return ret;
+  bool in_order=!(props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE);
+
+  for(size_t i=0;i<n;i++) {
+    if(i>0 && !in_order) {
+      ret=::clEnqueueBarrier(queue);
+      if(ret != CL_SUCCESS) return ret;
+    }
+    bool first=(i==0), last=(i==n-1);
+    ret=commands[i].enqueue(queue,
+                            first ? num_events_wait_list : 0,
+                            first ? events_wait_list : NULL,
+                            last ? event : NULL);
+    if(ret != CL_SUCCESS) return ret;
+  }
+  return CL_SUCCESS;
+}
+
+void CommandList::keepAlive(Handle<Value> value)
+{
+  Local<Object> self=NanObjectWrapHandle(this);
+  Local<Array> refs=Local<Array>::Cast(self->Get(JS_STR("_refs")));
+  refs->Set(refs->Length(), value);
+}
+
+NAN_METHOD(CommandList::enqueueWriteBuffer)
+{
+  NanScope();
+  CommandList *list = ObjectWrap::Unwrap<CommandList>(args.This());
+  MemoryObject *mo = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
+
+  Command cmd(Command::WriteBuffer);
+  cmd.src=mo->getMemory();
+  cmd.blocking=args[1]->BooleanValue() ? CL_TRUE : CL_FALSE;
+  cmd.src_offset=SizeValue(args[2]);
+  cmd.size=SizeValue(args[3]);
+  cmd.ptr=getHostPtr(args[4]);
+  if(!cmd.ptr)
+    return NanThrowError("Invalid memory object");
+
+  list->keepAlive(args[4]);
+  list->append(cmd);
+  NanReturnUndefined();
+}
+
+NAN_METHOD(CommandList::enqueueReadBuffer)
+{
+  NanScope();
+  CommandList *list = ObjectWrap::Unwrap<CommandList>(args.This());
+  MemoryObject *mo = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
+
+  Command cmd(Command::ReadBuffer);
+  cmd.src=mo->getMemory();
+  cmd.blocking=args[1]->BooleanValue() ? CL_TRUE : CL_FALSE;
+  cmd.src_offset=SizeValue(args[2]);
+  cmd.size=SizeValue(args[3]);
+  cmd.ptr=getHostPtr(args[4]);
+  if(!cmd.ptr)
+    return NanThrowError("Invalid memory object");
+
+  list->keepAlive(args[4]);
+  list->append(cmd);
+  NanReturnUndefined();
+}
+
+NAN_METHOD(CommandList::enqueueCopyBuffer)
+{
+  NanScope();
+  CommandList *list = ObjectWrap::Unwrap<CommandList>(args.This());
+  MemoryObject *mo_src = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
+  MemoryObject *mo_dst = ObjectWrap::Unwrap<MemoryObject>(args[1]->ToObject());
+
+  Command cmd(Command::CopyBuffer);
+  cmd.src=mo_src->getMemory();
+  cmd.dst=mo_dst->getMemory();
+  cmd.src_offset=SizeValue(args[2]);
+  cmd.dst_offset=SizeValue(args[3]);
+  cmd.size=SizeValue(args[4]);
+
+  list->append(cmd);
+  NanReturnUndefined();
+}
+
+NAN_METHOD(CommandList::enqueueNDRangeKernel)
+{
+  NanScope();
+  CommandList *list = ObjectWrap::Unwrap<CommandList>(args.This());
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args[0]->ToObject());
+
+  Command cmd(Command::NDRangeKernel);
+  cmd.kernel=kernel->getKernel();
+  cmd.work_dim=args[1]->Uint32Value();
+  if(cmd.work_dim<1 || cmd.work_dim>3)
+    return NanThrowError("INVALID_WORK_DIMENSION");
+
+  if(!args[2]->IsUndefined() && !args[2]->IsNull()) {
+    if(!getDims(args[2], cmd.offsets, cmd.work_dim))
+      return NanThrowError("# offsets must match work dimension");
+    cmd.has_offsets=true;
+  }
+
+  if(args[3]->IsUndefined() || args[3]->IsNull() || !getDims(args[3], cmd.globals, cmd.work_dim))
+    return NanThrowError("# globals must match work dimension");
+
+  if(!args[4]->IsUndefined() && !args[4]->IsNull()) {
+    if(!getDims(args[4], cmd.locals, cmd.work_dim))
+      return NanThrowError("# locals must match work dimension");
+    cmd.has_locals=true;
+  }
+
+  list->append(cmd);
+  NanReturnUndefined();
+}
+
+NAN_METHOD(CommandList::clear)
+{
+  NanScope();
+  CommandList *list = ObjectWrap::Unwrap<CommandList>(args.This());
+
+  list->clearCommands();
+  args.This()->Set(JS_STR("_refs"), NanNew<Array>());
+
+  NanReturnUndefined();
+}
+
+NAN_METHOD(CommandList::release)
+{
+  NanScope();
+  CommandList *list = ObjectWrap::Unwrap<CommandList>(args.This());
+
+  DESTROY_WEBCL_OBJECT(list);
+  args.This()->Set(JS_STR("_refs"), NanNew<Array>());
+
+  NanReturnUndefined();
+}
+
+NAN_GETTER(CommandList::GetLength)
+{
+  NanScope();
+  CommandList *list = ObjectWrap::Unwrap<CommandList>(args.This());
+  NanReturnValue(JS_INT(list->size()));
+}
+
+NAN_METHOD(CommandList::New)
+{
+  if (!args.IsConstructCall())
+    return NanThrowTypeError("Constructor cannot be called as a function.");
+
+  NanScope();
+  CommandList *list = new CommandList(args.This());
+  list->Wrap(args.This());
+  args.This()->Set(JS_STR("_refs"), NanNew<Array>());
+  registerCLObj(list);
+  NanReturnValue(args.This());
+}
+
+CommandList *CommandList::New()
+{
+  NanScope();
+
+  Local<Value> arg = NanNew(0);
+  Local<FunctionTemplate> constructorHandle = NanNew(constructor_template);
+  Local<Object> obj = constructorHandle->GetFunction()->NewInstance(1, &arg);
+
+  return ObjectWrap::Unwrap<CommandList>(obj);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CommandGraph
+///////////////////////////////////////////////////////////////////////////////
+Persistent<FunctionTemplate> CommandGraph::constructor_template;
+
+void CommandGraph::Init(Handle<Object> target)
+{
+  NanScope();
+
+  // constructor
+  Local<FunctionTemplate> ctor = NanNew<FunctionTemplate>(CommandGraph::New);
+  NanAssignPersistent(constructor_template, ctor);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(NanNew("WebCLCommandGraph"));
+
+  // prototype
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_getSlot", getSlot);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_setSlot", setSlot);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_release", release);
+
+  Local<ObjectTemplate> proto = ctor->PrototypeTemplate();
+  proto->SetAccessor(JS_STR("length"), GetLength);
+  proto->SetAccessor(JS_STR("slotCount"), GetSlotCount);
+
+  target->Set(NanNew("WebCLCommandGraph"), ctor->GetFunction());
+}
+
+CommandGraph::CommandGraph(Handle<Object> wrapper) : CommandList(wrapper)
+{
+}
+
+void CommandGraph::Destructor() {
+#ifdef LOGGING
+  cout<<"  Destroying command graph"<<endl;
+#endif
+  clearCommands();
+  for(size_t i=0;i<slots.size();i++)
+    ::clReleaseMemObject(slots[i]);
+  slots.clear();
+}
+
+int CommandGraph::slotOf(cl_mem mem)
+{
+  for(size_t i=0;i<slots.size();i++)
+    if(slots[i]==mem)
+      return (int) i;
+  ::clRetainMemObject(mem);
+  slots.push_back(mem);
+  return (int) slots.size()-1;
+}
+
+// new kernel of the same program and function as kernel
+static cl_kernel cloneKernel(cl_kernel kernel, cl_int *ret)
+{
+  cl_program program=NULL;
+  size_t size=0;
+  *ret=::clGetKernelInfo(kernel, CL_KERNEL_PROGRAM, sizeof(cl_program), &program, NULL);
+  if(*ret==CL_SUCCESS)
+    *ret=::clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, 0, NULL, &size);
+  if(*ret!=CL_SUCCESS || size==0)
+    return NULL;
+  std::vector<char> name(size);
+  *ret=::clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, size, &name.front(), NULL);
+  if(*ret!=CL_SUCCESS)
+    return NULL;
+  return ::clCreateKernel(program, &name.front(), ret);
+}
+
+cl_int CommandGraph::capture(Command cmd)
+{
+  cl_kernel owned=NULL;
+  if(cmd.type==Command::NDRangeKernel) {
+    cl_int ret=CL_SUCCESS;
+    owned=cloneKernel(cmd.kernel, &ret);
+    for(size_t i=0;i<cmd.args.size() && ret==CL_SUCCESS;i++)
+      ret=::clSetKernelArg(owned, cmd.args[i].index, cmd.args[i].size, cmd.args[i].value());
+    if(ret!=CL_SUCCESS) {
+      if(owned) ::clReleaseKernel(owned);
+      return ret;
+    }
+    cmd.kernel=owned;
+  }
+
+  if(cmd.type!=Command::NDRangeKernel)
+    cmd.src_slot=slotOf(cmd.src);
+  if(cmd.type==Command::CopyBuffer)
+    cmd.dst_slot=slotOf(cmd.dst);
+  for(size_t i=0;i<cmd.args.size();i++)
+    if(cmd.args[i].mem)
+      cmd.args[i].slot=slotOf(cmd.args[i].mem);
+  append(cmd);
+
+  // the command holds its own reference
+  if(owned) ::clReleaseKernel(owned);
+  return CL_SUCCESS;
+}
+
+void CommandGraph::setSlot(int slot, cl_mem mem)
+{
+  ::clRetainMemObject(mem);
+  ::clReleaseMemObject(slots[slot]);
+  slots[slot]=mem;
+
+  // patch the handles in place so replay does not need to resolve slots
+  for(size_t i=0;i<commands.size();i++) {
+    Command &cmd=commands[i];
+    if(cmd.src_slot==slot) {
+      ::clRetainMemObject(mem);
+      ::clReleaseMemObject(cmd.src);
+      cmd.src=mem;
+    }
+    if(cmd.dst_slot==slot) {
+      ::clRetainMemObject(mem);
+      ::clReleaseMemObject(cmd.dst);
+      cmd.dst=mem;
+    }
+    for(size_t j=0;j<cmd.args.size();j++) {
+      KernelArg &arg=cmd.args[j];
+      if(arg.slot==slot) {
+        ::clRetainMemObject(mem);
+        ::clReleaseMemObject(arg.mem);
+        arg.mem=mem;
+        ::clSetKernelArg(cmd.kernel, arg.index, sizeof(cl_mem), &arg.mem);
+      }
+    }
+  }
+}
+
+NAN_METHOD(CommandGraph::getSlot)
+{
+  NanScope();
+  CommandGraph *graph = ObjectWrap::Unwrap<CommandGraph>(args.This());
+  cl_uint slot = args[0]->Uint32Value();
+
+  if(slot>=graph->slots.size())
+    return NanThrowError("INVALID_VALUE");
+
+  WebCLObject *obj=findCLObj((void*)graph->slots[slot]);
+  if(obj)
+    NanReturnValue(NanObjectWrapHandle(obj));
+  NanReturnUndefined();
+}
+
+NAN_METHOD(CommandGraph::setSlot)
+{
+  NanScope();
+  CommandGraph *graph = ObjectWrap::Unwrap<CommandGraph>(args.This());
+  cl_uint slot = args[0]->Uint32Value();
+  MemoryObject *mo = ObjectWrap::Unwrap<MemoryObject>(args[1]->ToObject());
+
+  if(slot>=graph->slots.size())
+    return NanThrowError("INVALID_VALUE");
+
+  graph->setSlot(slot, mo->getMemory());
+  NanReturnUndefined();
+}
+
+NAN_METHOD(CommandGraph::release)
+{
+  NanScope();
+  CommandGraph *graph = ObjectWrap::Unwrap<CommandGraph>(args.This());
+
+  DESTROY_WEBCL_OBJECT(graph);
+  args.This()->Set(JS_STR("_refs"), NanNew<Array>());
+
+  NanReturnUndefined();
+}
+
+NAN_GETTER(CommandGraph::GetSlotCount)
+{
+  NanScope();
+  CommandGraph *graph = ObjectWrap::Unwrap<CommandGraph>(args.This());
+  NanReturnValue(JS_INT(graph->slots.size()));
+}
+
+NAN_METHOD(CommandGraph::New)
+{
+  if (!args.IsConstructCall())
+    return NanThrowTypeError("Constructor cannot be called as a function.");
+
+  NanScope();
+  CommandGraph *graph = new CommandGraph(args.This());
+  graph->Wrap(args.This());
+  args.This()->Set(JS_STR("_refs"), NanNew<Array>());
+  registerCLObj(graph);
+  NanReturnValue(args.This());
+}
+
+CommandGraph *CommandGraph::New()
+{
+  NanScope();
+
+  Local<Value> arg = NanNew(0);
+  Local<FunctionTemplate> constructorHandle = NanNew(constructor_template);
+  Local<Object> obj = constructorHandle->GetFunction()->NewInstance(1, &arg);
+
+  return ObjectWrap::Unwrap<CommandGraph>(obj);
+}
+
+}
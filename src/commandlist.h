@@ -0,0 +1,159 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMMANDLIST_H_
+#define COMMANDLIST_H_
+
+#include "common.h"
+#include "kernel.h"
+#include <vector>
+
+namespace webcl {
+
+// A command whose arguments have already been resolved to native handles.
+// Host pointers are kept alive by the owning list's JS wrapper.
+struct Command {
+  enum Type {
+    WriteBuffer,
+    ReadBuffer,
+    CopyBuffer,
+    NDRangeKernel
+  };
+
+  Type type;
+  cl_mem src;           // buffer for reads and writes, source for copies
+  cl_mem dst;
+  cl_kernel kernel;
+  cl_bool blocking;
+  size_t src_offset;
+  size_t dst_offset;
+  size_t size;
+  void *ptr;
+  cl_uint work_dim;
+  size_t offsets[3];
+  size_t globals[3];
+  size_t locals[3];
+  bool has_offsets;
+  bool has_locals;
+  int src_slot;         // buffer slots of a captured graph, -1 if unused
+  int dst_slot;
+  std::vector<KernelArg> args; // arguments of a captured launch, set on its kernel
+
+  Command(Type t) : type(t), src(0), dst(0), kernel(0), blocking(CL_FALSE),
+    src_offset(0), dst_offset(0), size(0), ptr(NULL), work_dim(0),
+    has_offsets(false), has_locals(false), src_slot(-1), dst_slot(-1) {}
+
+  void retain() const;
+  void release() const;
+
+  // Enqueues this command. Launches use the arguments set on their kernel,
+  // which for captured launches is a kernel of their own.
+  cl_int enqueue(cl_command_queue queue, cl_uint num_events_wait_list,
+                 const cl_event *events_wait_list, cl_event *event) const;
+};
+
+class CommandList : public WebCLObject
+{
+
+public:
+  void Destructor();
+
+  static void Init(v8::Handle<v8::Object> target);
+
+  static CommandList *New();
+  static NAN_METHOD(New);
+
+  static NAN_METHOD(enqueueWriteBuffer);
+  static NAN_METHOD(enqueueReadBuffer);
+  static NAN_METHOD(enqueueCopyBuffer);
+  static NAN_METHOD(enqueueNDRangeKernel);
+  static NAN_METHOD(clear);
+  static NAN_METHOD(release);
+
+  static NAN_GETTER(GetLength);
+
+  // Enqueues all recorded commands on queue. The first command waits on the
+  // wait list and the last one returns event. On an out-of-order queue a
+  // barrier is inserted between commands to preserve recording order.
+  cl_int submit(cl_command_queue queue, cl_uint num_events_wait_list,
+                const cl_event *events_wait_list, cl_event *event) const;
+
+  void append(const Command &cmd);
+  void clearCommands();
+  size_t size() const { return commands.size(); }
+
+  // keeps host memory referenced by recorded commands alive with the list
+  void keepAlive(v8::Handle<v8::Value> value);
+
+protected:
+  CommandList(v8::Handle<v8::Object> wrapper);
+
+  std::vector<Command> commands;
+
+private:
+  static v8::Persistent<v8::FunctionTemplate> constructor_template;
+};
+
+// Immutable sequence of commands captured on a CommandQueue between
+// beginCapture() and endCapture(). Each launch gets its own kernel, created
+// at capture with the arguments set at the time, so replay leaves the
+// arguments of the captured kernel alone. Each distinct buffer used by a
+// captured read, write, copy or kernel argument gets a slot that can be
+// rebound before replay.
+class CommandGraph : public CommandList
+{
+
+public:
+  static void Init(v8::Handle<v8::Object> target);
+
+  static CommandGraph *New();
+  static NAN_METHOD(New);
+
+  static NAN_METHOD(getSlot);
+  static NAN_METHOD(setSlot);
+  static NAN_METHOD(release);
+
+  static NAN_GETTER(GetSlotCount);
+
+  // appends cmd, assigning buffer slots
+  cl_int capture(Command cmd);
+  void setSlot(int slot, cl_mem mem);
+
+  void Destructor();
+
+private:
+  CommandGraph(v8::Handle<v8::Object> wrapper);
+
+  int slotOf(cl_mem mem);
+
+  static v8::Persistent<v8::FunctionTemplate> constructor_template;
+
+  std::vector<cl_mem> slots;
+};
+
+} // namespace
+
+#endif
@@ -31,6 +31,13 @@
 #include "memoryobject.h"
 #include "event.h"
 #include "kernel.h"
+#include "commandlist.h"
+#include "range.h"
+#include "completion.h"
+#include "staging.h"
+#include "mapping.h"
+#include "worksizetuner.h"
+#include "launchplanner.h"
 #include <vector>
 #include <node_buffer.h>
 #include <cstring> // for memcpy
@@ -39,18 +46,116 @@ using namespace v8;
 using namespace node;
 
 namespace webcl {
-#define MakeEventWaitList(arg) \
-    cl_event *events_wait_list=NULL; \
-    cl_uint num_events_wait_list=0; \
-    if(!arg->IsUndefined() && !arg->IsNull()) { \
-      Local<Array> arr = Local<Array>::Cast(arg); \
-      num_events_wait_list=arr->Length(); \
-      if(num_events_wait_list>0) {\
-        events_wait_list=new cl_event[num_events_wait_list]; \
-        for(cl_uint i=0;i<num_events_wait_list;i++) \
-          events_wait_list[i]=ObjectWrap::Unwrap<Event>(arr->Get(i)->ToObject())->getEvent(); \
-      }\
-    }
+#define REQ_NOT_CAPTURING(cq) \
+  if(cq->isCapturing()) \
+    return NanThrowError("INVALID_OPERATION: command cannot be captured");
+
+#define REQ_NO_EVENTS_CAPTURED() \
+  if(wait_list.size()>0 || !no_event) \
+    return NanThrowError("INVALID_OPERATION: events cannot be captured");
+
+// Hands the event of a successful enqueue to its event argument: a WebCLEvent
+// takes it over, a function is called with the command status once the
+// command completes. Transfers given a function are never blocking and pin
+// their host memory argument P until then.
+#define SET_EVENT_ARG(I) SET_EVENT_ARG_PINNED(I, Local<Value>())
+
+#define SET_EVENT_ARG_PINNED(I, P) \
+  if(!no_event) { \
+    if(args[I]->IsFunction()) { \
+      ret=Completion::watch(event, Local<Function>::Cast(args[I]), P); \
+      if(ret!=CL_SUCCESS) \
+        ::clWaitForEvents(1, &event); /* nothing pins P */ \
+      ::clReleaseEvent(event); \
+      if(ret!=CL_SUCCESS) { \
+        REQ_ERROR_THROW(INVALID_EVENT); \
+        REQ_ERROR_THROW(OUT_OF_RESOURCES); \
+        REQ_ERROR_THROW(OUT_OF_HOST_MEMORY); \
+        return NanThrowError("UNKNOWN ERROR"); \
+      } \
+    } \
+    else \
+      ObjectWrap::Unwrap<Event>(args[I]->ToObject())->setEvent(event); \
+  }
+
+// Byte size and data of a typed array or node Buffer, false for anything else
+static bool getHostBytes(Local<Value> value, void **ptr, size_t *bytes)
+{
+  if(!value->IsObject())
+    return false;
+  Local<Object> obj=value->ToObject();
+  String::Utf8Value name(obj->GetConstructorName());
+  if(!strcmp("Buffer",*name)) {
+    *ptr=Buffer::Data(obj);
+    *bytes=Buffer::Length(obj);
+    return true;
+  }
+  if(!obj->HasIndexedPropertiesInExternalArrayData())
+    return false;
+
+  size_t elem_size;
+  switch(obj->GetIndexedPropertiesExternalArrayDataType()) {
+  case kExternalShortArray:
+  case kExternalUnsignedShortArray:
+    elem_size=2; break;
+  case kExternalIntArray:
+  case kExternalUnsignedIntArray:
+  case kExternalFloatArray:
+    elem_size=4; break;
+  case kExternalDoubleArray:
+    elem_size=8; break;
+  default:
+    elem_size=1; break;
+  }
+  *ptr=obj->GetIndexedPropertiesExternalArrayData();
+  *bytes=elem_size * obj->GetIndexedPropertiesExternalArrayDataLength();
+  return true;
+}
+
+// Transfers size bytes at offset between a buffer and an array of host arrays
+// filled back to back, for host data larger than a single ArrayBuffer. One
+// command is enqueued per chunk; a marker behind them completes with the last
+// one and is returned in event, or waited on for blocking transfers.
+static cl_int enqueueChunked(cl_command_queue queue, cl_mem mem, bool write, cl_bool blocking,
+                             size_t offset, size_t size, Local<Array> chunks,
+                             const EventWaitList &wait_list, cl_event *event)
+{
+  size_t done=0;
+  for(uint32_t i=0;i<chunks->Length() && done<size;i++) {
+    void *ptr;
+    size_t bytes;
+    if(!getHostBytes(chunks->Get(i), &ptr, &bytes))
+      return CL_INVALID_VALUE;
+    if(bytes>size-done)
+      bytes=size-done;
+
+    cl_int ret = write ?
+      ::clEnqueueWriteBuffer(queue, mem, CL_FALSE, offset+done, bytes, ptr,
+                             wait_list.size(), wait_list.data(), NULL) :
+      ::clEnqueueReadBuffer(queue, mem, CL_FALSE, offset+done, bytes, ptr,
+                            wait_list.size(), wait_list.data(), NULL);
+    if(ret!=CL_SUCCESS)
+      return ret;
+    done+=bytes;
+  }
+  if(done<size)
+    return CL_INVALID_VALUE;
+
+  if(!blocking && !event)
+    return CL_SUCCESS;
+
+  cl_event marker;
+  cl_int ret=::clEnqueueMarker(queue, &marker);
+  if(ret!=CL_SUCCESS)
+    return ret;
+  if(blocking)
+    ret=::clWaitForEvents(1, &marker);
+  if(event && ret==CL_SUCCESS)
+    *event=marker;
+  else
+    ::clReleaseEvent(marker);
+  return ret;
+}
 
 Persistent<FunctionTemplate> CommandQueue::constructor_template;
 
@@ -67,6 +172,9 @@ void CommandQueue::Init(Handle<Object> target)
   // prototype
   NODE_SET_PROTOTYPE_METHOD(ctor, "_getInfo", getInfo);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_enqueueNDRangeKernel", enqueueNDRangeKernel);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_tuneNDRangeKernel", tuneNDRangeKernel);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_planNDRange", planNDRange);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_enqueuePaddedNDRangeKernel", enqueuePaddedNDRangeKernel);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_enqueueTask", enqueueTask);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_enqueueWriteBuffer", enqueueWriteBuffer);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_enqueueReadBuffer", enqueueReadBuffer);
@@ -85,16 +193,32 @@ void CommandQueue::Init(Handle<Object> target)
   NODE_SET_PROTOTYPE_METHOD(ctor, "_enqueueMarker", enqueueMarker);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_enqueueWaitForEvents", enqueueWaitForEvents);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_enqueueBarrier", enqueueBarrier);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_submit", submit);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_beginCapture", beginCapture);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_endCapture", endCapture);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_replay", replay);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_flush", flush);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_finish", finish);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_enqueueAcquireGLObjects", enqueueAcquireGLObjects);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_enqueueReleaseGLObjects", enqueueReleaseGLObjects);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_setStagingOptions", setStagingOptions);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_release", release);
 
+  Local<ObjectTemplate> proto = ctor->PrototypeTemplate();
+  proto->SetAccessor(JS_STR("stagedBytes"), GetStagedBytes);
+
   target->Set(NanNew("WebCLCommandQueue"), ctor->GetFunction());
 }
 
-CommandQueue::CommandQueue(Handle<Object> wrapper) : command_queue(0)
+cl_device_id CommandQueue::getDevice()
+{
+  if(!device)
+    ::clGetCommandQueueInfo(command_queue, CL_QUEUE_DEVICE, sizeof(cl_device_id), &device, NULL);
+  return device;
+}
+
+CommandQueue::CommandQueue(Handle<Object> wrapper)
+  : command_queue(0), device(NULL), capture_graph(NULL), staging(NULL)
 {
   _type=CLObjType::CommandQueue;
 }
@@ -103,6 +227,10 @@ void CommandQueue::Destructor() {
 #ifdef LOGGING
   cout<<"  Destroying CL command queue"<<endl;
 #endif
+  if(staging) {
+    delete staging;
+    staging=NULL;
+  }
   if(command_queue) {
 #ifdef LOGGING
     cl_uint count;
@@ -112,6 +240,18 @@ void CommandQueue::Destructor() {
     ::clReleaseCommandQueue(command_queue);
     }
   command_queue=0;
+
+  if(capture_graph) {
+    NanDisposePersistent(capture_handle);
+    capture_graph=NULL;
+  }
+}
+
+StagingPool *CommandQueue::getStaging()
+{
+  if(!staging)
+    staging=new StagingPool(command_queue);
+  return staging;
 }
 
 NAN_METHOD(CommandQueue::release)
@@ -209,62 +349,91 @@ NAN_METHOD(CommandQueue::enqueueNDRangeKernel)
   Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args[0]->ToObject());
   int workDim = args[1]->Uint32Value();
 
-  size_t *offsets=NULL;
-  cl_uint num_offsets=0;
-  if(!args[2]->IsUndefined() && !args[2]->IsNull()) {
-    Local<Array> arr = Local<Array>::Cast(args[2]);
-    num_offsets=arr->Length();
-    if (num_offsets > 0) {
-      offsets = new size_t[num_offsets];
-      for (cl_uint i = 0; i < num_offsets; i++)
-        offsets[i] = arr->Get(i)->Uint32Value();
-    }
-  }
-
-  size_t *globals=NULL;
-  cl_uint num_globals=0;
-  if(!args[3]->IsUndefined() && !args[3]->IsNull()) {
-    Local<Array> arr = Local<Array>::Cast(args[3]);
-    num_globals=arr->Length();
-    if(num_globals == 0)
-      NanThrowError("# globals must be at least 1");
-    globals=new size_t[num_globals];
-    for(cl_uint i=0;i<num_globals;i++)
-      globals[i]=arr->Get(i)->Uint32Value();
-  }
+  if(workDim<1 || workDim>3)
+    return NanThrowError("INVALID_WORK_DIMENSION");
+
+  // values past workDim are ignored, missing ones are an error
+  NDRangeArg offsets, globals, locals;
+  if(!offsets.set(args[2]) || (offsets.size()>0 && offsets.size()<(cl_uint) workDim))
+    return NanThrowError("INVALID_GLOBAL_OFFSET");
+  if(!globals.set(args[3]) || globals.size()<(cl_uint) workDim)
+    return NanThrowError("INVALID_GLOBAL_WORK_SIZE");
+  if(!locals.set(args[4]) || (locals.size()>0 && locals.size()<(cl_uint) workDim))
+    return NanThrowError("INVALID_WORK_GROUP_SIZE");
+
+  // without locals, the tuned ones are used if the kernel was tuned for
+  // globals of the same size class and they divide these globals
+  const size_t *local_sizes=locals.data();
+  WorkSizeTuner::Result tuned;
+  if(!local_sizes && WorkSizeTuner::hasResults() &&
+     kernel->tunedLocals(cq->getDevice(), workDim, globals.data(), tuned) &&
+     tuned.locals[0]) {
+    bool divides=true;
+    for(int i=0;i<workDim;i++)
+      divides = divides && globals.data()[i]%tuned.locals[i]==0;
+    if(divides)
+      local_sizes=tuned.locals;
+  }
+
+  return launchKernel(args, cq, kernel, workDim, offsets.data(), globals.data(), local_sizes);
+}
 
-  size_t *locals=NULL;
-  cl_uint num_locals=0;
-  if(!args[4]->IsUndefined() && !args[4]->IsNull()) {
-    Local<Array> arr = Local<Array>::Cast(args[4]);
-    num_locals=arr->Length();
-    if(num_locals == 0)
-      NanThrowError("# locals must be at least 1");
-    locals=new size_t[num_locals];
-    for(cl_uint i=0;i<num_locals;i++)
-      locals[i]=arr->Get(i)->Uint32Value();
-  }
+// Enqueues kernel, or adds it to the graph being captured, with the event
+// wait list and event in args[5] and args[6].
+_NAN_METHOD_RETURN_TYPE CommandQueue::launchKernel(_NAN_METHOD_ARGS_TYPE args, CommandQueue *cq, Kernel *kernel,
+                                                   cl_uint workDim, const size_t *offsets,
+                                                   const size_t *globals, const size_t *locals)
+{
+  NanScope();
 
-  MakeEventWaitList(args[5]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[5]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_event event;
   bool no_event=(args[6]->IsUndefined()  || args[6]->IsNull());
 
+  if(cq->isCapturing()) {
+    Command cmd(Command::NDRangeKernel);
+    cmd.kernel=kernel->getKernel();
+    cmd.work_dim=workDim;
+    cmd.has_offsets=(offsets!=NULL);
+    cmd.has_locals=(locals!=NULL);
+    const std::vector<KernelArg> &values=kernel->argValues();
+    for(size_t i=0;i<values.size();i++)
+      if(values[i].size)
+        cmd.args.push_back(values[i]);
+    for(cl_uint i=0;i<3;i++) {
+      cmd.offsets[i]=(offsets && i<workDim ? offsets[i] : 0);
+      cmd.globals[i]=(i<workDim ? globals[i] : 1);
+      cmd.locals[i]=(locals && i<workDim ? locals[i] : 1);
+    }
+    REQ_NO_EVENTS_CAPTURED();
+    cl_int ret=cq->capture_graph->capture(cmd);
+    if (ret != CL_SUCCESS) {
+      REQ_ERROR_THROW(INVALID_KERNEL);
+      REQ_ERROR_THROW(INVALID_PROGRAM_EXECUTABLE);
+      REQ_ERROR_THROW(INVALID_ARG_VALUE);
+      REQ_ERROR_THROW(INVALID_MEM_OBJECT);
+      REQ_ERROR_THROW(INVALID_SAMPLER);
+      REQ_ERROR_THROW(INVALID_ARG_SIZE);
+      REQ_ERROR_THROW(OUT_OF_RESOURCES);
+      REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
+      return NanThrowError("UNKNOWN ERROR");
+    }
+    NanReturnUndefined();
+  }
+
   cl_int ret=::clEnqueueNDRangeKernel(
       cq->getCommandQueue(), kernel->getKernel(),
       workDim, // work dimension
       offsets,
       globals,
       locals,
-      num_events_wait_list,
-      events_wait_list,
+      wait_list.size(),
+      wait_list.data(),
       no_event ? NULL : &event);
 
-  if(offsets) delete[] offsets;
-  if(globals) delete[] globals;
-  if(locals) delete[] locals;
-  if(events_wait_list) delete[] events_wait_list;
-
   if (ret != CL_SUCCESS) {
     printf("[setArg] ret = %d\n",ret);
     REQ_ERROR_THROW(INVALID_PROGRAM_EXECUTABLE);
@@ -287,35 +456,207 @@ NAN_METHOD(CommandQueue::enqueueNDRangeKernel)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[6]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG(6);
   NanReturnUndefined();
 }
 
+static Local<Value> tunedLocals(const WorkSizeTuner::Result &r)
+{
+  if(!r.locals[0])
+    return NanNull();
+  Local<Array> arr = NanNew<Array>(r.work_dim);
+  for(cl_uint i=0;i<r.work_dim;i++)
+    arr->Set(i, JS_NUM((double) r.locals[i]));
+  return arr;
+}
+
+// Benchmarks local sizes for kernel with its current arguments and keeps
+// the fastest for later enqueueNDRangeKernel() calls without locals.
+// Returns { locals, time, candidates: [ { locals, time } ] }, times in ns
+// and locals null for the driver's choice.
+NAN_METHOD(CommandQueue::tuneNDRangeKernel)
+{
+  NanScope();
+  CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
+
+  REQ_ARGS(4);
+
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args[0]->ToObject());
+  int workDim = args[1]->Uint32Value();
+  if(workDim<1 || workDim>3)
+    return NanThrowError("INVALID_WORK_DIMENSION");
+
+  NDRangeArg offsets, globals;
+  if(!offsets.set(args[2]) || (offsets.size()>0 && offsets.size()<(cl_uint) workDim))
+    return NanThrowError("INVALID_GLOBAL_OFFSET");
+  if(!globals.set(args[3]) || globals.size()<(cl_uint) workDim)
+    return NanThrowError("INVALID_GLOBAL_WORK_SIZE");
+
+  cl_uint iterations = args[4]->IsUndefined() ? 3 : args[4]->Uint32Value();
+
+  WorkSizeTuner::Result best;
+  std::vector<WorkSizeTuner::Result> tried;
+  cl_int ret=WorkSizeTuner::tune(cq->getCommandQueue(), kernel->getKernel(), kernel->getTuningId(),
+                                 workDim, offsets.data(), globals.data(), iterations, best, &tried);
+  if (ret != CL_SUCCESS) {
+    REQ_ERROR_THROW(INVALID_PROGRAM_EXECUTABLE);
+    REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
+    REQ_ERROR_THROW(INVALID_KERNEL);
+    REQ_ERROR_THROW(INVALID_KERNEL_ARGS);
+    REQ_ERROR_THROW(INVALID_GLOBAL_WORK_SIZE);
+    REQ_ERROR_THROW(INVALID_GLOBAL_OFFSET);
+    REQ_ERROR_THROW(INVALID_WORK_GROUP_SIZE);
+    REQ_ERROR_THROW(INVALID_QUEUE_PROPERTIES);
+    REQ_ERROR_THROW(MEM_OBJECT_ALLOCATION_FAILURE);
+    REQ_ERROR_THROW(OUT_OF_RESOURCES);
+    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
+    return NanThrowError("UNKNOWN ERROR");
+  }
+
+  Local<Array> candidates = NanNew<Array>((int) tried.size());
+  for(size_t i=0;i<tried.size();i++) {
+    Local<Object> c = NanNew<Object>();
+    c->Set(JS_STR("locals"), tunedLocals(tried[i]));
+    c->Set(JS_STR("time"), JS_NUM(tried[i].time));
+    candidates->Set((uint32_t) i, c);
+  }
+
+  Local<Object> obj = NanNew<Object>();
+  obj->Set(JS_STR("locals"), tunedLocals(best));
+  obj->Set(JS_STR("time"), JS_NUM(best.time));
+  obj->Set(JS_STR("candidates"), candidates);
+  NanReturnValue(obj);
+}
+
+#define PLAN_ERROR_THROW()                        \
+  if (ret != CL_SUCCESS) {                        \
+    REQ_ERROR_THROW(INVALID_DEVICE);              \
+    REQ_ERROR_THROW(INVALID_KERNEL);              \
+    REQ_ERROR_THROW(INVALID_VALUE);               \
+    REQ_ERROR_THROW(INVALID_WORK_DIMENSION);      \
+    REQ_ERROR_THROW(INVALID_GLOBAL_WORK_SIZE);    \
+    REQ_ERROR_THROW(OUT_OF_RESOURCES);            \
+    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);          \
+    return NanThrowError("UNKNOWN ERROR");        \
+  }
+
+// Launch plan of kernel over extent on the device of this queue: locals are
+// the required ones, the given ones if legal, the tuned ones or else picked
+// by LaunchPlanner, and globals are padded to a multiple of them.
+static cl_int planLaunch(CommandQueue *cq, Kernel *kernel, cl_uint workDim, const size_t *extent,
+                         const size_t *locals, LaunchPlanner::Plan &plan)
+{
+  cl_int ret=CL_SUCCESS;
+  const LaunchPlanner::Limits *limits=kernel->launchLimits(cq->getDevice(), &ret);
+  if(!limits)
+    return ret;
+
+  WorkSizeTuner::Result tuned;
+  if(!locals && WorkSizeTuner::hasResults() &&
+     kernel->tunedLocals(cq->getDevice(), workDim, extent, tuned) &&
+     tuned.locals[0])
+    locals=tuned.locals;
+
+  return LaunchPlanner::plan(*limits, workDim, extent, locals, plan);
+}
+
+// Returns { globals, locals } of a padded launch over extent
+NAN_METHOD(CommandQueue::planNDRange)
+{
+  NanScope();
+  CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+
+  REQ_ARGS(3);
+
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args[0]->ToObject());
+  int workDim = args[1]->Uint32Value();
+  if(workDim<1 || workDim>3)
+    return NanThrowError("INVALID_WORK_DIMENSION");
+
+  NDRangeArg extent, locals;
+  if(!extent.set(args[2]) || extent.size()<(cl_uint) workDim)
+    return NanThrowError("INVALID_GLOBAL_WORK_SIZE");
+  if(!locals.set(args[3]) || (locals.size()>0 && locals.size()<(cl_uint) workDim))
+    return NanThrowError("INVALID_WORK_GROUP_SIZE");
+
+  LaunchPlanner::Plan plan;
+  cl_int ret=planLaunch(cq, kernel, workDim, extent.data(), locals.data(), plan);
+  PLAN_ERROR_THROW();
+
+  Local<Array> globals_arr = NanNew<Array>(workDim);
+  Local<Array> locals_arr = NanNew<Array>(workDim);
+  for(int i=0;i<workDim;i++) {
+    globals_arr->Set(i, JS_NUM((double) plan.globals[i]));
+    locals_arr->Set(i, JS_NUM((double) plan.locals[i]));
+  }
+  Local<Object> obj = NanNew<Object>();
+  obj->Set(JS_STR("globals"), globals_arr);
+  obj->Set(JS_STR("locals"), locals_arr);
+  NanReturnValue(obj);
+}
+
+// Launches kernel over extent with padded globals after setting the
+// extent argument(s) at index args[4], see Kernel::setExtentArg()
+NAN_METHOD(CommandQueue::enqueuePaddedNDRangeKernel)
+{
+  NanScope();
+  CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+
+  REQ_ARGS(5);
+
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args[0]->ToObject());
+  int workDim = args[1]->Uint32Value();
+  if(workDim<1 || workDim>3)
+    return NanThrowError("INVALID_WORK_DIMENSION");
+
+  NDRangeArg offsets, extent;
+  if(!offsets.set(args[2]) || (offsets.size()>0 && offsets.size()<(cl_uint) workDim))
+    return NanThrowError("INVALID_GLOBAL_OFFSET");
+  if(!extent.set(args[3]) || extent.size()<(cl_uint) workDim)
+    return NanThrowError("INVALID_GLOBAL_WORK_SIZE");
+
+  LaunchPlanner::Plan plan;
+  cl_int ret=planLaunch(cq, kernel, workDim, extent.data(), NULL, plan);
+  PLAN_ERROR_THROW();
+
+  ret=kernel->setExtentArg(args[4]->Uint32Value(), workDim, extent.data());
+  if (ret != CL_SUCCESS) {
+    REQ_ERROR_THROW(INVALID_KERNEL);
+    REQ_ERROR_THROW(INVALID_ARG_INDEX);
+    REQ_ERROR_THROW(INVALID_ARG_VALUE);
+    REQ_ERROR_THROW(INVALID_ARG_SIZE);
+    REQ_ERROR_THROW(OUT_OF_RESOURCES);
+    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
+    return NanThrowError("UNKNOWN ERROR");
+  }
+
+  return launchKernel(args, cq, kernel, workDim, offsets.data(), plan.globals, plan.locals);
+}
+
 NAN_METHOD(CommandQueue::enqueueTask)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
 
   REQ_ARGS(1);
 
   Kernel *k = ObjectWrap::Unwrap<Kernel>(args[0]->ToObject());
 
-  MakeEventWaitList(args[1]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[1]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_event event;
   bool no_event = (args[2]->IsUndefined() || args[2]->IsNull());
 
   cl_int ret=::clEnqueueTask(
       cq->getCommandQueue(), k->getKernel(),
-      num_events_wait_list,
-      events_wait_list,
+      wait_list.size(),
+      wait_list.data(),
       no_event ? NULL : &event);
 
-  if(events_wait_list) delete[] events_wait_list;
-
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_PROGRAM_EXECUTABLE);
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
@@ -333,10 +674,7 @@ NAN_METHOD(CommandQueue::enqueueTask)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[2]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG(2);
   NanReturnUndefined();
 }
 
@@ -348,16 +686,15 @@ NAN_METHOD(CommandQueue::enqueueWriteBuffer)
 
   cl_bool blocking_write = args[1]->BooleanValue() ? CL_TRUE : CL_FALSE;
 
-  uint32_t offset = args[2]->Uint32Value();
-  uint32_t size = args[3]->Uint32Value();
+  size_t offset = SizeValue(args[2]);
+  size_t size = SizeValue(args[3]);
+
+  // an array of host arrays is a chunked transfer
+  bool chunked=args[4]->IsArray();
 
   void *ptr=NULL;
-  if(!args[4]->IsUndefined()) {
-    if(args[4]->IsArray()) {
-      Local<Array> arr=Local<Array>::Cast(args[4]);
-      ptr = arr->GetIndexedPropertiesExternalArrayData();
-    }
-    else if(args[4]->IsObject()) {
+  if(!args[4]->IsUndefined() && !chunked) {
+    if(args[4]->IsObject()) {
       Local<Object> obj=args[4]->ToObject();
       String::Utf8Value name(obj->GetConstructorName());
       if(!strcmp("Buffer",*name))
@@ -369,19 +706,44 @@ NAN_METHOD(CommandQueue::enqueueWriteBuffer)
       NanThrowError("Invalid memory object");
   }
 
-  MakeEventWaitList(args[5]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[5]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_event event;
   bool no_event = (args[6]->IsUndefined() || args[6]->IsNull());
+  if(!no_event && args[6]->IsFunction())
+    blocking_write=CL_FALSE;
+
+  if(cq->isCapturing()) {
+    REQ_NO_EVENTS_CAPTURED();
+    if(chunked)
+      return NanThrowError("INVALID_OPERATION: chunked transfers cannot be captured");
+    Command cmd(Command::WriteBuffer);
+    cmd.src=mo->getMemory();
+    cmd.blocking=blocking_write;
+    cmd.src_offset=offset;
+    cmd.size=size;
+    cmd.ptr=ptr;
+    cq->capture_graph->capture(cmd);
+    cq->capture_graph->keepAlive(args[4]);
+    NanReturnUndefined();
+  }
 
-  cl_int ret=::clEnqueueWriteBuffer(
-                  cq->getCommandQueue(), mo->getMemory(), blocking_write, offset, size,
-                  ptr,
-                  num_events_wait_list,
-                  events_wait_list,
-                  no_event ? NULL : &event);
-
-  if(events_wait_list) delete[] events_wait_list;
+  cl_int ret;
+  if(chunked)
+    ret=enqueueChunked(cq->getCommandQueue(), mo->getMemory(), true, blocking_write, offset, size,
+                       Local<Array>::Cast(args[4]), wait_list, no_event ? NULL : &event);
+  else if(ptr && blocking_write && cq->getStaging()->useFor(size))
+    ret=cq->staging->write(mo->getMemory(), offset, size, ptr,
+                           wait_list, no_event ? NULL : &event);
+  else
+    ret=::clEnqueueWriteBuffer(
+        cq->getCommandQueue(), mo->getMemory(), blocking_write, offset, size,
+        ptr,
+        wait_list.size(),
+        wait_list.data(),
+        no_event ? NULL : &event);
 
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
@@ -398,10 +760,7 @@ NAN_METHOD(CommandQueue::enqueueWriteBuffer)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[6]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG_PINNED(6, args[4]);
   NanReturnUndefined();
 }
 
@@ -409,6 +768,7 @@ NAN_METHOD(CommandQueue::enqueueWriteBufferRect)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
   MemoryObject *mo = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
 
   cl_bool blocking_write = args[1]->BooleanValue() ? CL_TRUE : CL_FALSE;
@@ -420,20 +780,20 @@ NAN_METHOD(CommandQueue::enqueueWriteBufferRect)
   Local<Array> arr= Local<Array>::Cast(args[2]);
   uint32_t i;
   for(i=0;i<arr->Length();i++)
-      buffer_origin[i]=arr->Get(i)->Uint32Value();
+      buffer_origin[i]=SizeValue(arr->Get(i));
 
   arr=Local<Array>::Cast(args[3]);
   for(i=0;i<arr->Length();i++)
-      host_origin[i]=arr->Get(i)->Uint32Value();
+      host_origin[i]=SizeValue(arr->Get(i));
 
   arr=Local<Array>::Cast(args[4]);
   for(i=0;i<arr->Length();i++)
-      region[i]=arr->Get(i)->Uint32Value();
+      region[i]=SizeValue(arr->Get(i));
 
-  uint32_t buffer_row_pitch=args[5]->Uint32Value();
-  uint32_t buffer_slice_pitch=args[6]->Uint32Value();
-  uint32_t host_row_pitch=args[7]->Uint32Value();
-  uint32_t host_slice_pitch=args[8]->Uint32Value();
+  size_t buffer_row_pitch = SizeValue(args[5]);
+  size_t buffer_slice_pitch = SizeValue(args[6]);
+  size_t host_row_pitch = SizeValue(args[7]);
+  size_t host_slice_pitch = SizeValue(args[8]);
 
   void *ptr=NULL;
   if(!args[9]->IsUndefined()) {
@@ -453,10 +813,14 @@ NAN_METHOD(CommandQueue::enqueueWriteBufferRect)
       NanThrowError("Invalid memory object");
   }
 
-  MakeEventWaitList(args[10]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[10]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_event event;
   bool no_event = (args[11]->IsUndefined() || args[11]->IsNull());
+  if(!no_event && args[11]->IsFunction())
+    blocking_write=CL_FALSE;
 
   cl_int ret=::clEnqueueWriteBufferRect(
       cq->getCommandQueue(),
@@ -470,12 +834,10 @@ NAN_METHOD(CommandQueue::enqueueWriteBufferRect)
       host_row_pitch,
       host_slice_pitch,
       ptr,
-      num_events_wait_list,
-      events_wait_list,
+      wait_list.size(),
+      wait_list.data(),
       no_event ? NULL : &event);
 
-  if(events_wait_list) delete[] events_wait_list;
-
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
     REQ_ERROR_THROW(INVALID_CONTEXT);
@@ -491,10 +853,7 @@ NAN_METHOD(CommandQueue::enqueueWriteBufferRect)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[11]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG_PINNED(11, args[9]);
   NanReturnUndefined();
 }
 
@@ -506,16 +865,15 @@ NAN_METHOD(CommandQueue::enqueueReadBuffer)
 
   cl_bool blocking_read = args[1]->BooleanValue() ? CL_TRUE : CL_FALSE;
 
-  uint32_t offset=args[2]->Uint32Value();
-  uint32_t size=args[3]->Uint32Value();
+  size_t offset = SizeValue(args[2]);
+  size_t size = SizeValue(args[3]);
+
+  // an array of host arrays is a chunked transfer
+  bool chunked=args[4]->IsArray();
 
   void *ptr=NULL;
-  if(!args[4]->IsUndefined()) {
-    if(args[4]->IsArray()) {
-      Local<Array> arr=Local<Array>::Cast(args[4]);
-      ptr = arr->GetIndexedPropertiesExternalArrayData();
-    }
-    else if(args[4]->IsObject()) {
+  if(!args[4]->IsUndefined() && !chunked) {
+    if(args[4]->IsObject()) {
       Local<Object> obj=args[4]->ToObject();
       String::Utf8Value name(obj->GetConstructorName());
       if(!strcmp("Buffer",*name))
@@ -527,19 +885,44 @@ NAN_METHOD(CommandQueue::enqueueReadBuffer)
       NanThrowError("Invalid memory object");
   }
 
-  MakeEventWaitList(args[5]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[5]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_event event;
   bool no_event = (args[6]->IsUndefined() || args[6]->IsNull());
+  if(!no_event && args[6]->IsFunction())
+    blocking_read=CL_FALSE;
+
+  if(cq->isCapturing()) {
+    REQ_NO_EVENTS_CAPTURED();
+    if(chunked)
+      return NanThrowError("INVALID_OPERATION: chunked transfers cannot be captured");
+    Command cmd(Command::ReadBuffer);
+    cmd.src=mo->getMemory();
+    cmd.blocking=blocking_read;
+    cmd.src_offset=offset;
+    cmd.size=size;
+    cmd.ptr=ptr;
+    cq->capture_graph->capture(cmd);
+    cq->capture_graph->keepAlive(args[4]);
+    NanReturnUndefined();
+  }
 
-  cl_int ret=::clEnqueueReadBuffer(
-      cq->getCommandQueue(), mo->getMemory(), blocking_read, offset, size,
-      ptr,
-      num_events_wait_list,
-      events_wait_list,
-      no_event ? NULL : &event);
-
-  if(events_wait_list) delete[] events_wait_list;
+  cl_int ret;
+  if(chunked)
+    ret=enqueueChunked(cq->getCommandQueue(), mo->getMemory(), false, blocking_read, offset, size,
+                       Local<Array>::Cast(args[4]), wait_list, no_event ? NULL : &event);
+  else if(ptr && blocking_read && cq->getStaging()->useFor(size))
+    ret=cq->staging->read(mo->getMemory(), offset, size, ptr,
+                          wait_list, no_event ? NULL : &event);
+  else
+    ret=::clEnqueueReadBuffer(
+          cq->getCommandQueue(), mo->getMemory(), blocking_read, offset, size,
+          ptr,
+          wait_list.size(),
+          wait_list.data(),
+          no_event ? NULL : &event);
 
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
@@ -556,10 +939,7 @@ NAN_METHOD(CommandQueue::enqueueReadBuffer)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[6]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG_PINNED(6, args[4]);
   NanReturnUndefined();
 }
 
@@ -567,6 +947,7 @@ NAN_METHOD(CommandQueue::enqueueReadBufferRect)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
   MemoryObject *mo = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
 
   cl_bool blocking_read = args[1]->BooleanValue() ? CL_TRUE : CL_FALSE;
@@ -578,20 +959,20 @@ NAN_METHOD(CommandQueue::enqueueReadBufferRect)
   Local<Array> arr= Local<Array>::Cast(args[2]);
   uint32_t i;
   for(i=0;i<arr->Length();i++)
-      buffer_origin[i]=arr->Get(i)->Uint32Value();
+      buffer_origin[i]=SizeValue(arr->Get(i));
 
   arr=Local<Array>::Cast(args[3]);
   for(i=0;i<arr->Length();i++)
-      host_origin[i]=arr->Get(i)->Uint32Value();
+      host_origin[i]=SizeValue(arr->Get(i));
 
   arr=Local<Array>::Cast(args[4]);
   for(i=0;i<arr->Length();i++)
-      region[i]=arr->Get(i)->Uint32Value();
+      region[i]=SizeValue(arr->Get(i));
 
-  uint32_t buffer_row_pitch=args[5]->Uint32Value();
-  uint32_t buffer_slice_pitch=args[6]->Uint32Value();
-  uint32_t host_row_pitch=args[7]->Uint32Value();
-  uint32_t host_slice_pitch=args[8]->Uint32Value();
+  size_t buffer_row_pitch = SizeValue(args[5]);
+  size_t buffer_slice_pitch = SizeValue(args[6]);
+  size_t host_row_pitch = SizeValue(args[7]);
+  size_t host_slice_pitch = SizeValue(args[8]);
 
   void *ptr=NULL;
   if(!args[9]->IsUndefined()) {
@@ -611,10 +992,14 @@ NAN_METHOD(CommandQueue::enqueueReadBufferRect)
       NanThrowError("Invalid memory object");
   }
 
-  MakeEventWaitList(args[10]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[10]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_event event;
   bool no_event = (args[11]->IsUndefined() || args[11]->IsNull());
+  if(!no_event && args[11]->IsFunction())
+    blocking_read=CL_FALSE;
 
   cl_int ret=::clEnqueueReadBufferRect(
       cq->getCommandQueue(),
@@ -628,12 +1013,10 @@ NAN_METHOD(CommandQueue::enqueueReadBufferRect)
       host_row_pitch,
       host_slice_pitch,
       ptr,
-      num_events_wait_list,
-      events_wait_list,
+      wait_list.size(),
+      wait_list.data(),
       no_event ? NULL : &event);
 
-  if(events_wait_list) delete[] events_wait_list;
-
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
     REQ_ERROR_THROW(INVALID_CONTEXT);
@@ -649,10 +1032,7 @@ NAN_METHOD(CommandQueue::enqueueReadBufferRect)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[5]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG_PINNED(11, args[9]);
   NanReturnUndefined();
 }
 
@@ -664,24 +1044,36 @@ NAN_METHOD(CommandQueue::enqueueCopyBuffer)
   MemoryObject *mo_src = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
   MemoryObject *mo_dst = ObjectWrap::Unwrap<MemoryObject>(args[1]->ToObject());
 
-  size_t src_offset = args[2]->Uint32Value();
-  size_t dst_offset = args[3]->Uint32Value();
-  size_t size = args[4]->Uint32Value();
+  size_t src_offset = SizeValue(args[2]);
+  size_t dst_offset = SizeValue(args[3]);
+  size_t size = SizeValue(args[4]);
 
-  MakeEventWaitList(args[5]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[5]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_event event=NULL;
   bool no_event = (args[6]->IsUndefined() || args[6]->IsNull());
 
+  if(cq->isCapturing()) {
+    REQ_NO_EVENTS_CAPTURED();
+    Command cmd(Command::CopyBuffer);
+    cmd.src=mo_src->getMemory();
+    cmd.dst=mo_dst->getMemory();
+    cmd.src_offset=src_offset;
+    cmd.dst_offset=dst_offset;
+    cmd.size=size;
+    cq->capture_graph->capture(cmd);
+    NanReturnUndefined();
+  }
+
   cl_int ret=::clEnqueueCopyBuffer(
       cq->getCommandQueue(), mo_src->getMemory(), mo_dst->getMemory(),
       src_offset, dst_offset, size,
-      num_events_wait_list,
-      events_wait_list,
+      wait_list.size(),
+      wait_list.data(),
       no_event ? NULL : &event);
 
-  if(events_wait_list) delete[] events_wait_list;
-
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
     REQ_ERROR_THROW(INVALID_CONTEXT);
@@ -696,10 +1088,7 @@ NAN_METHOD(CommandQueue::enqueueCopyBuffer)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[6]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG(6);
   NanReturnUndefined();
 }
 
@@ -707,6 +1096,7 @@ NAN_METHOD(CommandQueue::enqueueCopyBufferRect)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
   MemoryObject *mo_src = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
   MemoryObject *mo_dst = ObjectWrap::Unwrap<MemoryObject>(args[1]->ToObject());
 
@@ -717,22 +1107,24 @@ NAN_METHOD(CommandQueue::enqueueCopyBufferRect)
   Local<Array> arr= Local<Array>::Cast(args[2]);
   uint32_t i;
   for(i=0;i<arr->Length();i++)
-      src_origin[i]=arr->Get(i)->Uint32Value();
+      src_origin[i]=SizeValue(arr->Get(i));
 
   arr=Local<Array>::Cast(args[3]);
   for(i=0;i<arr->Length();i++)
-      dst_origin[i]=arr->Get(i)->Uint32Value();
+      dst_origin[i]=SizeValue(arr->Get(i));
 
   arr=Local<Array>::Cast(args[4]);
   for(i=0;i<arr->Length();i++)
-      region[i]=arr->Get(i)->Uint32Value();
+      region[i]=SizeValue(arr->Get(i));
 
-  size_t src_row_pitch = args[5]->Uint32Value();
-  size_t src_slice_pitch = args[6]->Uint32Value();
-  size_t dst_row_pitch = args[7]->Uint32Value();
-  size_t dst_slice_pitch = args[8]->Uint32Value();
+  size_t src_row_pitch = SizeValue(args[5]);
+  size_t src_slice_pitch = SizeValue(args[6]);
+  size_t dst_row_pitch = SizeValue(args[7]);
+  size_t dst_slice_pitch = SizeValue(args[8]);
 
-  MakeEventWaitList(args[9]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[9]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_event event=NULL;
   bool no_event = (args[10]->IsUndefined() || args[10]->IsNull());
@@ -748,12 +1140,10 @@ NAN_METHOD(CommandQueue::enqueueCopyBufferRect)
       src_slice_pitch,
       dst_row_pitch,
       dst_slice_pitch,
-      num_events_wait_list,
-      events_wait_list,
+      wait_list.size(),
+      wait_list.data(),
       no_event ? NULL : &event);
 
-  if(events_wait_list) delete[] events_wait_list;
-
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
     REQ_ERROR_THROW(INVALID_CONTEXT);
@@ -768,10 +1158,7 @@ NAN_METHOD(CommandQueue::enqueueCopyBufferRect)
     return NanThrowError("UNKNOWN ERROR");
   }
 
- if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[10]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG(10);
   NanReturnUndefined();
 }
 
@@ -779,6 +1166,7 @@ NAN_METHOD(CommandQueue::enqueueWriteImage)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
   MemoryObject *mo = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
 
   cl_bool blocking_write = args[1]->BooleanValue() ? CL_TRUE : CL_FALSE;
@@ -816,10 +1204,14 @@ NAN_METHOD(CommandQueue::enqueueWriteImage)
       NanThrowError("Invalid memory object");
   }
 
-  MakeEventWaitList(args[6]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[6]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_event event;
   bool no_event = (args[7]->IsUndefined() || args[7]->IsNull());
+  if(!no_event && args[7]->IsFunction())
+    blocking_write=CL_FALSE;
 
   cl_int ret=::clEnqueueWriteImage(
       cq->getCommandQueue(), mo->getMemory(), blocking_write,
@@ -828,12 +1220,10 @@ NAN_METHOD(CommandQueue::enqueueWriteImage)
       row_pitch,
       slice_pitch,
       ptr,
-      num_events_wait_list,
-      events_wait_list,
+      wait_list.size(),
+      wait_list.data(),
       no_event ? NULL : &event);
 
-  if(events_wait_list) delete[] events_wait_list;
-
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
     REQ_ERROR_THROW(INVALID_CONTEXT);
@@ -850,10 +1240,7 @@ NAN_METHOD(CommandQueue::enqueueWriteImage)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[7]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG_PINNED(7, args[5]);
   NanReturnUndefined();
 }
 
@@ -861,6 +1248,7 @@ NAN_METHOD(CommandQueue::enqueueReadImage)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
   MemoryObject *mo = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
 
   cl_bool blocking_read = args[1]->BooleanValue() ? CL_TRUE : CL_FALSE;
@@ -898,10 +1286,14 @@ NAN_METHOD(CommandQueue::enqueueReadImage)
       NanThrowError("Invalid memory object");
   }
 
-  MakeEventWaitList(args[6]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[6]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_event event;
   bool no_event = (args[7]->IsUndefined() || args[7]->IsNull());
+  if(!no_event && args[7]->IsFunction())
+    blocking_read=CL_FALSE;
 
   cl_int ret=::clEnqueueReadImage(
       cq->getCommandQueue(), mo->getMemory(), blocking_read,
@@ -909,12 +1301,10 @@ NAN_METHOD(CommandQueue::enqueueReadImage)
       region,
       row_pitch, slice_pitch, 
       ptr,
-      num_events_wait_list,
-      events_wait_list,
+      wait_list.size(),
+      wait_list.data(),
       no_event ? NULL : &event);
 
-  if(events_wait_list) delete[] events_wait_list;
-
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
     REQ_ERROR_THROW(INVALID_CONTEXT);
@@ -931,10 +1321,7 @@ NAN_METHOD(CommandQueue::enqueueReadImage)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[8]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG_PINNED(7, args[5]);
   NanReturnUndefined();
 }
 
@@ -942,6 +1329,7 @@ NAN_METHOD(CommandQueue::enqueueCopyImage)
 {   
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
   MemoryObject *mo_src = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
   MemoryObject *mo_dst = ObjectWrap::Unwrap<MemoryObject>(args[1]->ToObject());
 
@@ -962,7 +1350,9 @@ NAN_METHOD(CommandQueue::enqueueCopyImage)
   for(i=0;i<arr->Length();i++)
       region[i]=arr->Get(i)->Uint32Value();
 
-  MakeEventWaitList(args[5]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[5]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_event event;
   bool no_event = (args[6]->IsUndefined() || args[6]->IsNull());
@@ -972,12 +1362,10 @@ NAN_METHOD(CommandQueue::enqueueCopyImage)
       src_origin,
       dst_origin,
       region,
-      num_events_wait_list,
-      events_wait_list,
+      wait_list.size(),
+      wait_list.data(),
       no_event ? NULL : &event);
 
-  if(events_wait_list) delete[] events_wait_list;
-
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
     REQ_ERROR_THROW(INVALID_CONTEXT);
@@ -995,10 +1383,7 @@ NAN_METHOD(CommandQueue::enqueueCopyImage)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[6]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG(6);
   NanReturnUndefined();
 }
 
@@ -1006,6 +1391,7 @@ NAN_METHOD(CommandQueue::enqueueCopyImageToBuffer)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
   MemoryObject *mo_src = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
   MemoryObject *mo_dst = ObjectWrap::Unwrap<MemoryObject>(args[1]->ToObject());
 
@@ -1021,9 +1407,11 @@ NAN_METHOD(CommandQueue::enqueueCopyImageToBuffer)
   for(i=0;i<arr->Length();i++)
       region[i]=arr->Get(i)->Uint32Value();
 
-  size_t dst_offset = args[4]->Uint32Value();
+  size_t dst_offset = SizeValue(args[4]);
 
-  MakeEventWaitList(args[5]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[5]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_event event;
   bool no_event = (args[6]->IsUndefined() || args[6]->IsNull());
@@ -1033,12 +1421,10 @@ NAN_METHOD(CommandQueue::enqueueCopyImageToBuffer)
       (const size_t*) src_origin,
       (const size_t*) region,
       dst_offset,
-      num_events_wait_list,
-      events_wait_list,
+      wait_list.size(),
+      wait_list.data(),
       no_event ? NULL : &event);
 
-  if(events_wait_list) delete[] events_wait_list;
-
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
     REQ_ERROR_THROW(INVALID_CONTEXT);
@@ -1055,10 +1441,7 @@ NAN_METHOD(CommandQueue::enqueueCopyImageToBuffer)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[6]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG(6);
   NanReturnUndefined();
 }
 
@@ -1066,10 +1449,11 @@ NAN_METHOD(CommandQueue::enqueueCopyBufferToImage)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
   MemoryObject *mo_src = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
   MemoryObject *mo_dst = ObjectWrap::Unwrap<MemoryObject>(args[1]->ToObject());
 
-  size_t src_offset = args[2]->Uint32Value();
+  size_t src_offset = SizeValue(args[2]);
   size_t dst_origin[3]={0,0,0};
   size_t region[3]={1,1,1};
 
@@ -1082,7 +1466,9 @@ NAN_METHOD(CommandQueue::enqueueCopyBufferToImage)
   for(i=0;i<arr->Length();i++)
       region[i]=arr->Get(i)->Uint32Value();
 
-  MakeEventWaitList(args[5]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[5]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_event event;
   bool no_event = (args[6]->IsUndefined() || args[6]->IsNull());
@@ -1092,12 +1478,10 @@ NAN_METHOD(CommandQueue::enqueueCopyBufferToImage)
       src_offset,
       dst_origin,
       region,
-      num_events_wait_list,
-      events_wait_list,
+      wait_list.size(),
+      wait_list.data(),
       no_event ? NULL : &event);
 
-  if(events_wait_list) delete[] events_wait_list;
-
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
     REQ_ERROR_THROW(INVALID_CONTEXT);
@@ -1114,44 +1498,47 @@ NAN_METHOD(CommandQueue::enqueueCopyBufferToImage)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[6]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG(6);
   NanReturnUndefined();
 }
 
-void free_callback(char *data, void *hint) {
-  //cout<<"enqueueMapBuffer free_callback called"<<endl;
-}
-
 NAN_METHOD(CommandQueue::enqueueMapBuffer)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
 
   // TODO: arg checking
   MemoryObject *mo = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
   cl_bool blocking = args[1]->BooleanValue() ? CL_TRUE : CL_FALSE;
   cl_map_flags flags = args[2]->Uint32Value();
-  size_t offset = args[3]->Uint32Value();
-  size_t size = args[4]->Uint32Value();
+  size_t offset = SizeValue(args[3]);
+  size_t size = SizeValue(args[4]);
 
-  MakeEventWaitList(args[5]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[5]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_int ret=CL_SUCCESS;
   cl_event event;
   bool no_event = (args[6]->IsUndefined() || args[6]->IsNull());
 
+  // persistent mappings are of host memory, mapped without a copy
+  bool persistent = args[7]->BooleanValue();
+  if(persistent) {
+    cl_mem_flags mem_flags=0;
+    ::clGetMemObjectInfo(mo->getMemory(), CL_MEM_FLAGS, sizeof(cl_mem_flags), &mem_flags, NULL);
+    if(!(mem_flags & (CL_MEM_USE_HOST_PTR | CL_MEM_ALLOC_HOST_PTR)))
+      return NanThrowError("INVALID_OPERATION: persistent mappings need a buffer with host memory");
+  }
+
   void *result=::clEnqueueMapBuffer(
               cq->getCommandQueue(), mo->getMemory(),
               blocking, flags, offset, size,
-              num_events_wait_list,
-              events_wait_list,
+              wait_list.size(),
+              wait_list.data(),
               no_event ? NULL : &event, &ret);
 
-  if(events_wait_list) delete[] events_wait_list;
-
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
     REQ_ERROR_THROW(INVALID_CONTEXT);
@@ -1168,39 +1555,22 @@ NAN_METHOD(CommandQueue::enqueueMapBuffer)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  // cl_mem mem=mo->getMemory();
-  // void *host_ptr=NULL;
-  // ::clGetMemObjectInfo(mem,CL_MEM_HOST_PTR,sizeof(void*),host_ptr,NULL);
-  // printf("\n[map] memobject %p, host_ptr %p",mem, host_ptr);
-
-  // printf("\n[map] result = ");
-  // for (size_t i = 0; i < size; ++i)
-  // {
-  //   printf("%d ",((uint8_t*)result)[i]);
-  // }
-  // printf("\n");
-
-  // wrap OpenCL result buffer into a node Buffer
-  // WARNING: make sure result is shared not copied, otherwise unmapBuffer won't work
-  // node::Buffer *buf=node::Buffer::New((char*) result,size, free_callback, NULL);
-  Local<Object> buf=NanNewBufferHandle((char*) result, size, free_callback, NULL);
-  // printf("[map] result %p, wrapped data %p\n", result, node::Buffer::Data(buf));
-  if(node::Buffer::Data(buf) != result) {
-    printf("WARNING: data buffer has been copied\n");
-  }
+  // view on the mapped memory itself, detached when unmapped unless
+  // persistent
+  Local<Object> view=persistent ?
+      MappingTable::addPersistent(mo->getMemory(), offset, result, size) :
+      MappingTable::add(mo->getMemory(), result, size);
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[6]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG(6);
 
-  NanReturnValue(buf);
+  NanReturnValue(view);
 }
 
 NAN_METHOD(CommandQueue::enqueueMapImage)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
 
   // TODO: arg checking
   MemoryObject *mo = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
@@ -1222,7 +1592,9 @@ NAN_METHOD(CommandQueue::enqueueMapImage)
     region[i] = s;
   }
 
-  MakeEventWaitList(args[5]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[5]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   size_t row_pitch;
   size_t slice_pitch;
@@ -1237,12 +1609,10 @@ NAN_METHOD(CommandQueue::enqueueMapImage)
               origin,
               region,
               &row_pitch, &slice_pitch,
-              num_events_wait_list,
-              events_wait_list,
+              wait_list.size(),
+              wait_list.data(),
               no_event ? NULL : &event, &ret);
 
-  if(events_wait_list) delete[] events_wait_list;
-
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
     REQ_ERROR_THROW(INVALID_CONTEXT);
@@ -1262,52 +1632,47 @@ NAN_METHOD(CommandQueue::enqueueMapImage)
 
   // TODO: return image_row_pitch, image_slice_pitch?
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[6]->ToObject());
-    e->setEvent(event);
-  }
+  // mapped bytes up to the end of the last row of the region
+  size_t element_size=0;
+  ::clGetImageInfo(mo->getMemory(), CL_IMAGE_ELEMENT_SIZE, sizeof(size_t), &element_size, NULL);
+  size_t nbytes = (region[2]-1) * slice_pitch + (region[1]-1) * row_pitch + region[0] * element_size;
+  Local<Object> view=MappingTable::add(mo->getMemory(), result, nbytes);
+
+  SET_EVENT_ARG(6);
 
-  size_t nbytes = region[0] * region[1] * region[2];
-  NanReturnValue(NanNewBufferHandle((char*)result, nbytes, free_callback, NULL));
+  NanReturnValue(view);
 }
 
 NAN_METHOD(CommandQueue::enqueueUnmapMemObject)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
 
   // TODO: arg checking
   MemoryObject *mo = ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject());
-  Local<Object> buf(args[1]->ToObject());
 
-  MakeEventWaitList(args[2]);
+  // only regions mapped by enqueueMap* can be unmapped
+  void *data=MappingTable::find(mo->getMemory(), args[1]);
+  if(!data) {
+    cl_int ret=CL_INVALID_VALUE;
+    REQ_ERROR_THROW(INVALID_VALUE);
+  }
+
+  EventWaitList wait_list;
+  if(!wait_list.set(args[2]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_event event;
   bool no_event = (args[3]->IsUndefined() || args[3]->IsNull());
 
-  // printf("[unmap] wrapped data %p, memobject %p\n", node::Buffer::Data(buf),mo->getMemory());
-  // printf("[unmap] Before Unmap: ");
-  char *data= (char*)node::Buffer::Data(buf);
-  // for(int i=0;i<20;i++) {
-  //   printf("%d ", data[i]);
-  // }
-  // printf("\n");
-
   cl_int ret=::clEnqueueUnmapMemObject(
       cq->getCommandQueue(), mo->getMemory(),
       data,
-      num_events_wait_list,
-      events_wait_list,
+      wait_list.size(),
+      wait_list.data(),
       no_event ? NULL : &event);
 
-  // printf("[unmap] After Unmap: ");
-  // for(int i=0;i<20;i++) {
-  //   printf("%d ",data[i]);
-  // }
-  // printf("\n");
-
-  if(events_wait_list) delete[] events_wait_list;
-
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
     REQ_ERROR_THROW(INVALID_CONTEXT);
@@ -1320,10 +1685,10 @@ NAN_METHOD(CommandQueue::enqueueUnmapMemObject)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[3]->ToObject());
-    e->setEvent(event);
-  }
+  // JS loses access now, the driver may reclaim the region at any time
+  MappingTable::remove(mo->getMemory(), data);
+
+  SET_EVENT_ARG(3);
   NanReturnUndefined();
 }
 
@@ -1331,6 +1696,7 @@ NAN_METHOD(CommandQueue::enqueueMarker)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
 
   cl_event event;
   bool no_event = (args[0]->IsUndefined() || args[0]->IsNull());
@@ -1345,10 +1711,7 @@ NAN_METHOD(CommandQueue::enqueueMarker)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[0]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG(0);
   NanReturnUndefined();
 }
 
@@ -1356,15 +1719,16 @@ NAN_METHOD(CommandQueue::enqueueWaitForEvents)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
 
-  MakeEventWaitList(args[0]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[0]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_int ret = ::clEnqueueWaitForEvents(
       cq->getCommandQueue(),
-      num_events_wait_list,
-      events_wait_list);
-
-  if(events_wait_list) delete[] events_wait_list;
+      wait_list.size(),
+      wait_list.data());
 
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
@@ -1384,19 +1748,22 @@ NAN_METHOD(CommandQueue::enqueueBarrier)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
 
-  MakeEventWaitList(args[0]);
+  EventWaitList wait_list;
+  if(!wait_list.set(args[0]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
-  cl_event event=NULL;
+  cl_event event;
   bool no_event = (args[1]->IsUndefined() || args[1]->IsNull());
 
   cl_int ret = ::clEnqueueBarrier(cq->getCommandQueue());
 
-  if(events_wait_list && ret==CL_SUCCESS) {
+  if(wait_list.size()>0 && ret==CL_SUCCESS) {
     cl_int ret2 = ::clEnqueueWaitForEvents(
         cq->getCommandQueue(),
-        num_events_wait_list,
-        events_wait_list);
+        wait_list.size(),
+        wait_list.data());
 
     if (ret2 != CL_SUCCESS) {
       REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
@@ -1407,10 +1774,12 @@ NAN_METHOD(CommandQueue::enqueueBarrier)
       REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
       return NanThrowError("UNKNOWN ERROR");
     }
-
-    delete[] events_wait_list;
   }
 
+  // a barrier has no event, the marker behind it completes with it
+  if(!no_event && ret==CL_SUCCESS)
+    ret = ::clEnqueueMarker(cq->getCommandQueue(), &event);
+
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
     REQ_ERROR_THROW(OUT_OF_RESOURCES);
@@ -1418,80 +1787,153 @@ NAN_METHOD(CommandQueue::enqueueBarrier)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event && event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[1]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG(1);
   NanReturnUndefined();
 }
 
-class FinishWorker : public NanAsyncWorker {
- public:
-  FinishWorker(Baton *baton)
-    : NanAsyncWorker(baton->callback), baton_(baton) {
-    }
+NAN_METHOD(CommandQueue::submit)
+{
+  NanScope();
+  CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
+  CommandList *list = ObjectWrap::Unwrap<CommandList>(args[0]->ToObject());
 
-  ~FinishWorker() {
-    if(baton_) {
-      NanScope();
-      if (!baton_->parent.IsEmpty()) NanDisposePersistent(baton_->parent);
-      // if (baton_->callback) delete baton_->callback;
-      delete baton_;
-    }
-  }
+  EventWaitList wait_list;
+  if(!wait_list.set(args[1]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
-  // Executed inside the worker-thread.
-  // It is not safe to access V8, or V8 data structures
-  // here, so everything we need for input and output
-  // should go on `this`.
-  void Execute () {
-    // SetErrorMessage("Error");
-    // printf("[async event] execute\n");
-    CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(NanNew(baton_->parent));
+  cl_event event=NULL;
+  bool no_event = (args[2]->IsUndefined() || args[2]->IsNull());
 
-    cl_int ret = ::clFinish(cq->getCommandQueue());
-    if (ret != CL_SUCCESS) {
-      REQ_ERROR_THROW_NONE(INVALID_COMMAND_QUEUE);
-      REQ_ERROR_THROW_NONE(OUT_OF_RESOURCES);
-      REQ_ERROR_THROW_NONE(OUT_OF_HOST_MEMORY);
-	    return;
-    }
+  cl_int ret=list->submit(
+      cq->getCommandQueue(),
+      wait_list.size(),
+      wait_list.data(),
+      no_event ? NULL : &event);
+
+  if (ret != CL_SUCCESS) {
+    REQ_ERROR_THROW(INVALID_PROGRAM_EXECUTABLE);
+    REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
+    REQ_ERROR_THROW(INVALID_KERNEL);
+    REQ_ERROR_THROW(INVALID_CONTEXT);
+    REQ_ERROR_THROW(INVALID_MEM_OBJECT);
+    REQ_ERROR_THROW(INVALID_VALUE);
+    REQ_ERROR_THROW(INVALID_KERNEL_ARGS);
+    REQ_ERROR_THROW(INVALID_WORK_DIMENSION);
+    REQ_ERROR_THROW(INVALID_GLOBAL_WORK_SIZE);
+    REQ_ERROR_THROW(INVALID_GLOBAL_OFFSET);
+    REQ_ERROR_THROW(INVALID_WORK_GROUP_SIZE);
+    REQ_ERROR_THROW(INVALID_WORK_ITEM_SIZE);
+    REQ_ERROR_THROW(INVALID_EVENT_WAIT_LIST);
+    REQ_ERROR_THROW(MISALIGNED_SUB_BUFFER_OFFSET);
+    REQ_ERROR_THROW(EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST);
+    REQ_ERROR_THROW(MEM_COPY_OVERLAP);
+    REQ_ERROR_THROW(MEM_OBJECT_ALLOCATION_FAILURE);
+    REQ_ERROR_THROW(INVALID_OPERATION);
+    REQ_ERROR_THROW(OUT_OF_RESOURCES);
+    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
+    return NanThrowError("UNKNOWN ERROR");
   }
 
-  // Executed when the async work is complete
-  // this function will be run inside the main event loop
-  // so it is safe to use V8 again
-  void HandleOKCallback () {
-    NanScope();
+  SET_EVENT_ARG(2);
+  NanReturnUndefined();
+}
+
+NAN_METHOD(CommandQueue::beginCapture)
+{
+  NanScope();
+  CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
+
+  cq->capture_graph=CommandGraph::New();
+  NanAssignPersistent(cq->capture_handle, NanObjectWrapHandle(cq->capture_graph));
 
-    // // must return passed data
-    Local<Value> argv[] = {
-      NanNew(baton_->parent),  // event
-    };
+  NanReturnUndefined();
+}
 
-    // printf("[async event] callback JS\n");
-    callback->Call(1, argv);
-  }
+NAN_METHOD(CommandQueue::endCapture)
+{
+  NanScope();
+  CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+
+  if(!cq->isCapturing())
+    return NanThrowError("INVALID_OPERATION: queue is not capturing");
+
+  Local<Object> graph=NanNew(cq->capture_handle);
+  NanDisposePersistent(cq->capture_handle);
+  cq->capture_graph=NULL;
+
+  NanReturnValue(graph);
+}
+
+NAN_METHOD(CommandQueue::replay)
+{
+  NanScope();
+  CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
+  CommandGraph *graph = ObjectWrap::Unwrap<CommandGraph>(args[0]->ToObject());
+
+  EventWaitList wait_list;
+  if(!wait_list.set(args[1]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
-  private:
-    Baton *baton_;
-};
+  cl_event event=NULL;
+  bool no_event = (args[2]->IsUndefined() || args[2]->IsNull());
+
+  cl_int ret=graph->submit(
+      cq->getCommandQueue(),
+      wait_list.size(),
+      wait_list.data(),
+      no_event ? NULL : &event);
+
+  if (ret != CL_SUCCESS) {
+    REQ_ERROR_THROW(INVALID_PROGRAM_EXECUTABLE);
+    REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
+    REQ_ERROR_THROW(INVALID_KERNEL);
+    REQ_ERROR_THROW(INVALID_CONTEXT);
+    REQ_ERROR_THROW(INVALID_MEM_OBJECT);
+    REQ_ERROR_THROW(INVALID_VALUE);
+    REQ_ERROR_THROW(INVALID_KERNEL_ARGS);
+    REQ_ERROR_THROW(INVALID_WORK_DIMENSION);
+    REQ_ERROR_THROW(INVALID_GLOBAL_WORK_SIZE);
+    REQ_ERROR_THROW(INVALID_GLOBAL_OFFSET);
+    REQ_ERROR_THROW(INVALID_WORK_GROUP_SIZE);
+    REQ_ERROR_THROW(INVALID_WORK_ITEM_SIZE);
+    REQ_ERROR_THROW(INVALID_EVENT_WAIT_LIST);
+    REQ_ERROR_THROW(MISALIGNED_SUB_BUFFER_OFFSET);
+    REQ_ERROR_THROW(EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST);
+    REQ_ERROR_THROW(MEM_COPY_OVERLAP);
+    REQ_ERROR_THROW(MEM_OBJECT_ALLOCATION_FAILURE);
+    REQ_ERROR_THROW(INVALID_OPERATION);
+    REQ_ERROR_THROW(OUT_OF_RESOURCES);
+    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
+    return NanThrowError("UNKNOWN ERROR");
+  }
 
+  SET_EVENT_ARG(2);
+  NanReturnUndefined();
+}
 
 NAN_METHOD(CommandQueue::finish)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
 
+  cl_int ret;
   if(args.Length()>0 && args[0]->IsFunction()) {
-      Baton *baton=new Baton();
-      NanAssignPersistent(baton->parent, NanObjectWrapHandle(cq));
-      baton->callback=new NanCallback(args[0].As<Function>());
-      NanAsyncQueueWorker(new FinishWorker(baton));
-      NanReturnUndefined();
+    // a marker completes once all previous commands have, callback(queue)
+    // then runs from the completion dispatcher without blocking a thread
+    cl_event event;
+    ret = ::clEnqueueMarker(cq->getCommandQueue(), &event);
+    if(ret == CL_SUCCESS) {
+      ret = ::clFlush(cq->getCommandQueue());
+      if(ret == CL_SUCCESS)
+        ret = Completion::watchAll(&event, 1, args[0].As<Function>(), NanObjectWrapHandle(cq));
+      ::clReleaseEvent(event);
+    }
   }
-
-  cl_int ret = ::clFinish(cq->getCommandQueue());
+  else
+    ret = ::clFinish(cq->getCommandQueue());
 
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_COMMAND_QUEUE);
@@ -1519,10 +1961,35 @@ NAN_METHOD(CommandQueue::flush)
   NanReturnUndefined();
 }
 
+NAN_METHOD(CommandQueue::setStagingOptions)
+{
+  NanScope();
+  CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+
+  StagingPool *staging=cq->getStaging();
+  staging->configure(args[0]->IsUndefined() ? staging->getThreshold() : SizeValue(args[0]),
+                     SizeValue(args[1]), args[2]->Uint32Value());
+
+  NanReturnUndefined();
+}
+
+NAN_GETTER(CommandQueue::GetStagedBytes)
+{
+  NanScope();
+  CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  double bytes = cq->staging ? cq->staging->stagedBytes() : 0;
+  NanReturnValue(JS_NUM(bytes));
+}
+
 NAN_METHOD(CommandQueue::enqueueAcquireGLObjects)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
+
+  EventWaitList wait_list;
+  if(!wait_list.set(args[1]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_mem *mem_objects=NULL;
   int num_objects=0;
@@ -1541,19 +2008,16 @@ NAN_METHOD(CommandQueue::enqueueAcquireGLObjects)
     mem_objects[0]=ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject())->getMemory();
   }
 
-  MakeEventWaitList(args[1]);
-
   cl_event event;
   bool no_event = (args[2]->IsUndefined() || args[2]->IsNull());
 
   int ret = ::clEnqueueAcquireGLObjects(cq->getCommandQueue(),
       num_objects, mem_objects,
-      num_events_wait_list,
-      events_wait_list,
+      wait_list.size(),
+      wait_list.data(),
       no_event ? NULL : &event);
 
   if(mem_objects) delete[] mem_objects;
-  if(events_wait_list) delete[] events_wait_list;
 
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_VALUE);
@@ -1567,10 +2031,7 @@ NAN_METHOD(CommandQueue::enqueueAcquireGLObjects)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[2]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG(2);
   NanReturnUndefined();
 }
 
@@ -1578,6 +2039,11 @@ NAN_METHOD(CommandQueue::enqueueReleaseGLObjects)
 {
   NanScope();
   CommandQueue *cq = ObjectWrap::Unwrap<CommandQueue>(args.This());
+  REQ_NOT_CAPTURING(cq);
+
+  EventWaitList wait_list;
+  if(!wait_list.set(args[1]))
+    return NanThrowError("INVALID_EVENT_WAIT_LIST");
 
   cl_mem *mem_objects=NULL;
   int num_objects=0;
@@ -1596,19 +2062,16 @@ NAN_METHOD(CommandQueue::enqueueReleaseGLObjects)
     mem_objects[0]=ObjectWrap::Unwrap<MemoryObject>(args[0]->ToObject())->getMemory();
   }
 
-  MakeEventWaitList(args[1]);
-
   cl_event event;
   bool no_event = (args[2]->IsUndefined() || args[2]->IsNull());
 
   int ret = ::clEnqueueReleaseGLObjects(cq->getCommandQueue(),
       num_objects, mem_objects,
-      num_events_wait_list,
-      events_wait_list,
+      wait_list.size(),
+      wait_list.data(),
       no_event ? NULL : &event);
 
   if(mem_objects) delete[] mem_objects;
-  if(events_wait_list) delete[] events_wait_list;
 
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_VALUE);
@@ -1622,10 +2085,7 @@ NAN_METHOD(CommandQueue::enqueueReleaseGLObjects)
     return NanThrowError("UNKNOWN ERROR");
   }
 
-  if(!no_event) {
-    Event *e=ObjectWrap::Unwrap<Event>(args[2]->ToObject());
-    e->setEvent(event);
-  }
+  SET_EVENT_ARG(2);
   NanReturnUndefined();
 }
 
@@ -1649,6 +2109,7 @@ CommandQueue *CommandQueue::New(cl_command_queue cw)
 
   CommandQueue *commandqueue = ObjectWrap::Unwrap<CommandQueue>(obj);
   commandqueue->command_queue = cw;
+  mapCLObj(commandqueue, cw);
 
   return commandqueue;
 }
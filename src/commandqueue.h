@@ -31,6 +31,10 @@
 
 namespace webcl {
 
+class CommandGraph;
+class Kernel;
+class StagingPool;
+
 class CommandQueue : public WebCLObject
 {
 
@@ -62,6 +66,19 @@ public:
   // Executing kernels
   static NAN_METHOD(enqueueNDRangeKernel);
   static NAN_METHOD(enqueueTask);
+  static NAN_METHOD(tuneNDRangeKernel);
+
+  // Padded launches over arbitrary extents
+  static NAN_METHOD(planNDRange);
+  static NAN_METHOD(enqueuePaddedNDRangeKernel);
+
+  // Recorded command lists
+  static NAN_METHOD(submit);
+
+  // Capture and replay
+  static NAN_METHOD(beginCapture);
+  static NAN_METHOD(endCapture);
+  static NAN_METHOD(replay);
 
   // Synchronization
   static NAN_METHOD(enqueueMarker);
@@ -79,19 +96,37 @@ public:
   static NAN_METHOD(enqueueMapImage);
   static NAN_METHOD(enqueueUnmapMemObject);
 
+  // Pinned staging of large transfers
+  static NAN_METHOD(setStagingOptions);
+  static NAN_GETTER(GetStagedBytes);
+
   // CL-GL
   static NAN_METHOD(enqueueAcquireGLObjects);
   static NAN_METHOD(enqueueReleaseGLObjects);
 
   cl_command_queue getCommandQueue() const { return command_queue; };
-  virtual bool isEqual(void *clObj) { return ((cl_command_queue)clObj)==command_queue; }
+  bool isCapturing() const { return capture_graph!=NULL; }
+  cl_device_id getDevice();
 
 private:
   CommandQueue(v8::Handle<v8::Object> wrapper);
 
   static v8::Persistent<v8::FunctionTemplate> constructor_template;
 
+  static _NAN_METHOD_RETURN_TYPE launchKernel(_NAN_METHOD_ARGS_TYPE args, CommandQueue *cq, Kernel *kernel,
+                                              cl_uint workDim, const size_t *offsets,
+                                              const size_t *globals, const size_t *locals);
+
   cl_command_queue command_queue;
+  cl_device_id device; // read on first use
+
+  // graph receiving enqueued commands while capturing
+  CommandGraph *capture_graph;
+  v8::Persistent<v8::Object> capture_handle;
+
+  // created by the first transfer large enough to be staged
+  StagingPool *staging;
+  StagingPool *getStaging();
 };
 
 } // namespace
@@ -83,6 +83,13 @@ namespace {
 #define JS_BOOL(val) NanNew((bool)val)
 #define JS_RETHROW(tc) v8::Local<v8::Value>::New(tc.Exception());
 
+// Sizes and offsets of memory objects. Doubles hold them exactly up to
+// 2^53 bytes, Uint32Value() would truncate them at 4GB.
+inline size_t SizeValue(v8::Handle<v8::Value> value) {
+  double d=value->NumberValue();
+  return d>0 ? (size_t) d : 0;
+}
+
 #define REQ_ARGS(N)                                                     \
   if (args.Length() < (N))                                              \
     NanThrowTypeError("Expected " #N " arguments");
@@ -139,6 +146,7 @@ struct Baton {
 class WebCLObject;
 void registerCLObj(WebCLObject* obj);
 void unregisterCLObj(WebCLObject* obj);
+void mapCLObj(WebCLObject* obj, void* clObj);
 void AtExit(void* arg);
 
 namespace CLObjType {
@@ -154,14 +162,15 @@ enum CLObjType {
   Event,
   MemoryObject,
   Exception,
+  NumTypes
 };
 }
 
-WebCLObject* findCLObj(void* type);
+WebCLObject* findCLObj(void* clObj);
 
 class WebCLObject : public node::ObjectWrap {
 protected:
-  WebCLObject() : _type(CLObjType::None) {}
+  WebCLObject() : _type(CLObjType::None), _clObj(NULL), _slot(-1) {}
   // virtual ~WebCLObject() {
   //   // printf("Destructor WebCLObject\n");
   //   // Destructor();
@@ -185,10 +194,19 @@ public:
   bool isSampler() const { return isA(_type, CLObjType::Sampler); }
   bool isEvent() const { return isA(_type, CLObjType::Event); }
   bool isContext() const { return isA(_type, CLObjType::Context); }
-  virtual bool isEqual(void *clObj) { return false; }
 
 protected:
   CLObjType::CLObjType _type;
+
+private:
+  // registry bookkeeping, see webcl.cc
+  friend void registerCLObj(WebCLObject* obj);
+  friend void unregisterCLObj(WebCLObject* obj);
+  friend void mapCLObj(WebCLObject* obj, void* clObj);
+  friend void AtExit(void* arg);
+
+  void *_clObj; // OpenCL handle this object is indexed under
+  int _slot;    // position in its type bucket, -1 if not registered
 };
 
 } // namespace webcl
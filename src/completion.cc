@@ -0,0 +1,218 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "completion.h"
+#include "event.h"
+
+using namespace node;
+using namespace v8;
+
+namespace webcl {
+
+uv_async_t Completion::async;
+std::atomic<Completion*> Completion::completed(NULL);
+unsigned int Completion::pending=0;
+
+void Completion::Init()
+{
+  uv_async_init(uv_default_loop(), &async, dispatch);
+
+  // only keeps the loop alive while completions are pending
+  uv_unref((uv_handle_t*) &async);
+}
+
+struct Completion::Group {
+  NanCallback callback;
+  v8::Persistent<v8::Value> result;
+  cl_uint remaining;
+  cl_int status;
+
+  Group(Local<Function> callback, cl_uint num_events)
+    : callback(callback), remaining(num_events), status(CL_COMPLETE) {}
+  ~Group() {
+    if(!result.IsEmpty())
+      NanDisposePersistent(result);
+  }
+};
+
+Completion::Completion(cl_event event)
+  : event(event), status(CL_COMPLETE), group(NULL), next(NULL)
+{
+  ::clRetainEvent(event);
+}
+
+Completion::~Completion()
+{
+  ::clReleaseEvent(event);
+  if(!pinned.IsEmpty())
+    NanDisposePersistent(pinned);
+  if(!parent.IsEmpty())
+    NanDisposePersistent(parent);
+}
+
+cl_int Completion::enqueue(cl_int exec_type)
+{
+  cl_int ret=::clSetEventCallback(event, exec_type, notify, this);
+  if(ret!=CL_SUCCESS) {
+    delete this;
+    return ret;
+  }
+
+  if(pending++==0)
+    uv_ref((uv_handle_t*) &async);
+  return CL_SUCCESS;
+}
+
+cl_int Completion::watch(cl_event event, Local<Function> callback, Local<Value> pinned)
+{
+  Completion *c=new Completion(event);
+  c->callback.SetFunction(callback);
+  if(!pinned.IsEmpty() && pinned->IsObject())
+    NanAssignPersistent(c->pinned, pinned);
+  return c->enqueue(CL_COMPLETE);
+}
+
+cl_int Completion::watch(Event *parent, cl_int exec_type, Local<Function> callback,
+                         Local<Value> data)
+{
+  Completion *c=new Completion(parent->getEvent());
+  c->callback.SetFunction(callback);
+  NanAssignPersistent(c->parent, NanObjectWrapHandle(parent));
+  if(!data.IsEmpty() && !data->IsUndefined() && !data->IsNull())
+    NanAssignPersistent(c->pinned, data);
+  return c->enqueue(exec_type);
+}
+
+cl_int Completion::watchAll(const cl_event *events, cl_uint num_events,
+                            Local<Function> callback, Local<Value> result)
+{
+  if(num_events==0)
+    return CL_INVALID_VALUE;
+
+  Group *group=new Group(callback, num_events);
+  if(!result.IsEmpty())
+    NanAssignPersistent(group->result, result);
+
+  for(cl_uint i=0;i<num_events;i++) {
+    Completion *c=new Completion(events[i]);
+    c->group=group;
+    cl_int ret=c->enqueue(CL_COMPLETE);
+    if(ret!=CL_SUCCESS) {
+      // events already watched report the error when they complete
+      group->status=ret;
+      group->remaining-=num_events-i;
+      if(group->remaining==0) {
+        delete group;
+        return ret;
+      }
+      break;
+    }
+  }
+  return CL_SUCCESS;
+}
+
+void CL_CALLBACK Completion::notify(cl_event event, cl_int status, void *user_data)
+{
+  Completion *c=static_cast<Completion*>(user_data);
+  c->status=status;
+
+  // lock-free push; only the push onto an empty queue needs to wake the
+  // loop, later ones are drained by the same dispatch
+  c->next=completed.load(std::memory_order_relaxed);
+  while(!completed.compare_exchange_weak(c->next, c,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed))
+    ;
+  if(!c->next)
+    uv_async_send(&async);
+}
+
+NAUV_WORK_CB(Completion::dispatch)
+{
+  NanScope();
+
+  // take the whole queue and restore completion order
+  Completion *c=completed.exchange(NULL, std::memory_order_acquire);
+  Completion *batch=NULL;
+  while(c) {
+    Completion *next=c->next;
+    c->next=batch;
+    batch=c;
+    c=next;
+  }
+
+  while(batch) {
+    c=batch;
+    batch=batch->next;
+    c->run();
+    delete c;
+
+    if(--pending==0)
+      uv_unref((uv_handle_t*) &async);
+  }
+}
+
+void Completion::run()
+{
+  NanScope();
+
+  if(group) {
+    if(status<0 && group->status>=0)
+      group->status=status;
+    if(--group->remaining>0)
+      return;
+
+    Local<Value> argv[] = {
+      group->result.IsEmpty() ? Local<Value>(JS_INT(group->status)) : NanNew(group->result)
+    };
+    group->callback.Call(1, argv);
+    delete group;
+    return;
+  }
+
+  if(parent.IsEmpty()) {
+    Local<Value> argv[] = { JS_INT(status) };
+    callback.Call(1, argv);
+    return;
+  }
+
+  Local<Object> p = NanNew(parent);
+  ObjectWrap::Unwrap<Event>(p)->setStatus(status);
+
+  if(pinned.IsEmpty()) {
+    Local<Value> argv[] = { p };
+    callback.Call(1, argv);
+  }
+  else {
+    Local<Value> argv[] = {
+      p,               // event
+      NanNew(pinned)   // user's message
+    };
+    callback.Call(2, argv);
+  }
+}
+
+} // namespace
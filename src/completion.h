@@ -0,0 +1,97 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMPLETION_H_
+#define COMPLETION_H_
+
+#include "common.h"
+#include <atomic>
+
+namespace webcl {
+
+class Event;
+
+// Shared completion dispatcher for event callbacks and asynchronous
+// enqueues. OpenCL reports command status on its own threads; the driver
+// callback only pushes a Completion onto a lock-free multi-producer queue
+// and wakes the main loop through a single uv_async_t. The loop then drains
+// every queued completion in one batch. No libuv threadpool work is used.
+class Completion
+{
+
+public:
+  static void Init();
+
+  // Calls callback(status) on the main loop once event has completed,
+  // status being CL_COMPLETE or a negative error code. The event is retained
+  // until then, and so is pinned (e.g. the host memory of a transfer) if
+  // given.
+  static cl_int watch(cl_event event, v8::Local<v8::Function> callback,
+                      v8::Local<v8::Value> pinned = v8::Local<v8::Value>());
+
+  // WebCLEvent.setCallback: sets the status of parent and calls
+  // callback(parent [, data]) once it reaches exec_type.
+  static cl_int watch(Event *parent, cl_int exec_type, v8::Local<v8::Function> callback,
+                      v8::Local<v8::Value> data);
+
+  // Asynchronous finish() and waitForEvents(): calls callback once all
+  // events have completed, with result if given, else with CL_COMPLETE or
+  // the first error status. Waits only hold one Completion per event, so
+  // any number of them can be pending.
+  static cl_int watchAll(const cl_event *events, cl_uint num_events,
+                         v8::Local<v8::Function> callback,
+                         v8::Local<v8::Value> result = v8::Local<v8::Value>());
+
+private:
+  struct Group;
+
+  Completion(cl_event event);
+  ~Completion();
+
+  cl_int enqueue(cl_int exec_type);
+
+  // called by clSetEventCallback
+  static void CL_CALLBACK notify(cl_event event, cl_int status, void *user_data);
+  static NAUV_WORK_CB(dispatch);
+  void run();
+
+  cl_event event;
+  cl_int status;
+  NanCallback callback;
+  v8::Persistent<v8::Value> pinned;  // also user data of event callbacks
+  v8::Persistent<v8::Object> parent; // WebCLEvent of event callbacks
+  Group *group;                      // wait on several events
+
+  Completion *next;
+
+  static uv_async_t async;
+  static std::atomic<Completion*> completed; // pushed by CL threads, newest first
+  static unsigned int pending;               // main thread only
+};
+
+} // namespace
+
+#endif
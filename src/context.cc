@@ -25,12 +25,16 @@
 // THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "context.h"
+#include "bufferarena.h"
+#include "bufferpool.h"
 #include "device.h"
+#include "commandlist.h"
 #include "commandqueue.h"
 #include "event.h"
 #include "platform.h"
 #include "memoryobject.h"
 #include "program.h"
+#include "programlibrary.h"
 #include "sampler.h"
 
 #include <node_buffer.h>
@@ -56,11 +60,21 @@ void Context::Init(Handle<Object> target)
   // prototype
   NODE_SET_PROTOTYPE_METHOD(ctor, "_getInfo", getInfo);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_createProgram", createProgram);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_createCachedProgram", createCachedProgram);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_addCachedProgram", addCachedProgram);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_setProgramLibraryBudget", setProgramLibraryBudget);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_getProgramLibraryStats", getProgramLibraryStats);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_createCommandQueue", createCommandQueue);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_createBuffer", createBuffer);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_createPooledBuffer", createPooledBuffer);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_setBufferPoolLimits", setBufferPoolLimits);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_trimBufferPool", trimBufferPool);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_getBufferPoolStats", getBufferPoolStats);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_createBufferArena", createBufferArena);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_createImage", createImage);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_createSampler", createSampler);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_createUserEvent", createUserEvent);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_createCommandList", createCommandList);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_createFromGLBuffer", createFromGLBuffer);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_createFromGLTexture", createFromGLTexture);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_createFromGLRenderbuffer", createFromGLRenderbuffer);
@@ -71,7 +85,7 @@ void Context::Init(Handle<Object> target)
   target->Set(NanNew("WebCLContext"), ctor->GetFunction());
 }
 
-Context::Context(Handle<Object> wrapper) : context(0)
+Context::Context(Handle<Object> wrapper) : context(0), pool(NULL), library(NULL)
 {
   _type=CLObjType::Context;
 }
@@ -81,10 +95,35 @@ void Context::Destructor()
   #ifdef LOGGING
   cout<<"  Destroying CL context"<<endl;
   #endif
+  if(pool) {
+    // buffers still handed out keep the pool alive but are no longer cached
+    pool->close();
+    pool->release();
+    pool=NULL;
+  }
+  if(library) {
+    // programs still held by their users are released by them
+    delete library;
+    library=NULL;
+  }
   if(context) ::clReleaseContext(context);
   context=0;
 }
 
+BufferPool *Context::getPool()
+{
+  if(!pool)
+    pool=new BufferPool(context);
+  return pool;
+}
+
+ProgramLibrary *Context::getLibrary()
+{
+  if(!library)
+    library=new ProgramLibrary(context);
+  return library;
+}
+
 NAN_METHOD(Context::release)
 {
   printf("Context::release delete all objects in context and release context\n");
@@ -209,7 +248,9 @@ NAN_METHOD(Context::createProgram)
       REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
       return NanThrowError("UNKNOWN ERROR");
     }
-    NanReturnValue(NanObjectWrapHandle(Program::New(pw)));
+    Program *prog=Program::New(pw);
+    prog->setSource(std::string(*astr, astr.length()));
+    NanReturnValue(NanObjectWrapHandle(prog));
   }
   else if(args[0]->IsArray()){
     Local<Array> devArray = Local<Array>::Cast(args[0]);
@@ -254,6 +295,81 @@ NAN_METHOD(Context::createProgram)
   NanReturnUndefined();
 }
 
+NAN_METHOD(Context::createCachedProgram)
+{
+  NanScope();
+  Context *context = ObjectWrap::Unwrap<Context>(args.This());
+
+  String::Utf8Value source(args[0]);
+  std::string options;
+  if(args[1]->IsString()) {
+    String::Utf8Value str(args[1]);
+    options.assign(*str, str.length());
+  }
+
+  cl_int ret=CL_SUCCESS;
+  Program *prog=context->getLibrary()->acquire(std::string(*source, source.length()), options, &ret);
+
+  if (ret != CL_SUCCESS) {
+    REQ_ERROR_THROW(INVALID_CONTEXT);
+    REQ_ERROR_THROW(INVALID_VALUE);
+    REQ_ERROR_THROW(INVALID_BUILD_OPTIONS);
+    REQ_ERROR_THROW(COMPILER_NOT_AVAILABLE);
+    REQ_ERROR_THROW(BUILD_PROGRAM_FAILURE);
+    REQ_ERROR_THROW(OUT_OF_RESOURCES);
+    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
+    return NanThrowError("UNKNOWN ERROR");
+  }
+
+  // each caller gets its own handle, so releasing it twice is harmless
+  if(prog->getLibrary())
+    prog=Program::NewHolder(prog);
+
+  NanReturnValue(NanObjectWrapHandle(prog));
+}
+
+NAN_METHOD(Context::addCachedProgram)
+{
+  NanScope();
+  Context *context = ObjectWrap::Unwrap<Context>(args.This());
+  Program *prog = ObjectWrap::Unwrap<Program>(args[0]->ToObject());
+
+  NanReturnValue(NanNew<Boolean>(context->getLibrary()->add(prog, args[1]->BooleanValue())));
+}
+
+NAN_METHOD(Context::setProgramLibraryBudget)
+{
+  NanScope();
+  Context *context = ObjectWrap::Unwrap<Context>(args.This());
+
+  context->getLibrary()->setBudget(SizeValue(args[0]));
+
+  NanReturnUndefined();
+}
+
+NAN_METHOD(Context::getProgramLibraryStats)
+{
+  NanScope();
+  Context *context = ObjectWrap::Unwrap<Context>(args.This());
+
+  ProgramLibrary::Stats stats={ 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+  if(context->library)
+    stats=context->library->stats();
+
+  Local<Object> obj = NanNew<Object>();
+  obj->Set(JS_STR("hits"), JS_NUM(stats.hits));
+  obj->Set(JS_STR("misses"), JS_NUM(stats.misses));
+  obj->Set(JS_STR("evictions"), JS_NUM(stats.evictions));
+  obj->Set(JS_STR("kernelHits"), JS_NUM(stats.kernel_hits));
+  obj->Set(JS_STR("kernelMisses"), JS_NUM(stats.kernel_misses));
+  obj->Set(JS_STR("programs"), JS_NUM(stats.programs));
+  obj->Set(JS_STR("programsInUse"), JS_NUM(stats.programs_in_use));
+  obj->Set(JS_STR("programsPinned"), JS_NUM(stats.programs_pinned));
+  obj->Set(JS_STR("bytes"), JS_NUM(stats.bytes));
+
+  NanReturnValue(obj);
+}
+
 NAN_METHOD(Context::createCommandQueue)
 {
   NanScope();
@@ -395,7 +511,7 @@ NAN_METHOD(Context::createBuffer)
   NanScope();
   Context *context = ObjectWrap::Unwrap<Context>(args.This());
   cl_mem_flags flags = args[0]->Uint32Value();
-  size_t size = args[1]->Uint32Value();
+  size_t size = SizeValue(args[1]);
   void *host_ptr = NULL;
   if(!args[2]->IsNull() && !args[2]->IsUndefined()) {
     if(args[2]->IsArray()) {
@@ -437,6 +553,141 @@ NAN_METHOD(Context::createBuffer)
   NanReturnValue(NanObjectWrapHandle(WebCLBuffer::New(mw)));
 }
 
+NAN_METHOD(Context::createPooledBuffer)
+{
+  NanScope();
+  Context *context = ObjectWrap::Unwrap<Context>(args.This());
+  cl_mem_flags flags = args[0]->Uint32Value();
+  size_t size = SizeValue(args[1]);
+
+  // pooled buffers are shared between unrelated requests, their contents
+  // can't come from a host pointer
+  cl_int ret=CL_SUCCESS;
+  if(size==0) {
+    ret=CL_INVALID_BUFFER_SIZE;
+    REQ_ERROR_THROW(INVALID_BUFFER_SIZE);
+  }
+  if(flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR)) {
+    ret=CL_INVALID_VALUE;
+    REQ_ERROR_THROW(INVALID_VALUE);
+  }
+
+  size_t class_size=0;
+  cl_mem mw = context->getPool()->acquire(flags, size, &class_size, &ret);
+
+  if (ret != CL_SUCCESS) {
+    REQ_ERROR_THROW(INVALID_CONTEXT);
+    REQ_ERROR_THROW(INVALID_VALUE);
+    REQ_ERROR_THROW(INVALID_BUFFER_SIZE);
+    REQ_ERROR_THROW(MEM_OBJECT_ALLOCATION_FAILURE);
+    REQ_ERROR_THROW(OUT_OF_RESOURCES);
+    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
+    return NanThrowError("UNKNOWN ERROR");
+  }
+
+  WebCLBuffer *buffer=WebCLBuffer::New(mw);
+  buffer->setOwner(context->pool, flags, class_size);
+  NanReturnValue(NanObjectWrapHandle(buffer));
+}
+
+NAN_METHOD(Context::setBufferPoolLimits)
+{
+  NanScope();
+  Context *context = ObjectWrap::Unwrap<Context>(args.This());
+
+  context->getPool()->setLimits(SizeValue(args[0]), SizeValue(args[1]));
+
+  NanReturnUndefined();
+}
+
+NAN_METHOD(Context::trimBufferPool)
+{
+  NanScope();
+  Context *context = ObjectWrap::Unwrap<Context>(args.This());
+
+  if(context->pool)
+    context->pool->trim(SizeValue(args[0]));
+
+  NanReturnUndefined();
+}
+
+NAN_METHOD(Context::getBufferPoolStats)
+{
+  NanScope();
+  Context *context = ObjectWrap::Unwrap<Context>(args.This());
+
+  BufferPool::Stats stats={ 0, 0, 0, 0, 0, 0 };
+  if(context->pool)
+    stats=context->pool->stats();
+
+  Local<Object> obj = NanNew<Object>();
+  obj->Set(JS_STR("hits"), JS_NUM(stats.hits));
+  obj->Set(JS_STR("misses"), JS_NUM(stats.misses));
+  obj->Set(JS_STR("bytesCached"), JS_NUM(stats.bytes_cached));
+  obj->Set(JS_STR("buffersCached"), JS_NUM(stats.buffers_cached));
+  obj->Set(JS_STR("bytesInUse"), JS_NUM(stats.bytes_in_use));
+  obj->Set(JS_STR("buffersInUse"), JS_NUM(stats.buffers_in_use));
+
+  NanReturnValue(obj);
+}
+
+NAN_METHOD(Context::createBufferArena)
+{
+  NanScope();
+  Context *context = ObjectWrap::Unwrap<Context>(args.This());
+  cl_mem_flags flags = args[0]->Uint32Value();
+  size_t capacity = SizeValue(args[1]);
+  size_t min_block = args[2]->IsUndefined() ? 0 : SizeValue(args[2]);
+
+  // sub-buffer origins must be aligned for every device of the context
+  cl_int ret=CL_SUCCESS;
+  size_t num_devices=0;
+  ret=::clGetContextInfo(context->getContext(), CL_CONTEXT_DEVICES, 0, NULL, &num_devices);
+  std::vector<cl_device_id> devices(num_devices/sizeof(cl_device_id));
+  if(ret==CL_SUCCESS && !devices.empty())
+    ret=::clGetContextInfo(context->getContext(), CL_CONTEXT_DEVICES, num_devices, &devices.front(), NULL);
+  if (ret != CL_SUCCESS) {
+    REQ_ERROR_THROW(INVALID_CONTEXT);
+    REQ_ERROR_THROW(OUT_OF_RESOURCES);
+    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
+    return NanThrowError("UNKNOWN ERROR");
+  }
+
+  size_t align=64;
+  for(size_t i=0;i<devices.size();i++) {
+    cl_uint bits=0;
+    ::clGetDeviceInfo(devices[i], CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(cl_uint), &bits, NULL);
+    if(bits/8>align) align=bits/8;
+  }
+  while(align<min_block)
+    align<<=1;
+  min_block=align;
+  capacity-=capacity % min_block;
+
+  if(flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR)) {
+    ret=CL_INVALID_VALUE;
+    REQ_ERROR_THROW(INVALID_VALUE);
+  }
+  if(capacity==0) {
+    ret=CL_INVALID_BUFFER_SIZE;
+    REQ_ERROR_THROW(INVALID_BUFFER_SIZE);
+  }
+
+  cl_mem mw = ::clCreateBuffer(context->getContext(), flags, capacity, NULL, &ret);
+  if (ret != CL_SUCCESS) {
+    REQ_ERROR_THROW(INVALID_CONTEXT);
+    REQ_ERROR_THROW(INVALID_VALUE);
+    REQ_ERROR_THROW(INVALID_BUFFER_SIZE);
+    REQ_ERROR_THROW(MEM_OBJECT_ALLOCATION_FAILURE);
+    REQ_ERROR_THROW(OUT_OF_RESOURCES);
+    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
+    return NanThrowError("UNKNOWN ERROR");
+  }
+
+  BuddyAllocator *allocator=new BuddyAllocator(mw, capacity, min_block);
+  NanReturnValue(NanObjectWrapHandle(BufferArena::New(allocator)));
+}
+
 NAN_METHOD(Context::createImage)
 {
   NanScope();
@@ -623,6 +874,12 @@ NAN_METHOD(Context::createUserEvent)
   NanReturnValue(NanObjectWrapHandle(UserEvent::New(ew)));
 }
 
+NAN_METHOD(Context::createCommandList)
+{
+  NanScope();
+  NanReturnValue(NanObjectWrapHandle(CommandList::New()));
+}
+
 NAN_METHOD(Context::createFromGLBuffer)
 {
   NanScope();
@@ -806,6 +1063,7 @@ Context *Context::New(cl_context cw)
 
   Context *context = ObjectWrap::Unwrap<Context>(obj);
   context->context = cw;
+  mapCLObj(context, cw);
 
   return context;
 }
@@ -821,6 +1079,7 @@ Context *Context::New(cl_context cw, Handle<Object> webgl_context)
 
   Context *context = ObjectWrap::Unwrap<Context>(obj);
   context->context = cw;
+  mapCLObj(context, cw);
   context->webgl_context_ = webgl_context->ToObject();
 
   return context;
@@ -31,6 +31,9 @@
 
 namespace webcl {
 
+class BufferPool;
+class ProgramLibrary;
+
 class Context : public WebCLObject
 {
 
@@ -45,11 +48,21 @@ public:
 
   static NAN_METHOD(getInfo);
   static NAN_METHOD(createProgram);
+  static NAN_METHOD(createCachedProgram);
+  static NAN_METHOD(addCachedProgram);
+  static NAN_METHOD(setProgramLibraryBudget);
+  static NAN_METHOD(getProgramLibraryStats);
   static NAN_METHOD(createCommandQueue);
   static NAN_METHOD(createBuffer);
+  static NAN_METHOD(createPooledBuffer);
+  static NAN_METHOD(setBufferPoolLimits);
+  static NAN_METHOD(trimBufferPool);
+  static NAN_METHOD(getBufferPoolStats);
+  static NAN_METHOD(createBufferArena);
   static NAN_METHOD(createImage);
   static NAN_METHOD(createSampler);
   static NAN_METHOD(createUserEvent);
+  static NAN_METHOD(createCommandList);
   static NAN_METHOD(getSupportedImageFormats);
   static NAN_METHOD(createFromGLBuffer);
   static NAN_METHOD(createFromGLTexture);
@@ -63,7 +76,6 @@ public:
   static NAN_METHOD(getGLContext);
 
   cl_context getContext() const { return context; };
-  virtual bool isEqual(void *clObj) { return ((cl_context)clObj)==context; }
 
 private:
   Context(v8::Handle<v8::Object> wrapper);
@@ -72,6 +84,14 @@ private:
 
   cl_context context;
   v8::Handle<v8::Object> webgl_context_;
+
+  // created by the first createPooledBuffer()
+  BufferPool *pool;
+  BufferPool *getPool();
+
+  // created by the first createCachedProgram()
+  ProgramLibrary *library;
+  ProgramLibrary *getLibrary();
 };
 
 } // namespace
@@ -307,10 +307,8 @@ NAN_METHOD(Device::getInfo)
       REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
       return NanThrowError("UNKNOWN ERROR");
     }
-    // FIXME: handle uint64 somehow
-    // JS only supports doubles, v8 has ints, CL params can be uint64
-    // the memory params can certainly overflow uint32 size
-    NanReturnValue(NanNew((unsigned int)param_value));
+    // memory sizes overflow uint32, doubles are exact up to 2^53
+    NanReturnValue(JS_NUM(param_value));
   }
   break;
   // size_t params
@@ -430,6 +428,7 @@ Device *Device::New(cl_device_id dw)
 
   Device *device = ObjectWrap::Unwrap<Device>(obj);
   device->device_id = dw;
+  mapCLObj(device, dw);
 
   return device;
 }
@@ -27,6 +27,7 @@
 #include "event.h"
 #include "context.h"
 #include "commandqueue.h"
+#include "completion.h"
 
 using namespace node;
 using namespace v8;
@@ -177,73 +178,7 @@ NAN_METHOD(Event::getProfilingInfo)
 void Event::setEvent(cl_event e) {
   Destructor();
   event=e;
-}
-
-class EventWorker : public NanAsyncWorker {
- public:
-  EventWorker(Baton *baton)
-    : NanAsyncWorker(baton->callback), baton_(baton) {
-    }
-
-  ~EventWorker() {
-    if(baton_) {
-      NanScope();
-      if (!baton_->data.IsEmpty()) NanDisposePersistent(baton_->data);
-      if (!baton_->parent.IsEmpty()) NanDisposePersistent(baton_->parent);
-      // if (baton_->callback) delete baton_->callback;
-      delete baton_;
-    }
-  }
-
-  // Executed inside the worker-thread.
-  // It is not safe to access V8, or V8 data structures
-  // here, so everything we need for input and output
-  // should go on `this`.
-  void Execute () {
-    // SetErrorMessage("Error");
-    // printf("[async event] execute\n");
-  }
-
-  // Executed when the async work is complete
-  // this function will be run inside the main event loop
-  // so it is safe to use V8 again
-  void HandleOKCallback () {
-    NanScope();
-    // printf("[async event] in HandleOKCallback\n");
-
-    // sets event status
-    Local<Object> p = NanNew(baton_->parent);
-    Event *e = ObjectWrap::Unwrap<Event>(p);
-    e->setStatus(baton_->error);
-
-    // // must return passed data
-    if(baton_->data.IsEmpty()) {
-      Local<Value> argv[] = { NanNew(baton_->parent) };
-      callback->Call(1, argv);
-    }
-    else {
-      Local<Value> argv[] = {
-        NanNew(baton_->parent),  // event
-        NanNew(baton_->data)     // user's message
-      };
-
-      // printf("[async event] callback JS\n");
-      callback->Call(2, argv);
-    }
-  }
-
-  private:
-    Baton *baton_;
-};
-
-void CL_CALLBACK Event::callback (cl_event event, cl_int event_command_exec_status, void *user_data)
-{
-  // printf("[Event::callback] event=%p, exec status=%d\n",event,event_command_exec_status);
-  Baton *baton = static_cast<Baton*>(user_data);
-  baton->error = event_command_exec_status;
-
-  // printf("EventWorker launched\n");
-  NanAsyncQueueWorker(new EventWorker(baton));
+  mapCLObj(this, e);
 }
 
 NAN_METHOD(Event::setCallback)
@@ -252,14 +187,7 @@ NAN_METHOD(Event::setCallback)
   Event *e = ObjectWrap::Unwrap<Event>(args.This());
   cl_int command_exec_callback_type = args[0]->Int32Value();
 
-  Baton *baton=new Baton();
-  if(!args[2]->IsNull() && !args[2]->IsUndefined()) 
-    NanAssignPersistent(baton->data, args[2]);
-  NanAssignPersistent(baton->parent, NanObjectWrapHandle(e));
-  baton->callback=new NanCallback(args[1].As<Function>());
-
-  // printf("SetEventCallback event=%p for callback %p\n",e->getEvent(), baton->callback);
-  cl_int ret=::clSetEventCallback(e->getEvent(), command_exec_callback_type, callback, baton);
+  cl_int ret=Completion::watch(e, command_exec_callback_type, args[1].As<Function>(), args[2]);
 
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_EVENT);
@@ -287,6 +215,11 @@ NAN_METHOD(Event::New)
   NanReturnValue(args.This());
 }
 
+bool Event::HasInstance(Handle<Value> value)
+{
+  return NanNew(constructor_template)->HasInstance(value) || UserEvent::HasInstance(value);
+}
+
 Event *Event::New(cl_event ew)
 {
   NanScope();
@@ -297,6 +230,7 @@ Event *Event::New(cl_event ew)
 
   Event *e = ObjectWrap::Unwrap<Event>(obj);
   e->event = ew;
+  mapCLObj(e, ew);
 
   return e;
 }
@@ -390,6 +324,11 @@ NAN_METHOD(UserEvent::New)
   NanReturnValue(args.This());
 }
 
+bool UserEvent::HasInstance(Handle<Value> value)
+{
+  return NanNew(constructor_template)->HasInstance(value);
+}
+
 UserEvent *UserEvent::New(cl_event ew)
 {
   NanScope();
@@ -400,9 +339,202 @@ UserEvent *UserEvent::New(cl_event ew)
 
   UserEvent *e = ObjectWrap::Unwrap<UserEvent>(obj);
   e->event = ew;
+  mapCLObj(e, ew);
 
   return e;
 }
 
+/********************************************
+ *
+ * EventList
+ *
+ ********************************************/
+Persistent<FunctionTemplate> EventList::constructor_template;
+
+void EventList::Init(Handle<Object> target)
+{
+  NanScope();
+
+  // constructor
+  Local<FunctionTemplate> ctor = NanNew<FunctionTemplate>(EventList::New);
+  NanAssignPersistent(constructor_template, ctor);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(JS_STR("WebCLEventList"));
+
+  // prototype
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_set", set);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_add", add);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_clear", clear);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_release", release);
+
+  Local<ObjectTemplate> proto = ctor->PrototypeTemplate();
+  proto->SetAccessor(JS_STR("length"), GetLength, NULL);
+
+  target->Set(JS_STR("WebCLEventList"), ctor->GetFunction());
+}
+
+EventList::EventList(Handle<Object> wrapper)
+{
+}
+
+void EventList::Destructor()
+{
+  events.clear();
+  cache.clear();
+}
+
+bool EventList::HasInstance(Handle<Value> value)
+{
+  return NanNew(constructor_template)->HasInstance(value);
+}
+
+const cl_event *EventList::handles() const
+{
+  cache.resize(events.size());
+  for(size_t i=0;i<events.size();i++)
+    cache[i]=events[i]->getEvent();
+  return cache.empty() ? NULL : &cache.front();
+}
+
+bool EventList::append(Handle<Value> value)
+{
+  if(!Event::HasInstance(value))
+    return false;
+
+  // the wrapper keeps the events alive, see New()
+  Local<Object> self=NanObjectWrapHandle(this);
+  Local<Array> refs=Local<Array>::Cast(self->Get(JS_STR("_events")));
+  refs->Set(refs->Length(), value);
+
+  events.push_back(ObjectWrap::Unwrap<Event>(value->ToObject()));
+  cache.reserve(events.size());
+  return true;
+}
+
+NAN_METHOD(EventList::set)
+{
+  NanScope();
+  EventList *list = ObjectWrap::Unwrap<EventList>(args.This());
+
+  list->events.clear();
+  args.This()->Set(JS_STR("_events"), NanNew<Array>());
+
+  if(args[0]->IsArray()) {
+    Local<Array> arr = Local<Array>::Cast(args[0]);
+    for(uint32_t i=0;i<arr->Length();i++) {
+      if(!list->append(arr->Get(i)))
+        return NanThrowTypeError("Expected an array of WebCLEvent");
+    }
+  }
+
+  NanReturnUndefined();
+}
+
+NAN_METHOD(EventList::add)
+{
+  NanScope();
+  EventList *list = ObjectWrap::Unwrap<EventList>(args.This());
+
+  if(!list->append(args[0]))
+    return NanThrowTypeError("Expected a WebCLEvent");
+
+  NanReturnUndefined();
+}
+
+NAN_METHOD(EventList::clear)
+{
+  NanScope();
+  EventList *list = ObjectWrap::Unwrap<EventList>(args.This());
+
+  list->events.clear();
+  args.This()->Set(JS_STR("_events"), NanNew<Array>());
+
+  NanReturnUndefined();
+}
+
+NAN_METHOD(EventList::release)
+{
+  NanScope();
+  EventList *list = ObjectWrap::Unwrap<EventList>(args.This());
+
+  DESTROY_WEBCL_OBJECT(list);
+  args.This()->Set(JS_STR("_events"), NanNew<Array>());
+
+  NanReturnUndefined();
+}
+
+NAN_GETTER(EventList::GetLength)
+{
+  NanScope();
+  EventList *list = ObjectWrap::Unwrap<EventList>(args.This());
+  NanReturnValue(JS_INT(list->size()));
+}
+
+NAN_METHOD(EventList::New)
+{
+  if (!args.IsConstructCall())
+    return NanThrowTypeError("Constructor cannot be called as a function.");
+
+  NanScope();
+  EventList *list = new EventList(args.This());
+  list->Wrap(args.This());
+  args.This()->Set(JS_STR("_events"), NanNew<Array>());
+  registerCLObj(list);
+
+  if(args[0]->IsArray()) {
+    Local<Array> arr = Local<Array>::Cast(args[0]);
+    for(uint32_t i=0;i<arr->Length();i++) {
+      if(!list->append(arr->Get(i)))
+        return NanThrowTypeError("Expected an array of WebCLEvent");
+    }
+  }
+
+  NanReturnValue(args.This());
+}
+
+/********************************************
+ *
+ * EventWaitList
+ *
+ ********************************************/
+bool EventWaitList::set(Handle<Value> arg)
+{
+  events=NULL;
+  num_events=0;
+
+  if(arg->IsUndefined() || arg->IsNull())
+    return true;
+
+  if(arg->IsArray()) {
+    Local<Array> arr = Local<Array>::Cast(arg);
+    cl_uint n=arr->Length();
+    if(n==0)
+      return true;
+
+    cl_event *dst=storage;
+    if(n>INLINE_SIZE) {
+      if(heap) delete[] heap;
+      heap=dst=new cl_event[n];
+    }
+    for(cl_uint i=0;i<n;i++) {
+      Local<Value> value=arr->Get(i);
+      if(!Event::HasInstance(value))
+        return false;
+      dst[i]=ObjectWrap::Unwrap<Event>(Local<Object>::Cast(value))->getEvent();
+    }
+    events=dst;
+    num_events=n;
+    return true;
+  }
+
+  if(EventList::HasInstance(arg)) {
+    EventList *list=ObjectWrap::Unwrap<EventList>(Local<Object>::Cast(arg));
+    num_events=list->size();
+    events=list->handles();
+    return true;
+  }
+
+  return false;
+}
 
 } // namespace
@@ -28,6 +28,7 @@
 #define EVENT_H_
 
 #include "common.h"
+#include <vector>
 
 namespace webcl {
 
@@ -53,16 +54,13 @@ public:
 
   static NAN_GETTER(GetStatus);
   void setStatus(int s) { status = s; }
-  virtual bool isEqual(void *clObj) { return ((cl_event)clObj)==event; }
+
+  // true for WebCLEvent and WebCLUserEvent objects
+  static bool HasInstance(v8::Handle<v8::Value> value);
 
 protected:
   Event(v8::Handle<v8::Object> wrapper);
 
-  // called by clSetEventCallback
-  static void CL_CALLBACK callback (cl_event event, cl_int event_command_exec_status, void *user_data);
-  // static void After_cb(uv_async_t* handle, int status);
-  // NanCallback *callback;
-
   static v8::Persistent<v8::FunctionTemplate> constructor_template;
 
   cl_event event;
@@ -87,12 +85,77 @@ public:
 
   static NAN_GETTER(GetStatus);
 
+  static bool HasInstance(v8::Handle<v8::Value> value);
+
 private:
   UserEvent(v8::Handle<v8::Object> wrapper);
 
   static v8::Persistent<v8::FunctionTemplate> constructor_template;
 };
 
+// Reusable list of WebCLEvent objects. Handles are read from the events
+// each time the list is used, so events re-filled by later enqueues are
+// picked up without rebuilding the list.
+class EventList : public WebCLObject
+{
+
+public:
+  void Destructor();
+
+  static void Init(v8::Handle<v8::Object> target);
+
+  static NAN_METHOD(New);
+  static NAN_METHOD(set);
+  static NAN_METHOD(add);
+  static NAN_METHOD(clear);
+  static NAN_METHOD(release);
+
+  static NAN_GETTER(GetLength);
+
+  static bool HasInstance(v8::Handle<v8::Value> value);
+
+  cl_uint size() const { return (cl_uint) events.size(); }
+  const cl_event *handles() const;
+
+private:
+  EventList(v8::Handle<v8::Object> wrapper);
+
+  bool append(v8::Handle<v8::Value> value);
+
+  static v8::Persistent<v8::FunctionTemplate> constructor_template;
+
+  std::vector<Event*> events;
+  mutable std::vector<cl_event> cache;
+};
+
+// Event wait list argument of an enqueue call, either an array of events or
+// an EventList. Up to INLINE_SIZE handles are kept on the stack so common
+// wait lists do not allocate.
+class EventWaitList
+{
+
+public:
+  static const cl_uint INLINE_SIZE = 16;
+
+  EventWaitList() : events(NULL), num_events(0), heap(NULL) {}
+  ~EventWaitList() { if(heap) delete[] heap; }
+
+  // returns false if arg is not undefined, null, an array or an EventList
+  bool set(v8::Handle<v8::Value> arg);
+
+  cl_uint size() const { return num_events; }
+  const cl_event *data() const { return events; }
+
+private:
+  EventWaitList(const EventWaitList&);
+  EventWaitList& operator=(const EventWaitList&);
+
+  const cl_event *events;
+  cl_uint num_events;
+  cl_event *heap;
+  cl_event storage[INLINE_SIZE];
+};
+
 } // namespace
 
 #endif
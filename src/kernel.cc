@@ -31,7 +31,12 @@
 #include "device.h"
 #include "platform.h"
 #include "sampler.h"
+#include "programcache.h"
+#include "worksizetuner.h"
 
+#include <node_buffer.h>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 using namespace v8;
@@ -55,12 +60,23 @@ void Kernel::Init(Handle<Object> target)
   NODE_SET_PROTOTYPE_METHOD(ctor, "_getArgInfo", getArgInfo);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_getWorkGroupInfo", getWorkGroupInfo);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_setArg", setArg);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_setArgs", setArgs);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_getArgLayout", getArgLayout);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_getArgIndex", getArgIndex);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_bind", bind);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_setArgMem", setArgMem);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_setArgSampler", setArgSampler);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_setArgInt", setArgInt);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_setArgUint", setArgUint);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_setArgFloat", setArgFloat);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_setArgDouble", setArgDouble);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_setArgLocal", setArgLocal);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_release", release);
 
   target->Set(NanNew("WebCLKernel"), ctor->GetFunction());
 }
 
-Kernel::Kernel(Handle<Object> wrapper) : kernel(0)
+Kernel::Kernel(Handle<Object> wrapper) : kernel(0), pool(NULL), packed_size(0)
 {
   _type=CLObjType::Kernel;
 }
@@ -77,7 +93,13 @@ NAN_METHOD(Kernel::release)
 {
   NanScope();
   Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args.This());
-  
+
+  // pooled kernels go back to their program for the next acquireKernel()
+  if(kernel->pool) {
+    kernel->pool->reclaimKernel(kernel);
+    NanReturnUndefined();
+  }
+
   DESTROY_WEBCL_OBJECT(kernel);
   
   NanReturnUndefined();
@@ -219,6 +241,19 @@ NAN_METHOD(Kernel::getArgInfo)
   NanReturnValue(kArgInfo);
 }
 
+const std::string &Kernel::getTuningId()
+{
+  if(tuning_id.empty())
+    tuning_id=WorkSizeTuner::kernelId(kernel);
+  return tuning_id;
+}
+
+bool Kernel::tunedLocals(cl_device_id device, cl_uint work_dim, const size_t *globals,
+                         WorkSizeTuner::Result &result)
+{
+  return WorkSizeTuner::lookup(tuning_cache, getTuningId(), device, work_dim, globals, result);
+}
+
 NAN_METHOD(Kernel::getWorkGroupInfo)
 {
   NanScope();
@@ -289,122 +324,484 @@ static const TypeInfo types[]={
   { "char", 4, 1 }, { "uchar", 5, 1 },
   { "short", 5, 2 }, { "ushort", 6, 2 },
   { "int", 3, 4 }, { "uint", 4, 4 },
-  { "long", 4, 4 }, { "ulong", 5, 4 },
+  { "long", 4, 8 }, { "ulong", 5, 8 },
   { "float", 5, 4 }, { "double", 6, 8 }, 
   { "half", 4, 2 },
 };
 static const int nTypes=sizeof(types)/sizeof(TypeInfo);
 
+void Kernel::loadArgInfo()
+{
+  args_info.clear();
+  arg_names.clear();
+  packed_size=0;
+
+  cl_uint num_args=0;
+  if(::clGetKernelInfo(kernel, CL_KERNEL_NUM_ARGS, sizeof(cl_uint), &num_args, NULL)!=CL_SUCCESS)
+    return;
+
+  // programs created from cached binaries rarely have argument info, the
+  // cache keeps the one of the source build
+  std::vector<ProgramCache::ArgDesc> descs;
+  if(!ProgramCache::queryArgs(kernel, descs)) {
+    descs.clear();
+    cl_program program=NULL;
+    ::clGetKernelInfo(kernel, CL_KERNEL_PROGRAM, sizeof(cl_program), &program, NULL);
+    WebCLObject *obj=findCLObj((void*)program);
+    if(obj && obj->isProgram()) {
+      char name[256]="";
+      ::clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof(name), name, NULL);
+      name[sizeof(name)-1]=0;
+      if(!ProgramCache::findArgs(static_cast<Program*>(obj)->getArgDescriptors(), name, descs) ||
+         descs.size()!=num_args)
+        descs.clear();
+    }
+  }
+
+  args_info.resize(num_args);
+  arg_values.assign(num_args, KernelArg());
+  for(cl_uint i=0;i<num_args;i++)
+    arg_values[i].index=i;
+  for(cl_uint i=0;i<num_args;i++) {
+    ArgInfo &info=args_info[i];
+    info.address=CL_KERNEL_ARG_ADDRESS_PRIVATE;
+    info.base_type=-1;
+    info.vector_width=1;
+    info.size=0;
+    info.packed_offset=ArgInfo::NOT_PACKED;
+
+    if(i>=descs.size())
+      continue;
+    info.address=descs[i].address;
+    if(!descs[i].name.empty())
+      arg_names[descs[i].name]=i;
+
+    const char *typeName=descs[i].type_name.c_str();
+    if(!*typeName)
+      continue;
+
+    // pointers are passed as memory objects, their pointee type doesn't matter
+    if(strchr(typeName, '*'))
+      continue;
+
+    for(int t=0;t<nTypes;t++) {
+      if(!strncmp(typeName, types[t].name, types[t].lname)) {
+        const char *suffix=typeName+types[t].lname;
+        int width = *suffix ? atoi(suffix) : 1;
+        if(width<=0)
+          continue; // e.g. "int" matching "intptr_t"
+        info.base_type=t;
+        info.vector_width=width;
+        // 3-component vectors take the space of 4
+        info.size=types[t].size*(width==3 ? 4 : width);
+        break;
+      }
+    }
+
+    // by-value arguments have a slot in setArgs() packed buffers
+    if(info.base_type>=0 && info.address==CL_KERNEL_ARG_ADDRESS_PRIVATE) {
+      info.packed_offset=(packed_size + info.size-1) / info.size * info.size;
+      packed_size=info.packed_offset + info.size;
+    }
+  }
+}
+
+#define SET_ARG_ERROR_THROW()              \
+  if (ret != CL_SUCCESS) {                 \
+    REQ_ERROR_THROW(INVALID_KERNEL);       \
+    REQ_ERROR_THROW(INVALID_ARG_INDEX);    \
+    REQ_ERROR_THROW(INVALID_ARG_VALUE);    \
+    REQ_ERROR_THROW(INVALID_MEM_OBJECT);   \
+    REQ_ERROR_THROW(INVALID_SAMPLER);      \
+    REQ_ERROR_THROW(INVALID_ARG_SIZE);     \
+    REQ_ERROR_THROW(INVALID_VALUE);        \
+    REQ_ERROR_THROW(OUT_OF_RESOURCES);     \
+    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);   \
+    return NanThrowError("UNKNOWN ERROR"); \
+  }
+
+// converts a number to the scalar type of info, false for vector or half
+// arguments and arguments of unknown type
+static bool scalarValue(const Kernel::ArgInfo *info, double value, unsigned char *out)
+{
+  if(!info || info->base_type<0 || info->vector_width!=1)
+    return false;
+
+  switch(info->base_type) {
+  case 0: *(cl_char*) out=(cl_char) value; break;
+  case 1: *(cl_uchar*) out=(cl_uchar) value; break;
+  case 2: *(cl_short*) out=(cl_short) value; break;
+  case 3: *(cl_ushort*) out=(cl_ushort) value; break;
+  case 4: *(cl_int*) out=(cl_int) value; break;
+  case 5: *(cl_uint*) out=(cl_uint) value; break;
+  case 6: *(cl_long*) out=(cl_long) value; break;
+  case 7: *(cl_ulong*) out=(cl_ulong) value; break;
+  case 8: *(cl_float*) out=(cl_float) value; break;
+  case 9: *(cl_double*) out=value; break;
+  default: return false;
+  }
+  return true;
+}
+
+const LaunchPlanner::Limits *Kernel::launchLimits(cl_device_id device, cl_int *ret)
+{
+  std::map<cl_device_id, LaunchPlanner::Limits>::iterator it=launch_limits.find(device);
+  if(it!=launch_limits.end())
+    return &it->second;
+
+  LaunchPlanner::Limits limits;
+  *ret=LaunchPlanner::limits(kernel, device, limits);
+  if(*ret!=CL_SUCCESS)
+    return NULL;
+  return &(launch_limits[device]=limits);
+}
+
+cl_int Kernel::setExtentArg(cl_uint index, cl_uint work_dim, const size_t *extent)
+{
+  const ArgInfo *info=argInfo(index);
+  if(!info)
+    return CL_INVALID_ARG_INDEX;
+
+  // integer vector, e.g. int2 for a 2D extent
+  if(info->base_type>=0 && info->vector_width>1) {
+    if(info->base_type>7 || info->vector_width<work_dim)
+      return CL_INVALID_ARG_VALUE;
+    ArgInfo component=*info;
+    component.vector_width=1;
+    component.size=types[info->base_type].size;
+    unsigned char value[16*sizeof(cl_long)];
+    memset(value, 0, sizeof(value));
+    for(cl_uint i=0;i<work_dim;i++)
+      scalarValue(&component, (double) extent[i], value+i*component.size);
+    return setArgRaw(index, info->size, value);
+  }
+
+  for(cl_uint i=0;i<work_dim;i++) {
+    info=argInfo(index+i);
+    if(!info)
+      return CL_INVALID_ARG_INDEX;
+    unsigned char value[sizeof(cl_long)];
+    size_t size=sizeof(cl_int);
+    if(info->base_type<0)
+      *(cl_int*) value=(cl_int) extent[i];
+    else if(info->base_type>7 || info->vector_width!=1)
+      return CL_INVALID_ARG_VALUE;
+    else {
+      scalarValue(info, (double) extent[i], value);
+      size=info->size;
+    }
+    cl_int ret=setArgRaw(index+i, size, value);
+    if(ret!=CL_SUCCESS)
+      return ret;
+  }
+  return CL_SUCCESS;
+}
+
+cl_int Kernel::setArgValue(cl_uint arg_index, Handle<Value> value)
+{
+  const ArgInfo *info=argInfo(arg_index);
+
+  if(value->IsNumber()) {
+    unsigned char scalar[sizeof(cl_double)];
+    if(!scalarValue(info, value->NumberValue(), scalar))
+      return CL_INVALID_ARG_VALUE;
+    return setArgRaw(arg_index, info->size, scalar);
+  }
+  if(!value->IsObject() || value->IsArray())
+    return CL_INVALID_ARG_VALUE;
+
+  if(Sampler::HasInstance(value)) {
+    // WebCLSampler
+    cl_sampler sampler = ObjectWrap::Unwrap<Sampler>(value->ToObject())->getSampler();
+
+    // bug in OSX that allows null sampler without throwing exception
+    if(sampler == 0)
+      return CL_INVALID_SAMPLER;
+
+    return setArgRaw(arg_index, sizeof(cl_sampler), &sampler, 0, sampler);
+  }
+  if(MemoryObject::HasInstance(value)) {
+    // WebCLBuffer and WebCLImage
+    cl_mem mem = ObjectWrap::Unwrap<MemoryObject>(value->ToObject())->getMemory();
+    return setArgRaw(arg_index, sizeof(cl_mem), &mem, mem);
+  }
+
+  Local<Object> obj=value->ToObject();
+  char *host_ptr=NULL;
+  int len=0;
+  int bytes=0;
+
+  if(node::Buffer::HasInstance(obj)) {
+    host_ptr = node::Buffer::Data(obj);
+    bytes = node::Buffer::Length(obj);
+  }
+  else {
+    // ArrayBufferView
+    host_ptr= (char*) (obj->GetIndexedPropertiesExternalArrayData());
+    len=obj->GetIndexedPropertiesExternalArrayDataLength(); // number of elements
+    bytes=obj->Get(JS_STR("byteLength"))->Uint32Value();
+  }
+
+  // vectors take vector_width elements of the array
+  if(len>1 && info && info->base_type>=0)
+    bytes = (bytes/len) * info->vector_width;
+
+  // handle __local params
+  if(len == 1 && info && info->address == CL_KERNEL_ARG_ADDRESS_LOCAL)
+    return setArgRaw(arg_index, *((cl_int*) host_ptr), NULL);
+
+  return setArgRaw(arg_index, bytes, host_ptr);
+}
+
+cl_int Kernel::setArgRaw(cl_uint index, size_t size, const void *value, cl_mem mem, cl_sampler sampler)
+{
+  cl_int ret=::clSetKernelArg(kernel, index, size, value);
+  if(ret!=CL_SUCCESS || index>=arg_values.size())
+    return ret;
+
+  KernelArg &arg=arg_values[index];
+  arg.size=size;
+  arg.mem=mem;
+  arg.sampler=sampler;
+  if(value && !mem && !sampler)
+    arg.data.assign((const unsigned char*) value, (const unsigned char*) value + size);
+  else
+    arg.data.clear();
+  return ret;
+}
+
+int Kernel::argIndex(const std::string &name) const
+{
+  std::map<std::string, cl_uint>::const_iterator it=arg_names.find(name);
+  return it==arg_names.end() ? -1 : (int) it->second;
+}
+
 NAN_METHOD(Kernel::setArg)
 {
   NanScope();
 
   if (!args[0]->IsUint32())
     return NanThrowError("INVALID_ARG_INDEX");
+  if(!args[1]->IsObject() || args[1]->IsArray())
+    return NanThrowTypeError("Invalid object for arg 1");
 
   Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args.This());
-  cl_kernel k = kernel->getKernel();
-  cl_uint arg_index = args[0]->Uint32Value();
-  cl_int ret=CL_SUCCESS;
+  cl_int ret = kernel->setArgValue(args[0]->Uint32Value(), args[1]);
+  SET_ARG_ERROR_THROW();
 
-  if(args[1]->IsObject()) {
-    String::Utf8Value str(args[1]->ToObject()->GetConstructorName());
-    if(!strcmp("WebCLSampler",*str)) {
-      // WebCLSampler
-      Sampler *s = ObjectWrap::Unwrap<Sampler>(args[1]->ToObject());
-      cl_sampler sampler = s->getSampler();
+  NanReturnUndefined();
+}
 
-      if(sampler == 0) {
-        ret=CL_INVALID_SAMPLER;
-        REQ_ERROR_THROW(INVALID_SAMPLER); // bug in OSX that allows null sampler without throwing exception
-      }
+// Sets all arguments in one call. values[i] is anything setArg takes, or a
+// number converted to the scalar type of argument i. Arguments whose value
+// is undefined or null are read from packed, an ArrayBuffer or typed array
+// laid out as described by getArgLayout(), or left unchanged if there is no
+// packed buffer or they are not in its layout.
+NAN_METHOD(Kernel::setArgs)
+{
+  NanScope();
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args.This());
 
-      ret = ::clSetKernelArg(k, arg_index, sizeof(cl_sampler), &sampler);
+  if(!args[0]->IsArray())
+    return NanThrowTypeError("Expected an array of argument values");
+  Local<Array> values = Local<Array>::Cast(args[0]);
+
+  cl_int ret=CL_SUCCESS;
+  unsigned char *packed=NULL;
+  if(args[1]->IsArrayBuffer()) {
+    ArrayBuffer::Contents contents=Local<ArrayBuffer>::Cast(args[1])->GetContents();
+    packed=(unsigned char*) contents.Data();
+    if(contents.ByteLength() < kernel->packed_size)
+      ret=CL_INVALID_VALUE;
+  }
+  else if(args[1]->IsObject() && args[1]->ToObject()->HasIndexedPropertiesInExternalArrayData()) {
+    Local<Object> obj=args[1]->ToObject();
+    packed=(unsigned char*) obj->GetIndexedPropertiesExternalArrayData();
+    if(obj->Get(JS_STR("byteLength"))->Uint32Value() < kernel->packed_size)
+      ret=CL_INVALID_VALUE;
+  }
+  else if(!args[1]->IsUndefined() && !args[1]->IsNull())
+    return NanThrowTypeError("Expected an ArrayBuffer of packed arguments");
+  SET_ARG_ERROR_THROW();
+
+  cl_uint num_values=values->Length();
+  cl_uint num_args=(cl_uint) kernel->args_info.size();
+  if(num_values>num_args)
+    ret=CL_INVALID_ARG_INDEX;
+
+  for(cl_uint i=0; i<num_args && ret==CL_SUCCESS; i++) {
+    Local<Value> value = i<num_values ? values->Get(i) : Local<Value>();
+    if(!value.IsEmpty() && !value->IsUndefined() && !value->IsNull())
+      ret=kernel->setArgValue(i, value);
+    else if(packed && kernel->args_info[i].packed_offset!=ArgInfo::NOT_PACKED) {
+      const ArgInfo &info=kernel->args_info[i];
+      ret=kernel->setArgRaw(i, info.size, packed+info.packed_offset);
     }
-    else if(!strcmp(*str, "WebCLBuffer") || !strcmp(*str, "WebCLImage")) {
-      // WebCLBuffer and WebCLImage
-      // printf("[SetArg] mem object\n");
-      MemoryObject *mo = ObjectWrap::Unwrap<MemoryObject>(args[1]->ToObject());
-      cl_mem mem = mo->getMemory();
-      ret = ::clSetKernelArg(k, arg_index, sizeof(cl_mem), &mem);
+  }
+  SET_ARG_ERROR_THROW();
+
+  NanReturnUndefined();
+}
+
+NAN_METHOD(Kernel::getArgIndex)
+{
+  NanScope();
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args.This());
+  String::Utf8Value name(args[0]);
+
+  NanReturnValue(JS_INT(kernel->argIndex(std::string(*name, name.length()))));
+}
+
+// Sets the arguments named by the properties of an object, e.g.
+//   kernel.bind({ out: buffer, scale: 2 })
+NAN_METHOD(Kernel::bind)
+{
+  NanScope();
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args.This());
+
+  if(!args[0]->IsObject())
+    return NanThrowTypeError("Expected an object of argument values");
+  Local<Object> values=args[0]->ToObject();
+  Local<Array> names=values->GetOwnPropertyNames();
+
+  cl_int ret=CL_SUCCESS;
+  for(uint32_t i=0; i<names->Length() && ret==CL_SUCCESS; i++) {
+    Local<Value> key=names->Get(i);
+    String::Utf8Value name(key);
+    int index=kernel->argIndex(std::string(*name, name.length()));
+    if(index<0) {
+      std::string msg=std::string("Unknown kernel argument ")+*name;
+      if(kernel->arg_names.empty())
+        msg+=" (argument names need a program built with -cl-kernel-arg-info)";
+      return NanThrowError(msg.c_str());
     }
-    else if(!args[1]->IsArray()) {
-      Local<Object> obj=args[1]->ToObject();
-      String::Utf8Value name(obj->GetConstructorName());
-      char *host_ptr=NULL;
-      int len=0;
-      int bytes=0;
-
-      if(!strcmp("Buffer",*name)) {
-        host_ptr = node::Buffer::Data(obj);
-        bytes = node::Buffer::Length(obj);
-      }
-      else {
-        // ArrayBufferView
-        host_ptr= (char*) (obj->GetIndexedPropertiesExternalArrayData());
-        len=obj->GetIndexedPropertiesExternalArrayDataLength(); // number of elements
-        bytes=obj->Get(JS_STR("byteLength"))->Uint32Value();
-        // int byteOffset=obj->Get(JS_STR("byteOffset"))->Uint32Value();
-      }
-      // printf("TypedArray: len %d, bytes %d, byteOffset %d\n",len,bytes,byteOffset);
-
-      char typeName[16];
-      ret = ::clGetKernelArgInfo(k, arg_index, CL_KERNEL_ARG_TYPE_NAME, sizeof(typeName), typeName, NULL);
-
-      if(len>1) {
-        for(int i=0;i<nTypes;i++) {
-          if(strstr(typeName,types[i].name)==typeName) {
-            if(strlen(typeName) > types[i].lname) {
-              int vecSize = atoi(typeName + types[i].lname);
-              bytes*=vecSize;
-            }
-            if(len)
-              bytes/=len;
-
-            break;
-          }
-        }
-      }
-    
-      if(len == 1) {
-        // handle __local params
-        // printf("[setArg] index %d has 1 value\n",arg_index);
-        cl_kernel_arg_address_qualifier addr=0;
-        ret = ::clGetKernelArgInfo(k, arg_index, CL_KERNEL_ARG_ADDRESS_QUALIFIER, 
-                              sizeof(cl_kernel_arg_address_qualifier), &addr, NULL);
-        if(addr == CL_KERNEL_ARG_ADDRESS_LOCAL) {
-          // printf("  index %d size: %d\n",arg_index,*((cl_int*) host_ptr));          
-          ret = ::clSetKernelArg(k, arg_index, *((cl_int*) host_ptr), NULL);
-          // printf("[setArg __local] ret = %d\n",ret);
-        }
-        else {
-          ret = ::clSetKernelArg(k, arg_index, bytes, host_ptr);
-          // printf("ret1= %d\n",ret);
-        }
-      }
-      else {
-        ret = ::clSetKernelArg(k, arg_index, bytes, host_ptr);
-        // printf("ret2= %d\n",ret);
-      }
-   }
-    else 
-      return NanThrowTypeError("Invalid object for arg 1");
+    ret=kernel->setArgValue((cl_uint) index, values->Get(key));
   }
-  else 
-    return NanThrowTypeError("Invalid object for arg 1");
- 
-  if (ret != CL_SUCCESS) {
-    REQ_ERROR_THROW(INVALID_KERNEL);
-    REQ_ERROR_THROW(INVALID_ARG_INDEX);
-    REQ_ERROR_THROW(INVALID_ARG_VALUE);
-    REQ_ERROR_THROW(INVALID_MEM_OBJECT);
-    REQ_ERROR_THROW(INVALID_SAMPLER);
-    REQ_ERROR_THROW(INVALID_ARG_SIZE);
-    REQ_ERROR_THROW(OUT_OF_RESOURCES);
-    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
-    return NanThrowError("UNKNOWN ERROR");
+  SET_ARG_ERROR_THROW();
+
+  NanReturnUndefined();
+}
+
+// { size, args: [ { index, offset, size, type } ] }, the layout of the
+// packed arguments of setArgs(): by-value scalar and vector arguments in
+// order, each aligned on its size
+NAN_METHOD(Kernel::getArgLayout)
+{
+  NanScope();
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args.This());
+
+  Local<Array> layout = NanNew<Array>();
+  for(size_t i=0, n=0; i<kernel->args_info.size(); i++) {
+    const ArgInfo &info=kernel->args_info[i];
+    if(info.packed_offset==ArgInfo::NOT_PACKED)
+      continue;
+
+    std::string type(types[info.base_type].name);
+    if(info.vector_width>1) {
+      char width[16];
+      snprintf(width, sizeof(width), "%u", info.vector_width);
+      type+=width;
+    }
+
+    Local<Object> arg = NanNew<Object>();
+    arg->Set(JS_STR("index"), JS_INT((uint32_t) i));
+    arg->Set(JS_STR("offset"), JS_NUM(info.packed_offset));
+    arg->Set(JS_STR("size"), JS_NUM(info.size));
+    arg->Set(JS_STR("type"), JS_STR(type.c_str()));
+    layout->Set((uint32_t) n++, arg);
   }
 
+  Local<Object> obj = NanNew<Object>();
+  obj->Set(JS_STR("size"), JS_NUM(kernel->packed_size));
+  obj->Set(JS_STR("args"), layout);
+  NanReturnValue(obj);
+}
+
+// Fast paths of setArg for a known kind of argument, without classifying
+// the value. Objects are checked against their constructor template.
+
+NAN_METHOD(Kernel::setArgMem)
+{
+  NanScope();
+  if(!MemoryObject::HasInstance(args[1]))
+    return NanThrowTypeError("Expected a WebCLMemoryObject");
+
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args.This());
+  cl_mem mem = ObjectWrap::Unwrap<MemoryObject>(args[1]->ToObject())->getMemory();
+  cl_int ret = kernel->setArgRaw(args[0]->Uint32Value(), sizeof(cl_mem), &mem, mem);
+  SET_ARG_ERROR_THROW();
+
+  NanReturnUndefined();
+}
+
+NAN_METHOD(Kernel::setArgSampler)
+{
+  NanScope();
+  if(!Sampler::HasInstance(args[1]))
+    return NanThrowTypeError("Expected a WebCLSampler");
+
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args.This());
+  cl_sampler sampler = ObjectWrap::Unwrap<Sampler>(args[1]->ToObject())->getSampler();
+  cl_int ret=CL_INVALID_SAMPLER;
+  if(sampler)
+    ret = kernel->setArgRaw(args[0]->Uint32Value(), sizeof(cl_sampler), &sampler, 0, sampler);
+  SET_ARG_ERROR_THROW();
+
+  NanReturnUndefined();
+}
+
+NAN_METHOD(Kernel::setArgInt)
+{
+  NanScope();
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args.This());
+  cl_int value = args[1]->Int32Value();
+  cl_int ret = kernel->setArgRaw(args[0]->Uint32Value(), sizeof(cl_int), &value);
+  SET_ARG_ERROR_THROW();
+
+  NanReturnUndefined();
+}
+
+NAN_METHOD(Kernel::setArgUint)
+{
+  NanScope();
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args.This());
+  cl_uint value = args[1]->Uint32Value();
+  cl_int ret = kernel->setArgRaw(args[0]->Uint32Value(), sizeof(cl_uint), &value);
+  SET_ARG_ERROR_THROW();
+
+  NanReturnUndefined();
+}
+
+NAN_METHOD(Kernel::setArgFloat)
+{
+  NanScope();
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args.This());
+  cl_float value = (cl_float) args[1]->NumberValue();
+  cl_int ret = kernel->setArgRaw(args[0]->Uint32Value(), sizeof(cl_float), &value);
+  SET_ARG_ERROR_THROW();
+
+  NanReturnUndefined();
+}
+
+NAN_METHOD(Kernel::setArgDouble)
+{
+  NanScope();
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args.This());
+  cl_double value = args[1]->NumberValue();
+  cl_int ret = kernel->setArgRaw(args[0]->Uint32Value(), sizeof(cl_double), &value);
+  SET_ARG_ERROR_THROW();
+
+  NanReturnUndefined();
+}
+
+// size in bytes of a __local argument
+NAN_METHOD(Kernel::setArgLocal)
+{
+  NanScope();
+  Kernel *kernel = ObjectWrap::Unwrap<Kernel>(args.This());
+  cl_int ret = kernel->setArgRaw(args[0]->Uint32Value(), SizeValue(args[1]), NULL);
+  SET_ARG_ERROR_THROW();
+
   NanReturnUndefined();
 }
 
@@ -431,8 +828,40 @@ Kernel *Kernel::New(cl_kernel kw)
 
   Kernel *kernel = ObjectWrap::Unwrap<Kernel>(obj);
   kernel->kernel = kw;
+  kernel->loadArgInfo();
+  mapCLObj(kernel, kw);
 
   return kernel;
 }
 
+Kernel *Kernel::handOver()
+{
+  NanScope();
+
+  Local<Value> arg = NanNew(0);
+  Local<FunctionTemplate> constructorHandle = NanNew(constructor_template);
+  Local<Object> obj = constructorHandle->GetFunction()->NewInstance(1, &arg);
+
+  Kernel *next = ObjectWrap::Unwrap<Kernel>(obj);
+  next->kernel = kernel;
+  next->pool = pool;
+  next->args_info.swap(args_info);
+  next->arg_values.swap(arg_values);
+  next->packed_size = packed_size;
+  next->arg_names.swap(arg_names);
+  next->tuning_id.swap(tuning_id);
+  next->tuning_cache.swap(tuning_cache);
+  next->launch_limits.swap(launch_limits);
+
+  kernel = 0;
+  pool = NULL;
+  packed_size = 0;
+  mapCLObj(next, next->kernel);
+
+  // the dead handle leaves the registry, GC may free it any time
+  unregisterCLObj(this);
+
+  return next;
+}
+
 }
@@ -28,9 +28,37 @@
 #define KERNEL_H_
 
 #include "common.h"
+#include "launchplanner.h"
+#include "worksizetuner.h"
+#include <map>
+#include <string>
+#include <vector>
 
 namespace webcl {
 
+class Program;
+
+// Value of a kernel argument as last set with clSetKernelArg(), kept so
+// captured launches can be replayed with the arguments they were captured
+// with.
+struct KernelArg {
+  cl_uint index;
+  size_t size; // 0 if never set
+  std::vector<unsigned char> data; // empty for __local, memory object and sampler arguments
+  cl_mem mem;
+  cl_sampler sampler;
+  int slot; // buffer slot of a captured graph, -1 if unused
+
+  KernelArg() : index(0), size(0), mem(0), sampler(0), slot(-1) {}
+
+  // pointer to pass to clSetKernelArg()
+  const void *value() const {
+    if(mem) return &mem;
+    if(sampler) return &sampler;
+    return data.empty() ? NULL : &data.front();
+  }
+};
+
 class Kernel : public WebCLObject
 {
 
@@ -45,18 +73,92 @@ public:
   static NAN_METHOD(getWorkGroupInfo);
   static NAN_METHOD(getArgInfo);
   static NAN_METHOD(setArg);
+  static NAN_METHOD(setArgs);
+  static NAN_METHOD(getArgLayout);
+  static NAN_METHOD(getArgIndex);
+  static NAN_METHOD(bind);
+  static NAN_METHOD(setArgMem);
+  static NAN_METHOD(setArgSampler);
+  static NAN_METHOD(setArgInt);
+  static NAN_METHOD(setArgUint);
+  static NAN_METHOD(setArgFloat);
+  static NAN_METHOD(setArgDouble);
+  static NAN_METHOD(setArgLocal);
   static NAN_METHOD(release);
 
   cl_kernel getKernel() const { return kernel; };
-  
-  virtual bool isEqual(void *clObj) { return ((cl_kernel)clObj)==kernel; }
+
+  // program whose kernel pool this kernel returns to when released
+  void setPool(Program *p) { pool=p; }
+
+  // New kernel object taking over the cl_kernel, its pool and argument
+  // state. This one is left without a kernel, so a holder that released it
+  // can't touch the kernel handed to the next one.
+  Kernel *handOver();
+
+  // Argument descriptor, read from the driver once when the kernel is
+  // created. base_type is an index in the scalar type table of kernel.cc,
+  // -1 for other types (images, samplers, structs) or if the program was
+  // built without argument info. By-value arguments of known type have a
+  // slot at packed_offset in the packed buffers of setArgs().
+  struct ArgInfo {
+    static const size_t NOT_PACKED = (size_t) -1;
+
+    cl_kernel_arg_address_qualifier address;
+    int base_type;
+    cl_uint vector_width;
+    size_t size; // bytes of the declared type, 0 if unknown
+    size_t packed_offset;
+  };
+
+  // NULL if index is out of range
+  const ArgInfo *argInfo(cl_uint index) const {
+    return index<args_info.size() ? &args_info[index] : NULL;
+  }
+
+  // index of the argument named name, -1 if there is none or the program
+  // was built without argument info
+  int argIndex(const std::string &name) const;
+
+  // identifies this kernel in work size tuning results
+  const std::string &getTuningId();
+
+  // tuned locals on device for globals, false if the kernel was not tuned
+  // for their size class
+  bool tunedLocals(cl_device_id device, cl_uint work_dim, const size_t *globals,
+                   WorkSizeTuner::Result &result);
+
+  // launch limits on device, read once per device, NULL on error
+  const LaunchPlanner::Limits *launchLimits(cl_device_id device, cl_int *ret);
+
+  // Sets the extent of a padded launch: one integer vector argument with
+  // at least work_dim components, or work_dim integer scalar arguments
+  // starting at index. Arguments of unknown type are taken as ints.
+  cl_int setExtentArg(cl_uint index, cl_uint work_dim, const size_t *extent);
+
+  // clSetKernelArg() remembering the value, see KernelArg
+  cl_int setArgRaw(cl_uint index, size_t size, const void *value, cl_mem mem=0, cl_sampler sampler=0);
+  const std::vector<KernelArg> &argValues() const { return arg_values; }
+
+  // sets an argument from any value setArg() or setArgs() accept
+  cl_int setArgValue(cl_uint index, v8::Handle<v8::Value> value);
 
 private:
   Kernel(v8::Handle<v8::Object> wrapper);
 
   static v8::Persistent<v8::FunctionTemplate> constructor_template;
 
+  void loadArgInfo();
+
   cl_kernel kernel;
+  Program *pool;
+  std::vector<ArgInfo> args_info;
+  std::vector<KernelArg> arg_values;
+  size_t packed_size;
+  std::map<std::string, cl_uint> arg_names;
+  std::string tuning_id;
+  WorkSizeTuner::Cache tuning_cache;
+  std::map<cl_device_id, LaunchPlanner::Limits> launch_limits;
 };
 
 } // namespace
@@ -0,0 +1,153 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "launchplanner.h"
+
+#include <algorithm>
+
+namespace webcl {
+
+const size_t LaunchPlanner::TARGET_GROUP_SIZE;
+std::map<cl_device_id, std::vector<size_t> > LaunchPlanner::device_items;
+
+cl_int LaunchPlanner::limits(cl_kernel kernel, cl_device_id device, Limits &limits)
+{
+  std::map<cl_device_id, std::vector<size_t> >::iterator it=device_items.find(device);
+  if(it==device_items.end()) {
+    size_t size=0;
+    cl_int ret=::clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, 0, NULL, &size);
+    if(ret!=CL_SUCCESS)
+      return ret;
+    std::vector<size_t> items(std::max(size/sizeof(size_t), (size_t) 3), 1);
+    ret=::clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, size, &items.front(), NULL);
+    if(ret!=CL_SUCCESS)
+      return ret;
+    it=device_items.insert(std::make_pair(device, items)).first;
+  }
+  for(int i=0;i<3;i++)
+    limits.max_items[i]=it->second[i];
+
+  cl_int ret=::clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &limits.max_group, NULL);
+  if(ret==CL_SUCCESS)
+    ret=::clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(size_t), &limits.multiple, NULL);
+  if(ret==CL_SUCCESS)
+    ret=::clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_COMPILE_WORK_GROUP_SIZE, sizeof(limits.required), limits.required, NULL);
+  if(limits.multiple==0)
+    limits.multiple=1;
+  return ret;
+}
+
+static size_t roundUp(size_t n, size_t multiple)
+{
+  return (n + multiple-1) / multiple * multiple;
+}
+
+static size_t nextPowerOfTwo(size_t n)
+{
+  size_t p=1;
+  while(p<n)
+    p*=2;
+  return p;
+}
+
+// Required sizes come first, then the given locals if the kernel can use
+// them. Otherwise the group grows by powers of two up to the target size:
+// first along dimension 0 up to the preferred multiple, so neighbouring
+// work-items stay together for memory accesses, then along whichever
+// dimension has the most groups left. No dimension grows past its extent
+// rounded up to a power of two, so small extents are not padded much.
+cl_int LaunchPlanner::plan(const Limits &limits, cl_uint work_dim, const size_t *extent,
+                           const size_t *locals, Plan &plan)
+{
+  if(work_dim<1 || work_dim>3)
+    return CL_INVALID_WORK_DIMENSION;
+  for(cl_uint d=0;d<work_dim;d++)
+    if(extent[d]==0)
+      return CL_INVALID_GLOBAL_WORK_SIZE;
+
+  plan.work_dim=work_dim;
+  for(int d=0;d<3;d++) {
+    plan.globals[d]=1;
+    plan.locals[d]=1;
+  }
+
+  bool fixed=false;
+  if(limits.required[0]) {
+    for(cl_uint d=0;d<work_dim;d++)
+      plan.locals[d]=limits.required[d];
+    fixed=true;
+  }
+  else if(locals) {
+    size_t n=1;
+    bool legal=true;
+    for(cl_uint d=0;d<work_dim;d++) {
+      legal = legal && locals[d]>0 && locals[d]<=limits.max_items[d];
+      n*=locals[d];
+    }
+    if(legal && n<=limits.max_group) {
+      for(cl_uint d=0;d<work_dim;d++)
+        plan.locals[d]=locals[d];
+      fixed=true;
+    }
+  }
+
+  if(!fixed) {
+    size_t target=std::min(limits.max_group, TARGET_GROUP_SIZE);
+    if(target>=limits.multiple)
+      target-=target%limits.multiple;
+
+    size_t cap[3];
+    for(cl_uint d=0;d<work_dim;d++)
+      cap[d]=std::min(limits.max_items[d], nextPowerOfTwo(extent[d]));
+
+    size_t n=1;
+    while(plan.locals[0]<limits.multiple && plan.locals[0]*2<=cap[0] && n*2<=target) {
+      plan.locals[0]*=2;
+      n*=2;
+    }
+    for(;;) {
+      int grow=-1;
+      size_t most=0;
+      for(cl_uint d=0;d<work_dim;d++) {
+        size_t groups=(extent[d] + plan.locals[d]-1) / plan.locals[d];
+        if(plan.locals[d]*2<=cap[d] && n*2<=target && groups>most) {
+          grow=d;
+          most=groups;
+        }
+      }
+      if(grow<0)
+        break;
+      plan.locals[grow]*=2;
+      n*=2;
+    }
+  }
+
+  for(cl_uint d=0;d<work_dim;d++)
+    plan.globals[d]=roundUp(extent[d], plan.locals[d]);
+  return CL_SUCCESS;
+}
+
+} // namespace
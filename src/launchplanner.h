@@ -0,0 +1,75 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef LAUNCHPLANNER_H_
+#define LAUNCHPLANNER_H_
+
+#include "common.h"
+#include <map>
+#include <vector>
+
+namespace webcl {
+
+// Picks the launch shape of a kernel over an arbitrary extent: a legal,
+// occupancy-friendly local size and globals padded up to a multiple of it.
+// The kernel gets the true extent as an argument and must skip work-items
+// past it.
+class LaunchPlanner
+{
+
+public:
+  // what a kernel may be launched with on a device
+  struct Limits {
+    size_t max_items[3]; // CL_DEVICE_MAX_WORK_ITEM_SIZES
+    size_t max_group; // CL_KERNEL_WORK_GROUP_SIZE
+    size_t multiple; // CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE
+    size_t required[3]; // reqd_work_group_size, 0s if none
+  };
+
+  struct Plan {
+    cl_uint work_dim;
+    size_t globals[3];
+    size_t locals[3];
+  };
+
+  // work-group size aimed for when the kernel allows it
+  static const size_t TARGET_GROUP_SIZE = 256;
+
+  // device limits are read once per device
+  static cl_int limits(cl_kernel kernel, cl_device_id device, Limits &limits);
+
+  // Plan for extent, with locals if given and allowed by limits. Returns
+  // CL_INVALID_GLOBAL_WORK_SIZE for empty extents.
+  static cl_int plan(const Limits &limits, cl_uint work_dim, const size_t *extent,
+                     const size_t *locals, Plan &plan);
+
+private:
+  static std::map<cl_device_id, std::vector<size_t> > device_items;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,164 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "mapping.h"
+#include <node_buffer.h>
+
+using namespace v8;
+
+namespace webcl {
+
+MappingTable::Table MappingTable::table;
+
+MappingTable::Mapping *MappingTable::record(std::vector<Mapping*> &mappings, void *ptr, size_t size)
+{
+  Local<ArrayBuffer> buffer=ArrayBuffer::New(Isolate::GetCurrent(), ptr, size);
+  Local<Object> view=Uint8Array::New(buffer, 0, size);
+
+  Mapping *m=new Mapping;
+  m->ptr=ptr;
+  m->size=size;
+  m->offset=0;
+  m->persistent=false;
+  m->mapped=true;
+  NanAssignPersistent(m->view, view);
+  mappings.push_back(m);
+  return m;
+}
+
+Local<Object> MappingTable::add(cl_mem mem, void *ptr, size_t size)
+{
+  return NanNew(record(table[mem], ptr, size)->view);
+}
+
+Local<Object> MappingTable::addPersistent(cl_mem mem, size_t offset, void *ptr, size_t size)
+{
+  std::vector<Mapping*> &mappings=table[mem];
+
+  for(size_t i=0;i<mappings.size();i++) {
+    Mapping *m=mappings[i];
+    if(!m->persistent || m->mapped || m->offset!=offset || m->size!=size)
+      continue;
+    if(m->ptr==ptr) {
+      m->mapped=true;
+      return NanNew(m->view);
+    }
+    // the driver moved the region, the old view must not reach it any more
+    detach(m);
+    mappings.erase(mappings.begin()+i);
+    break;
+  }
+
+  Mapping *m=record(mappings, ptr, size);
+  m->offset=offset;
+  m->persistent=true;
+  return NanNew(m->view);
+}
+
+void *MappingTable::find(cl_mem mem, Local<Value> value)
+{
+  Table::iterator it=table.find(mem);
+  if(it==table.end() || !value->IsObject())
+    return NULL;
+
+  NanScope();
+  Local<Value> buffer;
+  if(value->IsArrayBufferView())
+    buffer=Local<ArrayBufferView>::Cast(value)->Buffer();
+
+  std::vector<Mapping*> &mappings=it->second;
+  for(size_t i=0;i<mappings.size();i++) {
+    Mapping *m=mappings[i];
+    if(!m->mapped)
+      continue;
+    Local<Uint8Array> view=Local<Uint8Array>::Cast(NanNew(m->view));
+    Local<Value> view_buffer=view->Buffer();
+    if(view->StrictEquals(value) || view_buffer->StrictEquals(value) ||
+       (!buffer.IsEmpty() && view_buffer->StrictEquals(buffer)))
+      return m->ptr;
+    // legacy callers unmap node Buffers wrapping the mapped pointer
+    if(node::Buffer::HasInstance(value) && node::Buffer::Data(value->ToObject())==m->ptr)
+      return m->ptr;
+  }
+  return NULL;
+}
+
+void MappingTable::remove(cl_mem mem, void *ptr)
+{
+  Table::iterator it=table.find(mem);
+  if(it==table.end())
+    return;
+
+  std::vector<Mapping*> &mappings=it->second;
+  for(size_t i=0;i<mappings.size();i++) {
+    Mapping *m=mappings[i];
+    if(m->ptr!=ptr || !m->mapped)
+      continue;
+    if(m->persistent) {
+      m->mapped=false;
+      return;
+    }
+    detach(m);
+    mappings.erase(mappings.begin()+i);
+    if(mappings.empty())
+      table.erase(it);
+    return;
+  }
+}
+
+void MappingTable::releaseAll(cl_mem mem)
+{
+  Table::iterator it=table.find(mem);
+  if(it==table.end())
+    return;
+
+  std::vector<Mapping*> &mappings=it->second;
+  for(size_t i=0;i<mappings.size();i++)
+    detach(mappings[i]);
+  table.erase(it);
+}
+
+size_t MappingTable::count(cl_mem mem)
+{
+  Table::iterator it=table.find(mem);
+  if(it==table.end())
+    return 0;
+  size_t n=0;
+  for(size_t i=0;i<it->second.size();i++)
+    if(it->second[i]->mapped) n++;
+  return n;
+}
+
+void MappingTable::detach(Mapping *mapping)
+{
+  NanScope();
+  Local<Uint8Array> view=Local<Uint8Array>::Cast(NanNew(mapping->view));
+  view->Buffer()->Neuter();
+  NanDisposePersistent(mapping->view);
+  delete mapping;
+}
+
+} // namespace
@@ -0,0 +1,92 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MAPPING_H_
+#define MAPPING_H_
+
+#include "common.h"
+#include <map>
+#include <vector>
+
+namespace webcl {
+
+// Live mappings of memory objects. Mapped regions are handed to JS as
+// Uint8Array views on external ArrayBuffers. Unmapping detaches the
+// ArrayBuffer, so no JS object keeps pointing to memory the driver may have
+// taken back; only regions recorded here can be unmapped.
+//
+// Persistent mappings are for buffers backed by host memory
+// (CL_MEM_USE_HOST_PTR or CL_MEM_ALLOC_HOST_PTR) mapped again and again,
+// e.g. once per frame. Drivers map those in place, so the view of a
+// persistent region stays attached across unmaps and is returned again by
+// the next map of the same region as long as the driver hands out the same
+// pointer. It is detached once the pointer changes or the buffer is
+// released.
+class MappingTable
+{
+
+public:
+  // records ptr, mapped from mem, and returns its view
+  static v8::Local<v8::Object> add(cl_mem mem, void *ptr, size_t size);
+
+  // same for a persistent region of mem at offset, reusing its view
+  static v8::Local<v8::Object> addPersistent(cl_mem mem, size_t offset, void *ptr, size_t size);
+
+  // pointer of the mapping of mem that value (a view, its ArrayBuffer or a
+  // node Buffer) refers to, NULL if there is none
+  static void *find(cl_mem mem, v8::Local<v8::Value> value);
+
+  // forgets the mapping of ptr once unmapped, detaching its view unless it
+  // is persistent
+  static void remove(cl_mem mem, void *ptr);
+
+  // detaches the views of all mappings of mem, about to be released
+  static void releaseAll(cl_mem mem);
+
+  // number of mappings of mem currently mapped, persistent regions only
+  // while mapped
+  static size_t count(cl_mem mem);
+
+private:
+  struct Mapping {
+    void *ptr;
+    size_t size;
+    size_t offset;
+    bool persistent;
+    bool mapped;
+    v8::Persistent<v8::Object> view;
+  };
+
+  static Mapping *record(std::vector<Mapping*> &mappings, void *ptr, size_t size);
+  static void detach(Mapping *mapping);
+
+  typedef std::map<cl_mem, std::vector<Mapping*> > Table;
+  static Table table;
+};
+
+} // namespace
+
+#endif
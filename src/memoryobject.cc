@@ -26,6 +26,7 @@
 
 #include "memoryobject.h"
 #include "context.h"
+#include "mapping.h"
 #include <node_buffer.h>
 
 using namespace v8;
@@ -62,7 +63,10 @@ void MemoryObject::Destructor() {
   #ifdef LOGGING
   printf("  Destroying CL memory object %p\n",this);
   #endif
-  if(memory) ::clReleaseMemObject(memory);
+  if(memory) {
+    MappingTable::releaseAll(memory);
+    ::clReleaseMemObject(memory);
+  }
   memory=0;
 }
 
@@ -125,7 +129,7 @@ NAN_METHOD(MemoryObject::getInfo)
       return NanThrowError("UNKNOWN ERROR");
     }
 
-    NanReturnValue(JS_INT((int32_t)param_value));
+    NanReturnValue(JS_NUM(param_value));
   }
   case CL_MEM_ASSOCIATED_MEMOBJECT: {
     cl_mem param_value=NULL;
@@ -234,10 +238,17 @@ MemoryObject *MemoryObject::New(cl_mem mw)
 
   MemoryObject *memobj = ObjectWrap::Unwrap<MemoryObject>(obj);
   memobj->memory = mw;
+  mapCLObj(memobj, mw);
 
   return memobj;
 }
 
+bool MemoryObject::HasInstance(Handle<Value> value)
+{
+  return WebCLBuffer::HasInstance(value) || WebCLImage::HasInstance(value) ||
+         NanNew(constructor_template)->HasInstance(value);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // WebCLBuffer
 ///////////////////////////////////////////////////////////////////////////////
@@ -263,8 +274,38 @@ void WebCLBuffer::Init(Handle<Object> target)
   target->Set(NanNew("WebCLBuffer"), ctor->GetFunction());
 }
 
-WebCLBuffer::WebCLBuffer(Handle<Object> wrapper) : MemoryObject(wrapper)
+WebCLBuffer::WebCLBuffer(Handle<Object> wrapper)
+  : MemoryObject(wrapper), owner(NULL), owner_flags(0), owner_block(0),
+    has_sub_buffers(false)
+{
+}
+
+void WebCLBuffer::Destructor() {
+  if(!owner) {
+    MemoryObject::Destructor();
+    return;
+  }
+  #ifdef LOGGING
+  printf("  Returning CL buffer %p to its owner\n",this);
+  #endif
+  if(memory) {
+    // a mapped region may still be written by the host and a sub-buffer
+    // still aliases its parent, never recycle either
+    bool reusable=!has_sub_buffers && MappingTable::count(memory)==0;
+    MappingTable::releaseAll(memory);
+    owner->reclaim(memory, owner_flags, owner_block, reusable);
+  }
+  memory=0;
+  owner->release();
+  owner=NULL;
+}
+
+void WebCLBuffer::setOwner(BufferOwner *owner, cl_mem_flags flags, size_t block)
 {
+  owner->retain();
+  this->owner=owner;
+  owner_flags=flags;
+  owner_block=block;
 }
 
 NAN_METHOD(WebCLBuffer::getInfo)
@@ -295,8 +336,8 @@ NAN_METHOD(WebCLBuffer::createSubBuffer)
   cl_mem_flags flags = args[0]->Uint32Value();
 
   cl_buffer_region region;
-  region.origin = args[1]->Uint32Value();
-  region.size = args[2]->Uint32Value();
+  region.origin = SizeValue(args[1]);
+  region.size = SizeValue(args[2]);
 
   cl_int ret=CL_SUCCESS;
   cl_mem sub_buffer = ::clCreateSubBuffer(
@@ -314,6 +355,7 @@ NAN_METHOD(WebCLBuffer::createSubBuffer)
     REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
     return NanThrowError("UNKNOWN ERROR");
   }
+  mo->has_sub_buffers=true;
 
   NanReturnValue(NanObjectWrapHandle(WebCLBuffer::New(sub_buffer)));
 }
@@ -337,10 +379,16 @@ WebCLBuffer *WebCLBuffer::New(cl_mem mw)
 
   WebCLBuffer *memobj = ObjectWrap::Unwrap<WebCLBuffer>(obj);
   memobj->memory = mw;
+  mapCLObj(memobj, mw);
 
   return memobj;
 }
 
+bool WebCLBuffer::HasInstance(Handle<Value> value)
+{
+  return NanNew(constructor_template)->HasInstance(value);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // WebCLImage
 ///////////////////////////////////////////////////////////////////////////////
@@ -464,10 +512,16 @@ WebCLImage *WebCLImage::New(cl_mem mw)
  
   WebCLImage *memobj = ObjectWrap::Unwrap<WebCLImage>(obj);
   memobj->memory = mw;
+  mapCLObj(memobj, mw);
 
   return memobj;
 }
 
+bool WebCLImage::HasInstance(Handle<Value> value)
+{
+  return NanNew(constructor_template)->HasInstance(value);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // WebCLImageDescriptor
 ///////////////////////////////////////////////////////////////////////////////
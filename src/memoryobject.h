@@ -31,6 +31,30 @@
 
 namespace webcl {
 
+// Takes back the cl_mem of a WebCLBuffer it handed out when the buffer is
+// released, instead of clReleaseMemObject. Owners are reference counted by
+// their buffers, which may outlive the object that created the owner.
+class BufferOwner
+{
+
+public:
+  BufferOwner() : refs(1) {}
+
+  void retain() { ++refs; }
+  void release() { if(--refs==0) delete this; }
+
+  // block is the value given to WebCLBuffer::setOwner(), reusable is false
+  // when mem may still be in use on the host (e.g. it was mapped) and must
+  // not be handed out again
+  virtual void reclaim(cl_mem mem, cl_mem_flags flags, size_t block, bool reusable) = 0;
+
+protected:
+  virtual ~BufferOwner() {}
+
+private:
+  int refs;
+};
+
 class MemoryObject : public WebCLObject
 {
 
@@ -46,7 +70,9 @@ public:
   static NAN_METHOD(release);
   
   cl_mem getMemory() const { return memory; };
-  virtual bool isEqual(void *clObj) { return ((cl_mem)clObj)==memory; }
+
+  // true for WebCLMemoryObject, WebCLBuffer and WebCLImage objects
+  static bool HasInstance(v8::Handle<v8::Value> value);
 
 private:
   static v8::Persistent<v8::FunctionTemplate> constructor_template;
@@ -59,6 +85,8 @@ protected:
 
 class WebCLBuffer : public MemoryObject {
 public:
+  void Destructor();
+
   static void Init(v8::Handle<v8::Object> target);
 
   static WebCLBuffer *New(cl_mem mw);
@@ -68,10 +96,20 @@ public:
   static NAN_METHOD(release);
   static NAN_METHOD(createSubBuffer);
 
+  // buffer handed out by owner, returned to it instead of being released
+  void setOwner(BufferOwner *owner, cl_mem_flags flags, size_t block);
+
+  static bool HasInstance(v8::Handle<v8::Value> value);
+
 private:
   WebCLBuffer(v8::Handle<v8::Object> wrapper);
 
   static v8::Persistent<v8::FunctionTemplate> constructor_template;
+
+  BufferOwner *owner;
+  cl_mem_flags owner_flags;
+  size_t owner_block;
+  bool has_sub_buffers;
 };
 
 class WebCLImage : public MemoryObject {
@@ -85,6 +123,8 @@ public:
   static NAN_METHOD(getGLObjectInfo);
   static NAN_METHOD(getGLTextureInfo);
 
+  static bool HasInstance(v8::Handle<v8::Value> value);
+
 private:
   WebCLImage(v8::Handle<v8::Object> wrapper);
 
@@ -211,6 +211,7 @@ Platform *Platform::New(cl_platform_id pid)
 
   Platform *platform = ObjectWrap::Unwrap<Platform>(obj);
   platform->platform_id = pid;
+  mapCLObj(platform, pid);
 
   return platform;
 }
@@ -28,6 +28,8 @@
 #include "device.h"
 #include "kernel.h"
 #include "context.h"
+#include "programcache.h"
+#include "programlibrary.h"
 
 #include <vector>
 #include <cstdlib>
@@ -53,14 +55,18 @@ void Program::Init(Handle<Object> target)
   NODE_SET_PROTOTYPE_METHOD(ctor, "_getInfo", getInfo);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_getBuildInfo", getBuildInfo);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_build", build);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_buildAsync", buildAsync);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_createKernel", createKernel);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_createKernelsInProgram", createKernelsInProgram);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_acquireKernel", acquireKernel);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_createVariant", createVariant);
   NODE_SET_PROTOTYPE_METHOD(ctor, "_release", release);
 
   target->Set(NanNew("WebCLProgram"), ctor->GetFunction());
 }
 
-Program::Program(Handle<Object> wrapper) : program(0)
+Program::Program(Handle<Object> wrapper) : program(0), from_cache(false), library(NULL), base(NULL),
+    shared(NULL), holders(0)
 {
   _type=CLObjType::Program;
 }
@@ -69,15 +75,113 @@ void Program::Destructor() {
   #ifdef LOGGING
   cout<<"  Destroying CL program"<<endl;
   #endif
+  releaseVariants();
+  releaseKernels();
   if(program) ::clReleaseProgram(program);
   program=0;
 }
 
+void Program::releaseKernels()
+{
+  // kernels still in use become ordinary kernels, released by their owner
+  for(size_t i=0;i<kernels.size();i++) {
+    PooledKernel *pk=kernels[i];
+    pk->kernel->setPool(NULL);
+    if(!pk->in_use) {
+      DESTROY_WEBCL_OBJECT(pk->kernel);
+    }
+    NanDisposePersistent(pk->handle);
+    delete pk;
+  }
+  kernels.clear();
+}
+
+void Program::releaseVariants()
+{
+  std::map<std::string, Variant*>::iterator it;
+  for(it=variants.begin(); it!=variants.end(); ++it) {
+    Variant *v=it->second;
+    v->program->base=NULL;
+    DESTROY_WEBCL_OBJECT(v->program);
+    NanDisposePersistent(v->handle);
+    delete v;
+  }
+  variants.clear();
+}
+
+Kernel *Program::poolKernel(cl_kernel kw, const std::string &name, bool in_use)
+{
+  Kernel *kernel = Kernel::New(kw);
+  kernel->setPool(this);
+
+  PooledKernel *pk=new PooledKernel();
+  pk->name=name;
+  pk->kernel=kernel;
+  pk->in_use=in_use;
+  NanAssignPersistent(pk->handle, NanObjectWrapHandle(kernel));
+  kernels.push_back(pk);
+  return kernel;
+}
+
+void Program::reclaimKernel(Kernel *kernel)
+{
+  for(size_t i=0;i<kernels.size();i++) {
+    PooledKernel *pk=kernels[i];
+    if(pk->kernel==kernel) {
+      // the next user gets a new handle, the released one is dead
+      pk->kernel=kernel->handOver();
+      NanDisposePersistent(pk->handle);
+      NanAssignPersistent(pk->handle, NanObjectWrapHandle(pk->kernel));
+      pk->in_use=false;
+      return;
+    }
+  }
+}
+
+void Program::storeBinaries()
+{
+  if(!from_cache && !source.empty())
+    ProgramCache::store(program, source, build_options);
+}
+
+void Program::setProgram(cl_program p)
+{
+  if(program) ::clReleaseProgram(program);
+  program=p;
+  mapCLObj(this, p);
+}
+
 NAN_METHOD(Program::release)
 {
   NanScope();
   Program *prog = ObjectWrap::Unwrap<Program>(args.This());
-  
+
+  // variants are released with the program they specialize
+  if(prog->base)
+    NanReturnUndefined();
+
+  // a holder gives up its reference once, later calls find no program
+  if(prog->shared) {
+    Program *shared=prog->shared;
+    prog->shared=NULL;
+    shared->holders--;
+    if(shared->library)
+      shared->library->release(shared);
+    else if(shared->holders==0) {
+      // its library was closed while it was held
+      DESTROY_WEBCL_OBJECT(shared);
+    }
+    NanDisposePersistent(prog->shared_handle);
+    DESTROY_WEBCL_OBJECT(prog);
+    NanReturnUndefined();
+  }
+
+  // shared programs stay built until their library evicts them
+  if(prog->library) {
+    prog->library->release(prog);
+    NanReturnUndefined();
+  }
+
   DESTROY_WEBCL_OBJECT(prog);
   
   NanReturnUndefined();
@@ -185,13 +289,10 @@ NAN_METHOD(Program::getInfo)
     delete[] sizes;
     NanReturnValue(sizesArray);
   }
-  case CL_PROGRAM_BINARIES: { // TODO
-    return NanThrowError("PROGRAM_BINARIES not implemented");
-
-    size_t nbins=0;
-    cl_int ret=::clGetProgramInfo(prog->getProgram(), CL_PROGRAM_BINARIES, 0, NULL, &nbins);
-    char* *binaries=new char*[nbins];
-    ret=::clGetProgramInfo(prog->getProgram(), CL_PROGRAM_BINARIES, sizeof(char*)*nbins, binaries, NULL);
+  case CL_PROGRAM_BINARIES: {
+    std::vector<cl_device_id> devices;
+    std::vector<std::vector<unsigned char> > binaries;
+    cl_int ret=ProgramCache::getBinaries(prog->getProgram(), devices, binaries);
     if (ret != CL_SUCCESS) {
       REQ_ERROR_THROW(INVALID_VALUE);
       REQ_ERROR_THROW(INVALID_PROGRAM);
@@ -200,15 +301,16 @@ NAN_METHOD(Program::getInfo)
       return NanThrowError("UNKNOWN ERROR");
     }
 
-    // TODO create an array for Uint8Array to return each binary associated to each device
-    // Handle<Value> abv = Context::GetCurrent()->Global()->Get(NanNewSymbol("ArrayBuffer"));
-    // Handle<Value> argv[] = { NanNew(size) };
-    // Handle<Object> arrbuf = Handle<Function>::Cast(abv)->NewInstance(1, argv);
-    // void *buffer = arrbuf->GetPointerFromInternalField(0);
-    // memcpy(buffer, data, size);
-
-    delete[] binaries;
-    NanReturnUndefined();
+    // one Uint8Array per device, in the order of PROGRAM_DEVICES
+    Local<Array> binArray = NanNew<Array>(binaries.size());
+    for (size_t i=0; i<binaries.size(); i++) {
+      size_t size=binaries[i].size();
+      Local<ArrayBuffer> buffer=ArrayBuffer::New(Isolate::GetCurrent(), size);
+      if(size)
+        memcpy(buffer->GetContents().Data(), &binaries[i].front(), size);
+      binArray->Set(i, Uint8Array::New(buffer, 0, size));
+    }
+    NanReturnValue(binArray);
   }
   default:
     return NanThrowError("UNKNOWN param_name");
@@ -269,6 +371,7 @@ class ProgramWorker : public NanAsyncWorker {
       NanScope();
 
       if (!baton_->data.IsEmpty()) NanDisposePersistent(baton_->data);
+      if (!baton_->parent.IsEmpty()) NanDisposePersistent(baton_->parent);
       delete baton_;
     }
   }
@@ -288,6 +391,11 @@ class ProgramWorker : public NanAsyncWorker {
   void HandleOKCallback () {
     NanScope();
 
+    if(baton_->error == CL_BUILD_SUCCESS && !baton_->parent.IsEmpty()) {
+      Program *prog = node::ObjectWrap::Unwrap<Program>(NanNew(baton_->parent));
+      prog->storeBinaries();
+    }
+
     Local<Value> argv[]={
         JS_INT(baton_->error)
     };
@@ -324,6 +432,60 @@ void Program::callback (cl_program program, void *user_data)
   NanAsyncQueueWorker(new ProgramWorker(baton));
 }
 
+cl_int Program::buildProgram(cl_uint num, const cl_device_id *devices, const char *options, Baton *baton)
+{
+  build_options = options ? options : "";
+  arg_descriptors.clear();
+  from_cache = false;
+
+  cl_int ret = CL_BUILD_PROGRAM_FAILURE;
+  bool built = false;
+
+  // programs built from source before are created from their binaries
+  if(!source.empty() && ProgramCache::enabled()) {
+    std::vector<cl_device_id> targets(devices, devices+num);
+    if(targets.empty()) {
+      cl_uint num_devices=0;
+      ::clGetProgramInfo(getProgram(), CL_PROGRAM_NUM_DEVICES, sizeof(cl_uint), &num_devices, NULL);
+      targets.resize(num_devices);
+      if(num_devices>0)
+        ::clGetProgramInfo(getProgram(), CL_PROGRAM_DEVICES, sizeof(cl_device_id)*num_devices, &targets.front(), NULL);
+    }
+
+    cl_context context=NULL;
+    ::clGetProgramInfo(getProgram(), CL_PROGRAM_CONTEXT, sizeof(cl_context), &context, NULL);
+    std::string descriptors;
+    cl_program binary = ProgramCache::load(context, source, build_options, targets, descriptors);
+    if(binary) {
+      ret = ::clBuildProgram(binary, (cl_uint) targets.size(), &targets.front(),
+          options,
+          baton ? Program::callback : NULL,
+          baton);
+      if(ret == CL_SUCCESS) {
+        setProgram(binary);
+        arg_descriptors = descriptors;
+        from_cache = true;
+        built = true;
+      }
+      else {
+        ::clReleaseProgram(binary);
+        ProgramCache::reject();
+      }
+    }
+  }
+
+  if(!built) {
+    ret = ::clBuildProgram(getProgram(), num, devices,
+        options,
+        baton ? Program::callback : NULL,
+        baton);
+    if(ret == CL_SUCCESS && !baton)
+      storeBinaries();
+  }
+
+  return ret;
+}
+
 NAN_METHOD(Program::build)
 {
   NanScope();
@@ -366,14 +528,13 @@ NAN_METHOD(Program::build)
 
     baton=new Baton();
     baton->callback=new NanCallback(args[2].As<Function>());
+    // binaries are cached once the build completes
+    NanAssignPersistent(baton->parent, args.This());
   }
 
   // printf("Build program with baton %p\n",baton);
 
-  cl_int ret = ::clBuildProgram(prog->getProgram(), num, devices,
-      options,
-      baton ? Program::callback : NULL,
-      baton);
+  cl_int ret = prog->buildProgram((cl_uint) num, devices, options, baton);
 
   if(options) free(options);
   if(devices) delete[] devices;
@@ -395,6 +556,157 @@ NAN_METHOD(Program::build)
   NanReturnUndefined();
 }
 
+// Builds a program on a libuv worker thread, whether or not the driver
+// builds asynchronously itself. Execute() only makes OpenCL and cache calls;
+// the program object is updated back on the main thread.
+class BuildWorker : public NanAsyncWorker {
+ public:
+  BuildWorker(NanCallback *callback, Program *prog, const std::vector<cl_device_id> &devices,
+              const std::string &options)
+    : NanAsyncWorker(callback), program(prog->getProgram()), binary(NULL),
+      devices(devices), options(options), source(prog->source),
+      use_cache(!prog->source.empty() && ProgramCache::enabled()),
+      status(CL_SUCCESS) {
+    // the program may be released while it builds
+    ::clRetainProgram(program);
+  }
+
+  ~BuildWorker() {
+    ::clReleaseProgram(program);
+    if(binary) ::clReleaseProgram(binary);
+  }
+
+  void Execute () {
+    const char *opts = options.empty() ? NULL : options.c_str();
+    if(devices.empty()) {
+      cl_uint num_devices=0;
+      ::clGetProgramInfo(program, CL_PROGRAM_NUM_DEVICES, sizeof(cl_uint), &num_devices, NULL);
+      devices.resize(num_devices);
+      if(num_devices>0)
+        ::clGetProgramInfo(program, CL_PROGRAM_DEVICES, sizeof(cl_device_id)*num_devices, &devices.front(), NULL);
+    }
+    if(devices.empty()) {
+      status=CL_INVALID_DEVICE;
+      return;
+    }
+
+    if(use_cache) {
+      cl_context context=NULL;
+      ::clGetProgramInfo(program, CL_PROGRAM_CONTEXT, sizeof(cl_context), &context, NULL);
+      binary = ProgramCache::load(context, source, options, devices, descriptors);
+      if(binary && ::clBuildProgram(binary, (cl_uint) devices.size(), &devices.front(), opts, NULL, NULL)!=CL_SUCCESS) {
+        ::clReleaseProgram(binary);
+        binary=NULL;
+        ProgramCache::reject();
+      }
+    }
+
+    cl_program built = binary ? binary : program;
+    if(!binary) {
+      status = ::clBuildProgram(program, (cl_uint) devices.size(), &devices.front(), opts, NULL, NULL);
+      if(status == CL_SUCCESS && use_cache)
+        ProgramCache::store(program, source, options);
+    }
+
+    build_status.resize(devices.size());
+    logs.resize(devices.size());
+    for(size_t i=0;i<devices.size();i++) {
+      build_status[i]=CL_BUILD_NONE;
+      ::clGetProgramBuildInfo(built, devices[i], CL_PROGRAM_BUILD_STATUS, sizeof(cl_build_status), &build_status[i], NULL);
+      size_t size=0;
+      ::clGetProgramBuildInfo(built, devices[i], CL_PROGRAM_BUILD_LOG, 0, NULL, &size);
+      if(size>1) {
+        std::vector<char> log(size);
+        ::clGetProgramBuildInfo(built, devices[i], CL_PROGRAM_BUILD_LOG, size, &log.front(), NULL);
+        logs[i].assign(&log.front(), strnlen(&log.front(), size));
+      }
+    }
+  }
+
+  // calls back with (status, result), result being
+  //   { status, fromCache, devices: [ { device, status, log } ] }
+  void HandleOKCallback () {
+    NanScope();
+
+    Program *prog = node::ObjectWrap::Unwrap<Program>(GetFromPersistent("program"));
+    if(prog->getProgram()) {
+      prog->build_options = options;
+      prog->from_cache = binary!=NULL;
+      prog->arg_descriptors = binary ? descriptors : std::string();
+      if(binary) {
+        prog->setProgram(binary);
+        binary=NULL;
+      }
+    }
+
+    Local<Array> deviceArray = NanNew<Array>(devices.size());
+    for(size_t i=0;i<devices.size();i++) {
+      WebCLObject *dev=findCLObj((void*)devices[i]);
+      Local<Object> info = NanNew<Object>();
+      info->Set(JS_STR("device"), NanObjectWrapHandle(dev ? dev : Device::New(devices[i])));
+      info->Set(JS_STR("status"), JS_INT(build_status[i]));
+      info->Set(JS_STR("log"), JS_STR(logs[i].c_str()));
+      deviceArray->Set(i, info);
+    }
+
+    Local<Object> result = NanNew<Object>();
+    result->Set(JS_STR("status"), JS_INT(status));
+    if(status!=CL_SUCCESS)
+      result->Set(JS_STR("message"), JS_STR(ErrorDesc(status)));
+    result->Set(JS_STR("fromCache"), NanNew<Boolean>(prog->from_cache && status==CL_SUCCESS));
+    result->Set(JS_STR("devices"), deviceArray);
+
+    Local<Value> argv[]={
+        JS_INT(status),
+        result
+    };
+    callback->Call(2, argv);
+  }
+
+ private:
+  cl_program program, binary;
+  std::vector<cl_device_id> devices;
+  std::string options, source, descriptors;
+  bool use_cache;
+  cl_int status;
+  std::vector<cl_build_status> build_status;
+  std::vector<std::string> logs;
+};
+
+NAN_METHOD(Program::buildAsync)
+{
+  NanScope();
+  Program *prog = ObjectWrap::Unwrap<Program>(args.This());
+
+  std::vector<cl_device_id> devices;
+  if(args[0]->IsArray()) {
+    Local<Array> deviceArray = Local<Array>::Cast(args[0]);
+    for (uint32_t i=0; i<deviceArray->Length(); i++) {
+      Device *d = ObjectWrap::Unwrap<Device>(deviceArray->Get(i)->ToObject());
+      devices.push_back(d->getDevice());
+    }
+  }
+  else if(args[0]->IsObject()) {
+    Device *d = ObjectWrap::Unwrap<Device>(args[0]->ToObject());
+    devices.push_back(d->getDevice());
+  }
+
+  std::string options;
+  if(args[1]->IsString()) {
+    String::Utf8Value str(args[1]);
+    options.assign(*str, str.length());
+  }
+
+  if(!args[2]->IsFunction())
+    return NanThrowTypeError("Expected a callback");
+
+  BuildWorker *worker=new BuildWorker(new NanCallback(args[2].As<Function>()), prog, devices, options);
+  worker->SaveToPersistent("program", args.This());
+  NanAsyncQueueWorker(worker);
+
+  NanReturnUndefined();
+}
+
 NAN_METHOD(Program::createKernel)
 {
   NanScope();
@@ -420,6 +732,127 @@ NAN_METHOD(Program::createKernel)
   NanReturnValue(NanObjectWrapHandle(Kernel::New(kw)));
 }
 
+NAN_METHOD(Program::acquireKernel)
+{
+  NanScope();
+  Program *prog = ObjectWrap::Unwrap<Program>(args.This());
+  if(prog->shared) prog=prog->shared;
+
+  Local<String> str = args[0]->ToString();
+  String::Utf8Value astr(str);
+  std::string name(*astr, astr.length());
+
+  // an idle kernel keeps the arguments of its previous user
+  for(size_t i=0;i<prog->kernels.size();i++) {
+    PooledKernel *pk=prog->kernels[i];
+    if(!pk->in_use && pk->name==name) {
+      pk->in_use=true;
+      if(prog->library) prog->library->countKernel(true);
+      NanReturnValue(NanNew(pk->handle));
+    }
+  }
+
+  cl_int ret = CL_SUCCESS;
+  cl_kernel kw = ::clCreateKernel(prog->getProgram(), name.c_str(), &ret);
+
+  if (ret != CL_SUCCESS) {
+    REQ_ERROR_THROW(INVALID_PROGRAM);
+    REQ_ERROR_THROW(INVALID_PROGRAM_EXECUTABLE);
+    REQ_ERROR_THROW(INVALID_KERNEL_NAME);
+    REQ_ERROR_THROW(INVALID_KERNEL_DEFINITION);
+    REQ_ERROR_THROW(INVALID_VALUE);
+    REQ_ERROR_THROW(OUT_OF_RESOURCES);
+    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
+    return NanThrowError("UNKNOWN ERROR");
+  }
+
+  Kernel *kernel = prog->poolKernel(kw, name, true);
+  if(prog->library) prog->library->countKernel(false);
+
+  NanReturnValue(NanObjectWrapHandle(kernel));
+}
+
+// Variant of a program built from source with options, typically -D
+// constants. Variants are cached by options and all their kernels are
+// created in their pool, ready for acquireKernel().
+NAN_METHOD(Program::createVariant)
+{
+  NanScope();
+  Program *prog = ObjectWrap::Unwrap<Program>(args.This());
+  if(prog->shared) prog=prog->shared;
+
+  // variants keep the options the program itself was built with
+  String::Utf8Value str(args[0]);
+  std::string options=prog->build_options;
+  if(!options.empty() && str.length()>0)
+    options+=" ";
+  options.append(*str, str.length());
+
+  std::map<std::string, Variant*>::iterator it=prog->variants.find(options);
+  if(it!=prog->variants.end())
+    NanReturnValue(NanNew(it->second->handle));
+
+  cl_int ret=CL_SUCCESS;
+  if(prog->source.empty()) {
+    ret=CL_INVALID_PROGRAM;
+    REQ_ERROR_THROW(INVALID_PROGRAM);
+  }
+
+  cl_context context=NULL;
+  ret=::clGetProgramInfo(prog->getProgram(), CL_PROGRAM_CONTEXT, sizeof(cl_context), &context, NULL);
+  size_t lengths[]={ prog->source.size() };
+  const char *strings[]={ prog->source.data() };
+  cl_program pw=NULL;
+  if(ret==CL_SUCCESS)
+    pw=::clCreateProgramWithSource(context, 1, strings, lengths, &ret);
+  if (ret != CL_SUCCESS) {
+    REQ_ERROR_THROW(INVALID_PROGRAM);
+    REQ_ERROR_THROW(INVALID_CONTEXT);
+    REQ_ERROR_THROW(OUT_OF_RESOURCES);
+    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
+    return NanThrowError("UNKNOWN ERROR");
+  }
+
+  Program *variant=Program::New(pw);
+  variant->setSource(prog->source);
+  ret=variant->buildProgram(0, NULL, options.empty() ? NULL : options.c_str(), NULL);
+
+  cl_uint num_kernels=0;
+  std::vector<cl_kernel> kernels;
+  if(ret==CL_SUCCESS)
+    ret=::clCreateKernelsInProgram(variant->getProgram(), 0, NULL, &num_kernels);
+  if(ret==CL_SUCCESS && num_kernels>0) {
+    kernels.resize(num_kernels);
+    ret=::clCreateKernelsInProgram(variant->getProgram(), num_kernels, &kernels.front(), NULL);
+  }
+
+  if (ret != CL_SUCCESS) {
+    DESTROY_WEBCL_OBJECT(variant);
+    REQ_ERROR_THROW(INVALID_BUILD_OPTIONS);
+    REQ_ERROR_THROW(BUILD_PROGRAM_FAILURE);
+    REQ_ERROR_THROW(COMPILER_NOT_AVAILABLE);
+    REQ_ERROR_THROW(INVALID_PROGRAM_EXECUTABLE);
+    REQ_ERROR_THROW(OUT_OF_RESOURCES);
+    REQ_ERROR_THROW(OUT_OF_HOST_MEMORY);
+    return NanThrowError("UNKNOWN ERROR");
+  }
+
+  for(cl_uint i=0;i<num_kernels;i++) {
+    char name[256]="";
+    ::clGetKernelInfo(kernels[i], CL_KERNEL_FUNCTION_NAME, sizeof(name), name, NULL);
+    name[sizeof(name)-1]=0;
+    variant->poolKernel(kernels[i], name, false);
+  }
+
+  Variant *v=new Variant();
+  v->program=variant;
+  NanAssignPersistent(v->handle, NanObjectWrapHandle(variant));
+  variant->base=prog;
+  prog->variants[options]=v;
+
+  NanReturnValue(NanObjectWrapHandle(variant));
+}
+
 NAN_METHOD(Program::createKernelsInProgram)
 {
   NanScope();
@@ -499,8 +932,28 @@ Program *Program::New(cl_program pw)
 
   Program *progobj = ObjectWrap::Unwrap<Program>(obj);
   progobj->program = pw;
+  mapCLObj(progobj, pw);
 
   return progobj;
 }
 
+Program *Program::NewHolder(Program *shared)
+{
+  NanScope();
+
+  Local<Value> arg = NanNew(0);
+  Local<FunctionTemplate> constructorHandle = NanNew(constructor_template);
+  Local<Object> obj = constructorHandle->GetFunction()->NewInstance(1, &arg);
+
+  // holders aren't mapped, findCLObj() keeps returning the shared program
+  Program *holder = ObjectWrap::Unwrap<Program>(obj);
+  holder->program = shared->program;
+  ::clRetainProgram(holder->program);
+  holder->shared = shared;
+  NanAssignPersistent(holder->shared_handle, NanObjectWrapHandle(shared));
+  shared->holders++;
+
+  return holder;
+}
+
 } // namespace
@@ -28,9 +28,15 @@
 #define PROGRAM_H_
 
 #include "common.h"
+#include <map>
+#include <string>
+#include <vector>
 
 namespace webcl {
 
+class Kernel;
+class ProgramLibrary;
+
 class Program : public WebCLObject
 {
 
@@ -42,24 +48,92 @@ public:
   static Program *New(cl_program pw);
   static NAN_METHOD(New);
 
+  // Handle on a shared program for one holder. Holders share the program's
+  // kernel pool and variants; release() gives up the holder's reference
+  // once and leaves the handle without a program.
+  static Program *NewHolder(Program *shared);
+
   static NAN_METHOD(getInfo);
   static NAN_METHOD(getBuildInfo);
   static NAN_METHOD(build);
+  static NAN_METHOD(buildAsync);
   static NAN_METHOD(createKernel);
   static NAN_METHOD(createKernelsInProgram);
+  static NAN_METHOD(acquireKernel);
+  static NAN_METHOD(createVariant);
   static NAN_METHOD(release);
 
   cl_program getProgram() const { return program; };
-  virtual bool isEqual(void *clObj) { return ((cl_program)clObj)==program; }
+
+  // source of programs created from source, used to look up the binary cache
+  void setSource(const std::string &s) { source=s; }
+  const std::string &getSource() const { return source; }
+  const std::string &getBuildOptions() const { return build_options; }
+
+  // kernel argument descriptors stored with the cached binaries this
+  // program was built from, see ProgramCache::findArgs()
+  const std::string &getArgDescriptors() const { return arg_descriptors; }
+
+  // caches the binaries of a successful build from source
+  void storeBinaries();
+
+  // builds from cached binaries when available, otherwise from source
+  cl_int buildProgram(cl_uint num, const cl_device_id *devices, const char *options, Baton *baton);
+
+  // set on programs shared through a context's ProgramLibrary, whose
+  // release() hands the program back to the library
+  void setLibrary(ProgramLibrary *l) { library=l; }
+  ProgramLibrary *getLibrary() const { return library; }
+
+  // takes back a kernel handed out by acquireKernel()
+  void reclaimKernel(Kernel *kernel);
 
 private:
+  friend class BuildWorker;
+
   Program(v8::Handle<v8::Object> wrapper);
 
   static void callback (cl_program program, void *user_data);
 
+  // replaces the source program by one created from cached binaries
+  void setProgram(cl_program p);
+
   static v8::Persistent<v8::FunctionTemplate> constructor_template;
 
+  // kernels handed out by acquireKernel(), kept alive with the program and
+  // reused once released
+  struct PooledKernel {
+    std::string name;
+    Kernel *kernel;
+    bool in_use;
+    v8::Persistent<v8::Object> handle;
+  };
+
+  // adds kw to the kernel pool
+  Kernel *poolKernel(cl_kernel kw, const std::string &name, bool in_use);
+  void releaseKernels();
+
+  // programs built from the same source with extra options (e.g. -D
+  // constants), owned by this program
+  struct Variant {
+    Program *program;
+    v8::Persistent<v8::Object> handle;
+  };
+
+  void releaseVariants();
+
   cl_program program;
+  std::string source;
+  std::string build_options;
+  std::string arg_descriptors;
+  bool from_cache;
+  ProgramLibrary *library;
+  std::vector<PooledKernel*> kernels;
+  std::map<std::string, Variant*> variants;
+  Program *base; // program this one is a variant of
+  Program *shared; // program this holder handle refers to
+  v8::Persistent<v8::Object> shared_handle;
+  unsigned int holders; // holder handles not released yet
 };
 
 } // namespace
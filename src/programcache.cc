@@ -0,0 +1,557 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "programcache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#ifdef _WIN32
+  #include <direct.h>
+  #include <process.h>
+  #include <windows.h>
+  #define getpid _getpid
+#else
+  #include <dirent.h>
+  #include <unistd.h>
+#endif
+
+using namespace v8;
+
+namespace webcl {
+
+uv_mutex_t ProgramCache::mutex;
+std::string ProgramCache::directory;
+bool ProgramCache::initialized=false;
+unsigned long ProgramCache::serial=0;
+ProgramCache::Stats ProgramCache::stats_={ 0, 0, 0, 0, 0, 0 };
+
+static const char MAGIC[]="WCLB2\n";
+
+#ifdef _WIN32
+static const char SEPARATOR='\\';
+#else
+static const char SEPARATOR='/';
+#endif
+
+// FNV-1a
+static uint64_t hash(const void *data, size_t size, uint64_t h=14695981039346656037ULL)
+{
+  const unsigned char *p=(const unsigned char*) data;
+  for(size_t i=0;i<size;i++) {
+    h^=p[i];
+    h*=1099511628211ULL;
+  }
+  return h;
+}
+
+static std::string hex(uint64_t value)
+{
+  char str[17];
+  snprintf(str, sizeof(str), "%016llx", (unsigned long long) value);
+  return str;
+}
+
+namespace {
+struct Lock {
+  Lock(uv_mutex_t &m) : mutex(m) { uv_mutex_lock(&mutex); }
+  ~Lock() { uv_mutex_unlock(&mutex); }
+  uv_mutex_t &mutex;
+};
+}
+
+void ProgramCache::Init()
+{
+  uv_mutex_init(&mutex);
+}
+
+void ProgramCache::reject()
+{
+  Lock lock(mutex);
+  stats_.errors++;
+}
+
+ProgramCache::Stats ProgramCache::stats()
+{
+  Lock lock(mutex);
+  return stats_;
+}
+
+std::string ProgramCache::digest(const std::string &data)
+{
+  return hex(hash(data.data(), data.size()));
+}
+
+static std::string deviceString(cl_device_id device, cl_device_info param)
+{
+  size_t size=0;
+  if(::clGetDeviceInfo(device, param, 0, NULL, &size)!=CL_SUCCESS || size==0)
+    return "";
+  std::vector<char> value(size);
+  ::clGetDeviceInfo(device, param, size, &value.front(), NULL);
+  return std::string(&value.front());
+}
+
+static std::string platformString(cl_device_id device, cl_platform_info param)
+{
+  cl_platform_id platform=NULL;
+  ::clGetDeviceInfo(device, CL_DEVICE_PLATFORM, sizeof(cl_platform_id), &platform, NULL);
+  size_t size=0;
+  if(!platform || ::clGetPlatformInfo(platform, param, 0, NULL, &size)!=CL_SUCCESS || size==0)
+    return "";
+  std::vector<char> value(size);
+  ::clGetPlatformInfo(platform, param, size, &value.front(), NULL);
+  return std::string(&value.front());
+}
+
+void ProgramCache::makeDirectories(const std::string &dir)
+{
+  for(size_t i=1;i<=dir.size();i++) {
+    if(i<dir.size() && dir[i]!='/' && dir[i]!=SEPARATOR)
+      continue;
+    std::string prefix=dir.substr(0, i);
+#ifdef _WIN32
+    _mkdir(prefix.c_str());
+#else
+    mkdir(prefix.c_str(), 0755);
+#endif
+  }
+}
+
+void ProgramCache::setDirectory(const std::string &dir)
+{
+  Lock lock(mutex);
+  directory=dir;
+  initialized=true;
+}
+
+std::string ProgramCache::getDirectory()
+{
+  Lock lock(mutex);
+  if(!initialized) {
+    initialized=true;
+    const char *env=getenv("WEBCL_PROGRAM_CACHE");
+    if(env)
+      directory=env;
+  }
+  return directory;
+}
+
+// included headers may change without the source changing
+static bool cacheable(const std::string &source, const std::string &options)
+{
+  for(size_t i=options.find("-I"); i!=std::string::npos; i=options.find("-I", i+2))
+    if(i==0 || options[i-1]==' ' || options[i-1]=='\t')
+      return false;
+
+  for(size_t i=source.find('#'); i!=std::string::npos; i=source.find('#', i+1)) {
+    size_t j=i+1;
+    while(j<source.size() && (source[j]==' ' || source[j]=='\t'))
+      j++;
+    if(!source.compare(j, 7, "include"))
+      return false;
+  }
+  return true;
+}
+
+static std::string argString(cl_kernel kernel, cl_uint index, cl_kernel_arg_info param)
+{
+  size_t size=0;
+  if(::clGetKernelArgInfo(kernel, index, param, 0, NULL, &size)!=CL_SUCCESS || size==0)
+    return "";
+  std::vector<char> value(size);
+  ::clGetKernelArgInfo(kernel, index, param, size, &value.front(), NULL);
+  return std::string(&value.front());
+}
+
+bool ProgramCache::queryArgs(cl_kernel kernel, std::vector<ArgDesc> &args)
+{
+  cl_uint num_args=0;
+  if(::clGetKernelInfo(kernel, CL_KERNEL_NUM_ARGS, sizeof(cl_uint), &num_args, NULL)!=CL_SUCCESS)
+    return false;
+
+  args.resize(num_args);
+  for(cl_uint i=0;i<num_args;i++) {
+    ArgDesc &arg=args[i];
+    if(::clGetKernelArgInfo(kernel, i, CL_KERNEL_ARG_ADDRESS_QUALIFIER,
+                            sizeof(arg.address), &arg.address, NULL)!=CL_SUCCESS)
+      return false;
+    arg.type_name=argString(kernel, i, CL_KERNEL_ARG_TYPE_NAME);
+    arg.name=argString(kernel, i, CL_KERNEL_ARG_NAME);
+  }
+  return true;
+}
+
+// one "kernel <name> <count>" line per kernel, followed by an
+// "<address> <type> <name>" line per argument, fields separated by tabs
+static std::string describeArgs(cl_program program)
+{
+  cl_uint num=0;
+  if(::clCreateKernelsInProgram(program, 0, NULL, &num)!=CL_SUCCESS || num==0)
+    return "";
+  std::vector<cl_kernel> kernels(num);
+  if(::clCreateKernelsInProgram(program, num, &kernels.front(), NULL)!=CL_SUCCESS)
+    return "";
+
+  std::string text;
+  for(cl_uint i=0;i<num;i++) {
+    char name[256]="";
+    ::clGetKernelInfo(kernels[i], CL_KERNEL_FUNCTION_NAME, sizeof(name), name, NULL);
+    name[sizeof(name)-1]=0;
+
+    std::vector<ProgramCache::ArgDesc> args;
+    if(ProgramCache::queryArgs(kernels[i], args)) {
+      char line[64];
+      snprintf(line, sizeof(line), "\t%lu\n", (unsigned long) args.size());
+      text+=std::string("kernel\t")+name+line;
+      for(size_t j=0;j<args.size();j++) {
+        snprintf(line, sizeof(line), "%lu\t", (unsigned long) args[j].address);
+        text+=line+args[j].type_name+"\t"+args[j].name+"\n";
+      }
+    }
+    ::clReleaseKernel(kernels[i]);
+  }
+  return text;
+}
+
+bool ProgramCache::findArgs(const std::string &descriptors, const std::string &name, std::vector<ArgDesc> &args)
+{
+  std::vector<std::string> lines;
+  for(size_t pos=0, end; pos<descriptors.size(); pos=end+1) {
+    end=descriptors.find('\n', pos);
+    if(end==std::string::npos)
+      end=descriptors.size();
+    lines.push_back(descriptors.substr(pos, end-pos));
+  }
+
+  std::string header="kernel\t"+name+"\t";
+  for(size_t i=0;i<lines.size();i++) {
+    if(lines[i].compare(0, header.size(), header))
+      continue;
+    size_t count=strtoul(lines[i].c_str()+header.size(), NULL, 10);
+    if(i+count>=lines.size())
+      return false;
+
+    args.resize(count);
+    for(size_t j=0;j<count;j++) {
+      const std::string &line=lines[i+1+j];
+      size_t type=line.find('\t');
+      size_t arg_name = type==std::string::npos ? type : line.find('\t', type+1);
+      if(arg_name==std::string::npos)
+        return false;
+      args[j].address=(cl_kernel_arg_address_qualifier) strtoul(line.c_str(), NULL, 10);
+      args[j].type_name=line.substr(type+1, arg_name-type-1);
+      args[j].name=line.substr(arg_name+1);
+    }
+    return true;
+  }
+  return false;
+}
+
+std::string ProgramCache::key(const std::string &source, const std::string &options, cl_device_id device)
+{
+  char size[32];
+  snprintf(size, sizeof(size), "%lu", (unsigned long) source.size());
+  return "source "+hex(hash(source.data(), source.size()))+" "+size+"\n"+
+         "options "+options+"\n"+
+         "device "+deviceString(device, CL_DEVICE_NAME)+"\n"+
+         "device version "+deviceString(device, CL_DEVICE_VERSION)+"\n"+
+         "driver version "+deviceString(device, CL_DRIVER_VERSION)+"\n"+
+         "platform "+platformString(device, CL_PLATFORM_NAME)+" "+
+                     platformString(device, CL_PLATFORM_VERSION)+"\n";
+}
+
+std::string ProgramCache::path(const std::string &dir, const std::string &key)
+{
+  return dir+SEPARATOR+hex(hash(key.data(), key.size()))+".bin";
+}
+
+// an entry is MAGIC, the key, the source, the argument descriptors and
+// the binary, each but MAGIC preceded by its 64-bit size
+
+static bool readBlock(FILE *f, std::string &data)
+{
+  uint64_t size=0;
+  if(fread(&size, sizeof(size), 1, f)!=1)
+    return false;
+  data.resize((size_t) size);
+  return size==0 || fread(&data[0], 1, data.size(), f)==data.size();
+}
+
+static bool writeBlock(FILE *f, const void *data, size_t size)
+{
+  uint64_t size64=size;
+  return fwrite(&size64, sizeof(size64), 1, f)==1 &&
+         (size==0 || fwrite(data, 1, size, f)==size);
+}
+
+// binary and argument descriptors stored under key for source in file,
+// false if absent or stored for another key or source
+static bool readEntry(const std::string &file, const std::string &key, const std::string &source,
+                      std::string &descriptors, std::vector<unsigned char> &binary)
+{
+  FILE *f=fopen(file.c_str(), "rb");
+  if(!f)
+    return false;
+
+  bool ok=false;
+  char magic[sizeof(MAGIC)-1];
+  std::string stored_key, stored_source, data;
+  if(fread(magic, 1, sizeof(magic), f)==sizeof(magic) && !memcmp(magic, MAGIC, sizeof(magic)) &&
+     readBlock(f, stored_key) && stored_key==key &&
+     readBlock(f, stored_source) && stored_source==source &&
+     readBlock(f, descriptors) && readBlock(f, data) && !data.empty()) {
+    binary.assign(data.begin(), data.end());
+    ok=true;
+  }
+  fclose(f);
+  return ok;
+}
+
+// written to a temporary file of its own first, so readers and other
+// writers never see partial entries
+static bool writeEntry(const std::string &file, const std::string &tmp, const std::string &key,
+                       const std::string &source, const std::string &descriptors,
+                       const std::vector<unsigned char> &binary)
+{
+  FILE *f=fopen(tmp.c_str(), "wb");
+  if(!f)
+    return false;
+
+  bool ok = fwrite(MAGIC, 1, sizeof(MAGIC)-1, f)==sizeof(MAGIC)-1 &&
+            writeBlock(f, key.data(), key.size()) &&
+            writeBlock(f, source.data(), source.size()) &&
+            writeBlock(f, descriptors.data(), descriptors.size()) &&
+            writeBlock(f, &binary.front(), binary.size());
+  ok = (fclose(f)==0) && ok;
+
+#ifdef _WIN32
+  if(ok) remove(file.c_str());
+#endif
+  if(!ok || rename(tmp.c_str(), file.c_str())!=0) {
+    remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+cl_program ProgramCache::load(cl_context context, const std::string &source, const std::string &options,
+                              const std::vector<cl_device_id> &devices, std::string &descriptors)
+{
+  std::string dir=getDirectory();
+  if(dir.empty() || devices.empty() || !cacheable(source, options))
+    return NULL;
+
+  std::vector<std::vector<unsigned char> > binaries(devices.size());
+  std::vector<std::string> files(devices.size());
+  for(size_t i=0;i<devices.size();i++) {
+    std::string k=key(source, options, devices[i]);
+    files[i]=path(dir, k);
+    if(!readEntry(files[i], k, source, descriptors, binaries[i])) {
+      Lock lock(mutex);
+      stats_.misses++;
+      return NULL;
+    }
+  }
+
+  std::vector<size_t> lengths(devices.size());
+  std::vector<const unsigned char*> images(devices.size());
+  std::vector<cl_int> status(devices.size(), CL_SUCCESS);
+  double bytes=0;
+  for(size_t i=0;i<devices.size();i++) {
+    lengths[i]=binaries[i].size();
+    images[i]=&binaries[i].front();
+    bytes+=lengths[i];
+  }
+
+  cl_int ret=CL_SUCCESS;
+  cl_program program=::clCreateProgramWithBinary(context, (cl_uint) devices.size(), &devices.front(),
+                                                 &lengths.front(), &images.front(), &status.front(), &ret);
+  for(size_t i=0;i<devices.size() && ret==CL_SUCCESS;i++)
+    ret=status[i];
+
+  if(ret!=CL_SUCCESS) {
+    // unusable binaries are dropped and rebuilt from source
+    if(program) ::clReleaseProgram(program);
+    for(size_t i=0;i<files.size();i++)
+      remove(files[i].c_str());
+    Lock lock(mutex);
+    stats_.errors++;
+    stats_.misses++;
+    return NULL;
+  }
+
+  Lock lock(mutex);
+  stats_.hits++;
+  stats_.bytes_read+=bytes;
+  return program;
+}
+
+void ProgramCache::store(cl_program program, const std::string &source, const std::string &options)
+{
+  std::string dir=getDirectory();
+  if(dir.empty() || !cacheable(source, options))
+    return;
+
+  std::vector<cl_device_id> devices;
+  std::vector<std::vector<unsigned char> > binaries;
+  if(getBinaries(program, devices, binaries)!=CL_SUCCESS) {
+    Lock lock(mutex);
+    stats_.errors++;
+    return;
+  }
+
+  std::string descriptors=describeArgs(program);
+  makeDirectories(dir);
+  for(size_t i=0;i<devices.size();i++) {
+    cl_build_status status=CL_BUILD_NONE;
+    ::clGetProgramBuildInfo(program, devices[i], CL_PROGRAM_BUILD_STATUS, sizeof(status), &status, NULL);
+    if(status!=CL_BUILD_SUCCESS || binaries[i].empty())
+      continue;
+
+    // temporary files are unique per process and write
+    char suffix[64];
+    {
+      Lock lock(mutex);
+      snprintf(suffix, sizeof(suffix), ".%lu.%lu.tmp", (unsigned long) getpid(), ++serial);
+    }
+
+    std::string k=key(source, options, devices[i]);
+    std::string file=path(dir, k);
+    bool ok=writeEntry(file, file+suffix, k, source, descriptors, binaries[i]);
+
+    Lock lock(mutex);
+    if(ok) {
+      stats_.stores++;
+      stats_.bytes_written+=binaries[i].size();
+    }
+    else
+      stats_.errors++;
+  }
+}
+
+size_t ProgramCache::clear()
+{
+  std::string directory=getDirectory();
+  if(directory.empty())
+    return 0;
+
+  std::vector<std::string> files;
+#ifdef _WIN32
+  WIN32_FIND_DATAA data;
+  HANDLE h=FindFirstFileA((directory+"\\*.bin").c_str(), &data);
+  if(h!=INVALID_HANDLE_VALUE) {
+    do {
+      files.push_back(directory+SEPARATOR+data.cFileName);
+    } while(FindNextFileA(h, &data));
+    FindClose(h);
+  }
+#else
+  DIR *dir=opendir(directory.c_str());
+  if(dir) {
+    struct dirent *entry;
+    while((entry=readdir(dir))!=NULL) {
+      size_t len=strlen(entry->d_name);
+      if(len>4 && !strcmp(entry->d_name+len-4, ".bin"))
+        files.push_back(directory+SEPARATOR+entry->d_name);
+    }
+    closedir(dir);
+  }
+#endif
+
+  size_t removed=0;
+  for(size_t i=0;i<files.size();i++)
+    if(remove(files[i].c_str())==0)
+      removed++;
+  return removed;
+}
+
+cl_int ProgramCache::getBinaries(cl_program program, std::vector<cl_device_id> &devices,
+                                 std::vector<std::vector<unsigned char> > &binaries)
+{
+  cl_uint num_devices=0;
+  cl_int ret=::clGetProgramInfo(program, CL_PROGRAM_NUM_DEVICES, sizeof(cl_uint), &num_devices, NULL);
+  if(ret!=CL_SUCCESS)
+    return ret;
+  devices.resize(num_devices);
+  binaries.resize(num_devices);
+  if(num_devices==0)
+    return CL_SUCCESS;
+
+  std::vector<size_t> sizes(num_devices);
+  ret=::clGetProgramInfo(program, CL_PROGRAM_DEVICES, sizeof(cl_device_id)*num_devices, &devices.front(), NULL);
+  if(ret==CL_SUCCESS)
+    ret=::clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t)*num_devices, &sizes.front(), NULL);
+  if(ret!=CL_SUCCESS)
+    return ret;
+
+  // devices without a binary get a NULL pointer, which the driver skips
+  std::vector<unsigned char*> pointers(num_devices);
+  for(cl_uint i=0;i<num_devices;i++) {
+    binaries[i].resize(sizes[i]);
+    pointers[i] = sizes[i] ? &binaries[i].front() : NULL;
+  }
+  return ::clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char*)*num_devices,
+                            &pointers.front(), NULL);
+}
+
+NAN_METHOD(ProgramCache::setCacheDirectory)
+{
+  NanScope();
+  if(args[0]->IsString()) {
+    String::Utf8Value dir(args[0]);
+    setDirectory(*dir);
+  }
+  else
+    setDirectory("");
+  NanReturnUndefined();
+}
+
+NAN_METHOD(ProgramCache::getCacheStats)
+{
+  NanScope();
+
+  Stats stats_=stats();
+  Local<Object> obj = NanNew<Object>();
+  obj->Set(JS_STR("directory"), JS_STR(getDirectory().c_str()));
+  obj->Set(JS_STR("hits"), JS_NUM(stats_.hits));
+  obj->Set(JS_STR("misses"), JS_NUM(stats_.misses));
+  obj->Set(JS_STR("stores"), JS_NUM(stats_.stores));
+  obj->Set(JS_STR("errors"), JS_NUM(stats_.errors));
+  obj->Set(JS_STR("bytesRead"), JS_NUM(stats_.bytes_read));
+  obj->Set(JS_STR("bytesWritten"), JS_NUM(stats_.bytes_written));
+
+  NanReturnValue(obj);
+}
+
+NAN_METHOD(ProgramCache::invalidateCache)
+{
+  NanScope();
+  NanReturnValue(JS_NUM(clear()));
+}
+
+} // namespace
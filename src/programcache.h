@@ -0,0 +1,129 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PROGRAMCACHE_H_
+#define PROGRAMCACHE_H_
+
+#include "common.h"
+#include <vector>
+
+namespace webcl {
+
+// On-disk cache of program binaries. Entries are stored per device, keyed
+// by a hash of the program source, the build options, the device name and
+// version, the driver version and the platform version, so a driver update
+// never loads a stale binary. The file name is only a hash: each entry
+// also holds its full key and the full source, which are compared on load.
+//
+// Headers pulled in with #include are not part of the key, so programs
+// that include files or are built with -I options are never cached.
+//
+// Entries also keep the kernel argument descriptors of the source build,
+// as drivers rarely report them for programs created from binaries.
+//
+// The cache is off unless a directory is given, either in
+// $WEBCL_PROGRAM_CACHE or with setDirectory().
+//
+// load(), store(), reject() and clear() may be called from worker threads.
+// The lock only covers the statistics and the directory setting: entries
+// are written to a temporary file and renamed, so readers and concurrent
+// writers never see partial files.
+class ProgramCache
+{
+
+public:
+  static void Init();
+
+  struct Stats {
+    double hits, misses, stores, errors;
+    double bytes_read, bytes_written;
+  };
+
+  static void setDirectory(const std::string &dir);
+  static std::string getDirectory();
+  static bool enabled() { return !getDirectory().empty(); }
+
+  // Program created from the cached binaries of source built with options
+  // for devices, NULL unless all of them are cached. The program still has
+  // to be built. descriptors receives the argument descriptors stored with
+  // the binaries, see findArgs().
+  static cl_program load(cl_context context, const std::string &source, const std::string &options,
+                         const std::vector<cl_device_id> &devices, std::string &descriptors);
+
+  // saves the binaries of a program built from source with options
+  static void store(cl_program program, const std::string &source, const std::string &options);
+
+  // counts a cached binary the driver refused to build
+  static void reject();
+
+  // removes all entries, returns how many were removed
+  static size_t clear();
+
+  static Stats stats();
+
+  // kernel argument as reported by clGetKernelArgInfo()
+  struct ArgDesc {
+    cl_kernel_arg_address_qualifier address;
+    std::string type_name;
+    std::string name;
+  };
+
+  // arguments of kernel as reported by the driver, false if it has no
+  // argument info
+  static bool queryArgs(cl_kernel kernel, std::vector<ArgDesc> &args);
+
+  // arguments of the kernel named name in descriptors returned by load(),
+  // false if they are not there
+  static bool findArgs(const std::string &descriptors, const std::string &name, std::vector<ArgDesc> &args);
+
+  // hex digest of data, as used in cache keys
+  static std::string digest(const std::string &data);
+
+  // creates dir and its missing parents
+  static void makeDirectories(const std::string &dir);
+
+  // devices and binaries of a built program, in the same order
+  static cl_int getBinaries(cl_program program, std::vector<cl_device_id> &devices,
+                            std::vector<std::vector<unsigned char> > &binaries);
+
+  static NAN_METHOD(setCacheDirectory);
+  static NAN_METHOD(getCacheStats);
+  static NAN_METHOD(invalidateCache);
+
+private:
+  static std::string key(const std::string &source, const std::string &options, cl_device_id device);
+  static std::string path(const std::string &dir, const std::string &key);
+
+  static uv_mutex_t mutex;
+  static std::string directory;
+  static bool initialized;
+  static unsigned long serial; // of temporary entry files
+  static Stats stats_;
+};
+
+} // namespace
+
+#endif
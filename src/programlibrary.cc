@@ -0,0 +1,241 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "programlibrary.h"
+#include "program.h"
+#include "programcache.h"
+
+#include <cstdio>
+#include <vector>
+
+using namespace v8;
+
+namespace webcl {
+
+ProgramLibrary::ProgramLibrary(cl_context ctx) : context(ctx), max_bytes(DEFAULT_BUDGET)
+{
+  Stats s={ 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+  stats_=s;
+}
+
+ProgramLibrary::~ProgramLibrary()
+{
+  close();
+}
+
+std::string ProgramLibrary::key(const std::string &source, const std::string &options)
+{
+  char size[32];
+  snprintf(size, sizeof(size), "%lu", (unsigned long) source.size());
+  return ProgramCache::digest(source)+" "+size+" "+options;
+}
+
+// source and binaries held for program
+static size_t programBytes(cl_program program, size_t source_size)
+{
+  size_t bytes=source_size;
+  cl_uint num_devices=0;
+  ::clGetProgramInfo(program, CL_PROGRAM_NUM_DEVICES, sizeof(cl_uint), &num_devices, NULL);
+  if(num_devices>0) {
+    std::vector<size_t> sizes(num_devices);
+    if(::clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t)*num_devices, &sizes.front(), NULL)==CL_SUCCESS) {
+      for(cl_uint i=0;i<num_devices;i++)
+        bytes+=sizes[i];
+    }
+  }
+  return bytes;
+}
+
+Program *ProgramLibrary::acquire(const std::string &source, const std::string &options, cl_int *ret)
+{
+  std::string k=key(source, options);
+  std::map<std::string, Entry*>::iterator it=entries.find(k);
+
+  // the source is compared too, a digest collision builds a program of its own
+  bool shared = it==entries.end() || it->second->program->getSource()==source;
+  if(it!=entries.end() && shared) {
+    Entry *entry=it->second;
+    if(entry->refs++ == 0) {
+      if(entry->lru!=idle.end()) {
+        idle.erase(entry->lru);
+        entry->lru=idle.end();
+      }
+      stats_.programs_in_use++;
+    }
+    stats_.hits++;
+    *ret=CL_SUCCESS;
+    return entry->program;
+  }
+  stats_.misses++;
+
+  size_t lengths[]={ source.size() };
+  const char *strings[]={ source.data() };
+  cl_program pw=::clCreateProgramWithSource(context, 1, strings, lengths, ret);
+  if(*ret!=CL_SUCCESS)
+    return NULL;
+
+  Program *program=Program::New(pw);
+  program->setSource(source);
+  *ret=program->buildProgram(0, NULL, options.empty() ? NULL : options.c_str(), NULL);
+  if(*ret!=CL_SUCCESS) {
+    DESTROY_WEBCL_OBJECT(program);
+    return NULL;
+  }
+  if(!shared)
+    return program;
+
+  insert(k, program, 1, false);
+  return program;
+}
+
+bool ProgramLibrary::add(Program *program, bool pinned)
+{
+  if(program->getLibrary() || program->getSource().empty())
+    return false;
+
+  // only programs of this context built for all of its devices
+  cl_context ctx=NULL;
+  ::clGetProgramInfo(program->getProgram(), CL_PROGRAM_CONTEXT, sizeof(cl_context), &ctx, NULL);
+  if(ctx!=context)
+    return false;
+  cl_uint num_devices=0, num_context_devices=0;
+  ::clGetProgramInfo(program->getProgram(), CL_PROGRAM_NUM_DEVICES, sizeof(cl_uint), &num_devices, NULL);
+  ::clGetContextInfo(context, CL_CONTEXT_NUM_DEVICES, sizeof(cl_uint), &num_context_devices, NULL);
+  if(num_devices==0 || num_devices!=num_context_devices)
+    return false;
+  std::vector<cl_device_id> devices(num_devices);
+  ::clGetProgramInfo(program->getProgram(), CL_PROGRAM_DEVICES, sizeof(cl_device_id)*num_devices, &devices.front(), NULL);
+  for(cl_uint i=0;i<num_devices;i++) {
+    cl_build_status status=CL_BUILD_NONE;
+    ::clGetProgramBuildInfo(program->getProgram(), devices[i], CL_PROGRAM_BUILD_STATUS, sizeof(cl_build_status), &status, NULL);
+    if(status!=CL_BUILD_SUCCESS)
+      return false;
+  }
+
+  std::string k=key(program->getSource(), program->getBuildOptions());
+  if(entries.find(k)!=entries.end())
+    return false;
+
+  insert(k, program, 0, pinned);
+  return true;
+}
+
+void ProgramLibrary::insert(const std::string &k, Program *program, unsigned int refs, bool pinned)
+{
+  Entry *entry=new Entry();
+  entry->key=k;
+  entry->program=program;
+  entry->bytes=programBytes(program->getProgram(), program->getSource().size());
+  entry->refs=refs;
+  entry->pinned=pinned;
+  entry->lru = (refs || pinned) ? idle.end() : idle.insert(idle.begin(), entry);
+  NanAssignPersistent(entry->handle, NanObjectWrapHandle(program));
+  program->setLibrary(this);
+
+  entries[k]=entry;
+  programs[program]=entry;
+  stats_.programs++;
+  if(refs)
+    stats_.programs_in_use++;
+  if(pinned)
+    stats_.programs_pinned++;
+  stats_.bytes+=entry->bytes;
+
+  evict();
+}
+
+void ProgramLibrary::release(Program *program)
+{
+  std::map<Program*, Entry*>::iterator it=programs.find(program);
+  if(it==programs.end())
+    return;
+
+  Entry *entry=it->second;
+  if(entry->refs==0)
+    return;
+  if(--entry->refs == 0) {
+    stats_.programs_in_use--;
+    if(!entry->pinned) {
+      entry->lru=idle.insert(idle.begin(), entry);
+      evict();
+    }
+  }
+}
+
+void ProgramLibrary::setBudget(size_t bytes)
+{
+  max_bytes=bytes;
+  evict();
+}
+
+void ProgramLibrary::countKernel(bool reused)
+{
+  if(reused)
+    stats_.kernel_hits++;
+  else
+    stats_.kernel_misses++;
+}
+
+void ProgramLibrary::evict()
+{
+  // programs in use or pinned are never evicted, the budget may be
+  // exceeded by them
+  while(stats_.bytes>max_bytes && !idle.empty()) {
+    Entry *entry=idle.back();
+    idle.pop_back();
+    stats_.evictions++;
+    destroy(entry);
+  }
+}
+
+void ProgramLibrary::destroy(Entry *entry)
+{
+  entries.erase(entry->key);
+  programs.erase(entry->program);
+  stats_.programs--;
+  if(entry->pinned)
+    stats_.programs_pinned--;
+  stats_.bytes-=entry->bytes;
+
+  Program *program=entry->program;
+  program->setLibrary(NULL);
+  if(entry->refs==0) {
+    DESTROY_WEBCL_OBJECT(program);
+  }
+  else
+    stats_.programs_in_use--;
+  NanDisposePersistent(entry->handle);
+  delete entry;
+}
+
+void ProgramLibrary::close()
+{
+  idle.clear();
+  while(!entries.empty())
+    destroy(entries.begin()->second);
+}
+
+} // namespace
@@ -0,0 +1,113 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PROGRAMLIBRARY_H_
+#define PROGRAMLIBRARY_H_
+
+#include "common.h"
+#include <list>
+#include <map>
+#include <string>
+
+namespace webcl {
+
+class Program;
+
+// Built programs of a context, shared by every caller asking for the same
+// source and build options. Entries are keyed by a hash of the source and
+// the options and counted: each acquire() is matched by one release().
+// Programs nobody holds stay built for the next caller until the bytes held
+// by the library exceed its budget, least recently used first. Pinned
+// programs are never evicted.
+class ProgramLibrary
+{
+
+public:
+  static const size_t DEFAULT_BUDGET = 64*1024*1024;
+
+  struct Stats {
+    double hits, misses, evictions;
+    double kernel_hits, kernel_misses;
+    size_t programs, programs_in_use, programs_pinned, bytes;
+  };
+
+  ProgramLibrary(cl_context context);
+  ~ProgramLibrary();
+
+  // built program for source and options, NULL with *ret set if the build
+  // failed
+  Program *acquire(const std::string &source, const std::string &options, cl_int *ret);
+
+  // hands back a program from acquire()
+  void release(Program *program);
+
+  // shares a program built from source elsewhere (e.g. asynchronously) with
+  // later acquire() calls for its source and options. The library takes
+  // over the program; false if it isn't built for all devices of the
+  // context or an entry for its source and options already exists. Pinned
+  // programs stay built until the library is closed, whatever its budget.
+  bool add(Program *program, bool pinned);
+
+  // bytes of source and binaries kept, in use or not
+  void setBudget(size_t max_bytes);
+
+  // counts a kernel handed out by a library program's pool
+  void countKernel(bool reused);
+
+  // releases idle programs and detaches the others, which become ordinary
+  // programs released by their last holder
+  void close();
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  struct Entry {
+    std::string key;
+    Program *program;
+    v8::Persistent<v8::Object> handle;
+    size_t bytes;
+    unsigned int refs;
+    bool pinned;
+    std::list<Entry*>::iterator lru; // idle.end() unless in idle
+  };
+
+  void insert(const std::string &key, Program *program, unsigned int refs, bool pinned);
+  void evict();
+  void destroy(Entry *entry);
+
+  static std::string key(const std::string &source, const std::string &options);
+
+  cl_context context;
+  size_t max_bytes;
+  std::map<std::string, Entry*> entries;
+  std::map<Program*, Entry*> programs;
+  std::list<Entry*> idle; // most recently released first
+  Stats stats_;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,233 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "range.h"
+#include <cmath>
+
+using namespace node;
+using namespace v8;
+
+namespace webcl {
+
+// false unless value is a finite non-negative integer that fits a size_t
+static bool toSize(double value, size_t *size)
+{
+  if(!(value>=0 && value<=9007199254740992.0) || value!=floor(value) ||
+     value>(double) ((size_t) -1))
+    return false;
+  *size=(size_t) value;
+  return true;
+}
+
+/********************************************
+ *
+ * Range
+ *
+ ********************************************/
+Persistent<FunctionTemplate> Range::constructor_template;
+
+void Range::Init(Handle<Object> target)
+{
+  NanScope();
+
+  // constructor
+  Local<FunctionTemplate> ctor = NanNew<FunctionTemplate>(Range::New);
+  NanAssignPersistent(constructor_template, ctor);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(JS_STR("WebCLRange"));
+
+  // prototype
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_set", set);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_get", get);
+  NODE_SET_PROTOTYPE_METHOD(ctor, "_release", release);
+
+  Local<ObjectTemplate> proto = ctor->PrototypeTemplate();
+  proto->SetAccessor(JS_STR("length"), GetLength, NULL);
+
+  target->Set(JS_STR("WebCLRange"), ctor->GetFunction());
+}
+
+Range::Range(Handle<Object> wrapper) : length(0)
+{
+  dims[0]=dims[1]=dims[2]=0;
+}
+
+void Range::Destructor()
+{
+  length=0;
+}
+
+bool Range::HasInstance(Handle<Value> value)
+{
+  return NanNew(constructor_template)->HasInstance(value);
+}
+
+bool Range::assign(int argc, Handle<Value> *argv)
+{
+  if(argc==1 && !argv[0]->IsNumber()) {
+    NDRangeArg arg;
+    if(!arg.set(argv[0]) || arg.size()==0)
+      return false;
+    length=arg.size();
+    for(cl_uint i=0;i<length;i++)
+      dims[i]=arg.data()[i];
+    return true;
+  }
+
+  if(argc<1 || argc>3)
+    return false;
+  for(int i=0;i<argc;i++) {
+    if(!argv[i]->IsNumber() || !toSize(argv[i]->NumberValue(), &dims[i]))
+      return false;
+  }
+  length=argc;
+  return true;
+}
+
+NAN_METHOD(Range::set)
+{
+  NanScope();
+  Range *range = ObjectWrap::Unwrap<Range>(args.This());
+
+  Handle<Value> argv[3] = { args[0], args[1], args[2] };
+  if(!range->assign(args.Length(), argv))
+    return NanThrowTypeError("Expected 1 to 3 work sizes");
+
+  NanReturnValue(args.This());
+}
+
+NAN_METHOD(Range::get)
+{
+  NanScope();
+  Range *range = ObjectWrap::Unwrap<Range>(args.This());
+
+  cl_uint i=args[0]->Uint32Value();
+  if(i>=range->length)
+    return NanThrowError("INVALID_VALUE");
+
+  NanReturnValue(JS_NUM((double) range->dims[i]));
+}
+
+NAN_METHOD(Range::release)
+{
+  NanScope();
+  Range *range = ObjectWrap::Unwrap<Range>(args.This());
+
+  DESTROY_WEBCL_OBJECT(range);
+
+  NanReturnUndefined();
+}
+
+NAN_GETTER(Range::GetLength)
+{
+  NanScope();
+  Range *range = ObjectWrap::Unwrap<Range>(args.This());
+  NanReturnValue(JS_INT(range->length));
+}
+
+NAN_METHOD(Range::New)
+{
+  if (!args.IsConstructCall())
+    return NanThrowTypeError("Constructor cannot be called as a function.");
+
+  NanScope();
+  Range *range = new Range(args.This());
+  range->Wrap(args.This());
+  registerCLObj(range);
+
+  if(args.Length()>0) {
+    Handle<Value> argv[3] = { args[0], args[1], args[2] };
+    if(!range->assign(args.Length(), argv))
+      return NanThrowTypeError("Expected 1 to 3 work sizes");
+  }
+
+  NanReturnValue(args.This());
+}
+
+/********************************************
+ *
+ * NDRangeArg
+ *
+ ********************************************/
+bool NDRangeArg::set(Handle<Value> arg)
+{
+  num_dims=0;
+
+  if(arg->IsUndefined() || arg->IsNull())
+    return true;
+
+  if(arg->IsArray()) {
+    Local<Array> arr = Local<Array>::Cast(arg);
+    cl_uint n=arr->Length();
+    if(n>3)
+      return false;
+    for(cl_uint i=0;i<n;i++) {
+      Local<Value> value=arr->Get(i);
+      if(!value->IsNumber() || !toSize(value->NumberValue(), &dims[i]))
+        return false;
+    }
+    num_dims=n;
+    return true;
+  }
+
+  if(!arg->IsObject())
+    return false;
+  Local<Object> obj = Local<Object>::Cast(arg);
+
+  if(obj->HasIndexedPropertiesInExternalArrayData()) {
+    int n=obj->GetIndexedPropertiesExternalArrayDataLength();
+    if(n>3)
+      return false;
+    void *data=obj->GetIndexedPropertiesExternalArrayData();
+    switch(obj->GetIndexedPropertiesExternalArrayDataType()) {
+    case kExternalUnsignedIntArray:
+      for(int i=0;i<n;i++)
+        dims[i]=((const uint32_t*) data)[i];
+      break;
+    case kExternalDoubleArray:
+      for(int i=0;i<n;i++)
+        if(!toSize(((const double*) data)[i], &dims[i]))
+          return false;
+      break;
+    default:
+      return false;
+    }
+    num_dims=n;
+    return true;
+  }
+
+  if(Range::HasInstance(arg)) {
+    Range *range=ObjectWrap::Unwrap<Range>(obj);
+    num_dims=range->size();
+    for(cl_uint i=0;i<num_dims;i++)
+      dims[i]=range->data()[i];
+    return true;
+  }
+
+  return false;
+}
+
+} // namespace
@@ -0,0 +1,94 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef RANGE_H_
+#define RANGE_H_
+
+#include "common.h"
+
+namespace webcl {
+
+// Reusable work size for enqueueNDRangeKernel. Holds up to 3 dimensions
+// natively so a launch does not have to read them from a JS array.
+class Range : public WebCLObject
+{
+
+public:
+  void Destructor();
+
+  static void Init(v8::Handle<v8::Object> target);
+
+  static NAN_METHOD(New);
+  static NAN_METHOD(set);
+  static NAN_METHOD(get);
+  static NAN_METHOD(release);
+
+  static NAN_GETTER(GetLength);
+
+  static bool HasInstance(v8::Handle<v8::Value> value);
+
+  cl_uint size() const { return length; }
+  const size_t *data() const { return dims; }
+
+private:
+  Range(v8::Handle<v8::Object> wrapper);
+
+  // (x [,y [,z]]) or a single array argument, returns false if invalid
+  bool assign(int argc, v8::Handle<v8::Value> *argv);
+
+  static v8::Persistent<v8::FunctionTemplate> constructor_template;
+
+  size_t dims[3];
+  cl_uint length;
+};
+
+// Offsets, global or local sizes argument of an NDRange launch, given as an
+// array, a Uint32Array, a Float64Array or a WebCLRange. Values are copied
+// into fixed storage; typed arrays are read from their backing store.
+class NDRangeArg
+{
+
+public:
+  NDRangeArg() : num_dims(0) {}
+
+  // returns false if arg is not undefined, null or one of the types above
+  // with at most 3 elements, or if a value is negative, fractional or not
+  // finite
+  bool set(v8::Handle<v8::Value> arg);
+
+  cl_uint size() const { return num_dims; }
+
+  // NULL when no value or an empty one was given
+  const size_t *data() const { return num_dims ? dims : NULL; }
+
+private:
+  size_t dims[3];
+  cl_uint num_dims;
+};
+
+} // namespace
+
+#endif
@@ -52,6 +52,11 @@ void Sampler::Init(Handle<Object> target)
   target->Set(NanNew("WebCLSampler"), ctor->GetFunction());
 }
 
+bool Sampler::HasInstance(Handle<Value> value)
+{
+  return NanNew(constructor_template)->HasInstance(value);
+}
+
 Sampler::Sampler(Handle<Object> wrapper) : sampler(0)
 {
   _type=CLObjType::Sampler;
@@ -147,6 +152,7 @@ Sampler *Sampler::New(cl_sampler sw)
 
   Sampler *sampler = ObjectWrap::Unwrap<Sampler>(obj);
   sampler->sampler = sw;
+  mapCLObj(sampler, sw);
 
   return sampler;
 }
@@ -45,7 +45,8 @@ public:
   static NAN_METHOD(release);
 
   cl_sampler getSampler() const { return sampler; };
-  virtual bool isEqual(void *clObj) { return ((cl_sampler)clObj)==sampler; }
+
+  static bool HasInstance(v8::Handle<v8::Value> value);
 
 private:
   Sampler(v8::Handle<v8::Object> wrapper);
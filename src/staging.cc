@@ -0,0 +1,191 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "staging.h"
+#include "event.h"
+#include <cstring>
+
+namespace webcl {
+
+StagingPool::StagingPool(cl_command_queue queue)
+  : queue(queue), threshold(DEFAULT_THRESHOLD), chunk_size(DEFAULT_CHUNK_SIZE),
+    num_chunks(DEFAULT_NUM_CHUNKS), staged_bytes(0)
+{
+  // devices sharing host memory gain nothing from a copy
+  cl_device_id device=NULL;
+  cl_bool unified=CL_FALSE;
+  ::clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE, sizeof(cl_device_id), &device, NULL);
+  if(device)
+    ::clGetDeviceInfo(device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &unified, NULL);
+  if(unified)
+    threshold=0;
+}
+
+StagingPool::~StagingPool()
+{
+  releaseSlots();
+}
+
+void StagingPool::configure(size_t threshold, size_t chunk_size, cl_uint num_chunks)
+{
+  this->threshold=threshold;
+  if(chunk_size && num_chunks && (chunk_size!=this->chunk_size || num_chunks!=this->num_chunks)) {
+    releaseSlots();
+    this->chunk_size=chunk_size;
+    this->num_chunks=num_chunks;
+  }
+}
+
+cl_int StagingPool::allocate()
+{
+  cl_context context;
+  cl_int ret=::clGetCommandQueueInfo(queue, CL_QUEUE_CONTEXT, sizeof(cl_context), &context, NULL);
+  if(ret!=CL_SUCCESS)
+    return ret;
+
+  for(cl_uint i=0;i<num_chunks;i++) {
+    Slot slot={ NULL, NULL, NULL };
+    slot.mem=::clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, chunk_size, NULL, &ret);
+    if(ret==CL_SUCCESS) {
+      slot.ptr=::clEnqueueMapBuffer(queue, slot.mem, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE,
+                                    0, chunk_size, 0, NULL, NULL, &ret);
+      if(ret!=CL_SUCCESS)
+        ::clReleaseMemObject(slot.mem);
+    }
+    if(ret!=CL_SUCCESS) {
+      releaseSlots();
+      return ret;
+    }
+    slots.push_back(slot);
+  }
+  return CL_SUCCESS;
+}
+
+void StagingPool::releaseSlots()
+{
+  for(size_t i=0;i<slots.size();i++) {
+    wait(slots[i]);
+    ::clEnqueueUnmapMemObject(queue, slots[i].mem, slots[i].ptr, 0, NULL, NULL);
+  }
+  if(!slots.empty())
+    ::clFinish(queue);
+  for(size_t i=0;i<slots.size();i++)
+    ::clReleaseMemObject(slots[i].mem);
+  slots.clear();
+}
+
+cl_int StagingPool::wait(Slot &slot)
+{
+  if(!slot.event)
+    return CL_SUCCESS;
+  cl_int ret=::clWaitForEvents(1, &slot.event);
+  ::clReleaseEvent(slot.event);
+  slot.event=NULL;
+  return ret;
+}
+
+cl_int StagingPool::write(cl_mem mem, size_t offset, size_t size, const void *ptr,
+                          const EventWaitList &wait_list, cl_event *event)
+{
+  cl_int ret=CL_SUCCESS;
+  if(slots.empty() && (ret=allocate())!=CL_SUCCESS)
+    return ret;
+
+  const char *src=(const char*) ptr;
+  size_t done=0;
+  for(size_t i=0; done<size && ret==CL_SUCCESS; i++) {
+    Slot &slot=slots[i % slots.size()];
+    size_t bytes = size-done<chunk_size ? size-done : chunk_size;
+
+    // the slot is free once its previous chunk reached the device
+    if((ret=wait(slot))!=CL_SUCCESS)
+      break;
+    memcpy(slot.ptr, src+done, bytes);
+    ret=::clEnqueueWriteBuffer(queue, mem, CL_FALSE, offset+done, bytes, slot.ptr,
+                               wait_list.size(), wait_list.data(), &slot.event);
+    if(i==0)
+      ::clFlush(queue);
+    done+=bytes;
+  }
+
+  if(ret==CL_SUCCESS && event)
+    ret=::clEnqueueMarker(queue, event);
+  for(size_t i=0;i<slots.size();i++) {
+    cl_int wret=wait(slots[i]);
+    if(ret==CL_SUCCESS) ret=wret;
+  }
+  if(ret==CL_SUCCESS)
+    staged_bytes+=size;
+  return ret;
+}
+
+cl_int StagingPool::read(cl_mem mem, size_t offset, size_t size, void *ptr,
+                         const EventWaitList &wait_list, cl_event *event)
+{
+  cl_int ret=CL_SUCCESS;
+  if(slots.empty() && (ret=allocate())!=CL_SUCCESS)
+    return ret;
+
+  char *dst=(char*) ptr;
+  size_t num=slots.size();
+  size_t count=(size+chunk_size-1)/chunk_size;
+
+  // keep every slot busy: chunk i+num is read while chunk i is copied out
+  for(size_t i=0; i<count && i<num && ret==CL_SUCCESS; i++) {
+    size_t bytes = size-i*chunk_size<chunk_size ? size-i*chunk_size : chunk_size;
+    ret=::clEnqueueReadBuffer(queue, mem, CL_FALSE, offset+i*chunk_size, bytes, slots[i].ptr,
+                              wait_list.size(), wait_list.data(), &slots[i].event);
+  }
+  ::clFlush(queue);
+
+  for(size_t i=0; i<count && ret==CL_SUCCESS; i++) {
+    Slot &slot=slots[i % num];
+    size_t bytes = size-i*chunk_size<chunk_size ? size-i*chunk_size : chunk_size;
+    if((ret=wait(slot))!=CL_SUCCESS)
+      break;
+    memcpy(dst+i*chunk_size, slot.ptr, bytes);
+
+    size_t next=i+num;
+    if(next<count) {
+      size_t next_bytes = size-next*chunk_size<chunk_size ? size-next*chunk_size : chunk_size;
+      ret=::clEnqueueReadBuffer(queue, mem, CL_FALSE, offset+next*chunk_size, next_bytes, slot.ptr,
+                                wait_list.size(), wait_list.data(), &slot.event);
+      ::clFlush(queue);
+    }
+  }
+
+  if(ret==CL_SUCCESS && event)
+    ret=::clEnqueueMarker(queue, event);
+  for(size_t i=0;i<num;i++) {
+    cl_int wret=wait(slots[i]);
+    if(ret==CL_SUCCESS) ret=wret;
+  }
+  if(ret==CL_SUCCESS)
+    staged_bytes+=size;
+  return ret;
+}
+
+} // namespace
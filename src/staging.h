@@ -0,0 +1,92 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef STAGING_H_
+#define STAGING_H_
+
+#include "common.h"
+#include <vector>
+
+namespace webcl {
+
+class EventWaitList;
+
+// Pinned staging buffers of a command queue. Transfers from ordinary
+// (pageable) host memory are copied through a ring of CL_MEM_ALLOC_HOST_PTR
+// buffers that stay mapped for the lifetime of the queue, so the device
+// always transfers from pinned memory. Chunks are pipelined: the host copy
+// of one chunk overlaps the device transfer of the previous ones.
+class StagingPool
+{
+
+public:
+  static const size_t DEFAULT_THRESHOLD = 4 << 20;
+  static const size_t DEFAULT_CHUNK_SIZE = 2 << 20;
+  static const cl_uint DEFAULT_NUM_CHUNKS = 4;
+
+  StagingPool(cl_command_queue queue);
+  ~StagingPool();
+
+  // transfers of at least threshold bytes should be staged, 0 disables
+  // staging. A chunk size or count of 0 is left unchanged; changing them
+  // frees the current buffers.
+  void configure(size_t threshold, size_t chunk_size, cl_uint num_chunks);
+
+  bool useFor(size_t size) const { return threshold>0 && size>=threshold; }
+  size_t getThreshold() const { return threshold; }
+
+  // Transfers through the staging buffers. If event is not NULL it receives
+  // a marker completing with the transfer. Both are blocking: chunks past
+  // the number of buffers wait for earlier ones on the calling thread, so
+  // non-blocking and callback transfers must not be staged.
+  cl_int write(cl_mem mem, size_t offset, size_t size, const void *ptr,
+               const EventWaitList &wait_list, cl_event *event);
+  cl_int read(cl_mem mem, size_t offset, size_t size, void *ptr,
+              const EventWaitList &wait_list, cl_event *event);
+
+  double stagedBytes() const { return staged_bytes; }
+
+private:
+  struct Slot {
+    cl_mem mem;
+    void *ptr;
+    cl_event event;   // last transfer using ptr, NULL if none pending
+  };
+
+  cl_int allocate();
+  void releaseSlots();
+  cl_int wait(Slot &slot);
+
+  cl_command_queue queue;
+  size_t threshold, chunk_size;
+  cl_uint num_chunks;
+  std::vector<Slot> slots;
+  double staged_bytes;
+};
+
+} // namespace
+
+#endif
@@ -30,9 +30,11 @@
 #include "device.h"
 #include "event.h"
 #include "commandqueue.h"
+#include "completion.h"
 
 #include <set>
 #include <vector>
+#include <unordered_map>
 #include <algorithm>
 #include <cstring>
 
@@ -42,44 +44,79 @@ using namespace std;
 
 namespace webcl {
 
-static vector<WebCLObject*> clobjs;
+// live objects, bucketed by type. Each object remembers its slot so removal
+// is a swap with the last element of its bucket.
+static vector<WebCLObject*> clobjs[CLObjType::NumTypes];
+
+// OpenCL handle -> WebCL object(s). The same handle may be wrapped more than
+// once (e.g. a Device returned by different getInfo() calls).
+typedef unordered_multimap<void*, WebCLObject*> CLObjMap;
+static CLObjMap clobjs_by_handle;
+
 static bool atExit=false;
 
+static void unmapCLObj(WebCLObject* obj, void* clObj) {
+  pair<CLObjMap::iterator, CLObjMap::iterator> range = clobjs_by_handle.equal_range(clObj);
+  for(CLObjMap::iterator it = range.first; it != range.second; ++it) {
+    if(it->second == obj) {
+      clobjs_by_handle.erase(it);
+      return;
+    }
+  }
+}
+
 void registerCLObj(WebCLObject* obj) {
-  if(!obj) return;
+  if(!obj || obj->_slot>=0) return;
 
+  vector<WebCLObject*> &bucket=clobjs[obj->getType()];
   #ifdef LOGGING
-  printf("Adding CLObject %p type %d, size %d\n", obj, obj->getType(),clobjs.size()); fflush(stdout);
+  printf("Adding CLObject %p type %d, size %d\n", obj, obj->getType(), (int) bucket.size()); fflush(stdout);
   #endif
-  clobjs.push_back(obj);
+  obj->_slot=(int) bucket.size();
+  bucket.push_back(obj);
+
+  if(obj->_clObj)
+    clobjs_by_handle.insert(make_pair(obj->_clObj, obj));
 }
 
 void unregisterCLObj(WebCLObject* obj) {
-  if(/*atExit ||*/ !obj) return;
+  if(/*atExit ||*/ !obj || obj->_slot<0) return;
 
+  vector<WebCLObject*> &bucket=clobjs[obj->getType()];
   #ifdef LOGGING
-  printf("Removing CLObject %p, size %d\n", obj, clobjs.size()); fflush(stdout);
+  printf("Removing CLObject %p, size %d\n", obj, (int) bucket.size()); fflush(stdout);
   #endif
-  // clobjs.erase(obj);
-  for(vector<WebCLObject*>::iterator it = clobjs.begin();it!=clobjs.end();++it) {
-    if(*it == obj) {
-      clobjs.erase(it);
-      return;
-    }
+  WebCLObject *last=bucket.back();
+  bucket[obj->_slot]=last;
+  last->_slot=obj->_slot;
+  bucket.pop_back();
+  obj->_slot=-1;
+
+  if(obj->_clObj)
+    unmapCLObj(obj, obj->_clObj);
+}
+
+/**
+ * Associates (or re-associates) a WebCL object with its OpenCL object
+ */
+void mapCLObj(WebCLObject* obj, void* clObj) {
+  if(!obj || obj->_clObj==clObj) return;
+
+  if(obj->_slot>=0) {
+    if(obj->_clObj)
+      unmapCLObj(obj, obj->_clObj);
+    if(clObj)
+      clobjs_by_handle.insert(make_pair(clObj, obj));
   }
+  obj->_clObj=clObj;
 }
 
 /**
  * Finds the WebCL objet already associated with an OpenCL object
  */
 WebCLObject* findCLObj(void *clObj) {
-  vector<WebCLObject*>::iterator it = clobjs.begin();
-  while(it != clobjs.end()) {
-    WebCLObject *clo = *it++;
-    if(clo->isEqual(clObj))
-      return clo;
-  }
-  return NULL;
+  CLObjMap::iterator it = clobjs_by_handle.find(clObj);
+  return it != clobjs_by_handle.end() ? it->second : NULL;
 }
 
 void AtExit(void* arg) {
@@ -99,7 +136,6 @@ void AtExit(void* arg) {
 
   // make sure all queues are flushed
   // vector<WebCLObject*>::iterator it;
-  vector<WebCLObject*>::reverse_iterator it;
 
   // must kill events first
   // vector<cl_event> events;
@@ -147,30 +183,46 @@ void AtExit(void* arg) {
 //       ++it;
 //   }
 
+  // release dependent objects before the objects they were created from
+  static const CLObjType::CLObjType order[] = {
+    CLObjType::Event, CLObjType::Kernel, CLObjType::MemoryObject,
+    CLObjType::Sampler, CLObjType::Program, CLObjType::CommandQueue,
+    CLObjType::Context, CLObjType::Device, CLObjType::Platform,
+    CLObjType::Exception, CLObjType::None
+  };
+
   #ifdef LOGGING
-  cout<<"  # objects allocated: "<<clobjs.size()<<endl; fflush(stdout);
+  size_t count=0;
+  for(int t=0;t<CLObjType::NumTypes;t++) count+=clobjs[t].size();
+  cout<<"  # objects allocated: "<<count<<endl; fflush(stdout);
   #endif
-  for(it = clobjs.rbegin(); it != clobjs.rend(); ++it) {
-    WebCLObject *clo = *it;
+  for(size_t t=0; t<sizeof(order)/sizeof(order[0]); t++) {
+    vector<WebCLObject*> &bucket=clobjs[order[t]];
+    vector<WebCLObject*>::reverse_iterator it;
+    for(it = bucket.rbegin(); it != bucket.rend(); ++it) {
+      WebCLObject *clo = *it;
 #ifdef LOGGING
-    cout<<"  [AtExit] Destroying ";
-    if(clo->isCommandQueue())   cout<<"CommandQueue";
-    else if(clo->isKernel())    cout<<"Kernel";
-    else if(clo->isEvent())     cout<<"Event";
-    else if(clo->isProgram())   cout<<"Program";
-    else if(clo->isMemoryObject()) cout<<"MemoryObject";
-    else if(clo->isSampler())   cout<<"Sampler";
-    else if(clo->isContext())   cout<<"Context";
-    else if(clo->isPlatform())  cout<<"Platform";
-    else if(clo->isDevice())    cout<<"Device";
-    else
-      printf("UNKNOWN");
-    printf(" %p\n",clo); fflush(stdout);
+      cout<<"  [AtExit] Destroying ";
+      if(clo->isCommandQueue())   cout<<"CommandQueue";
+      else if(clo->isKernel())    cout<<"Kernel";
+      else if(clo->isEvent())     cout<<"Event";
+      else if(clo->isProgram())   cout<<"Program";
+      else if(clo->isMemoryObject()) cout<<"MemoryObject";
+      else if(clo->isSampler())   cout<<"Sampler";
+      else if(clo->isContext())   cout<<"Context";
+      else if(clo->isPlatform())  cout<<"Platform";
+      else if(clo->isDevice())    cout<<"Device";
+      else
+        printf("UNKNOWN");
+      printf(" %p\n",clo); fflush(stdout);
 #endif
-    clo->Destructor();
+      clo->Destructor();
+      clo->_slot=-1;
+    }
+    bucket.clear();
   }
 
-  clobjs.clear();
+  clobjs_by_handle.clear();
 }
 
 NAN_METHOD(getPlatforms) {
@@ -486,93 +538,19 @@ NAN_METHOD(createContext) {
   NanReturnValue(NanObjectWrapHandle(Context::New(cw)));
 }
 
-class WaitForEventsWorker : public NanAsyncWorker {
- public:
-  WaitForEventsWorker(Baton *baton)
-    : NanAsyncWorker(baton->callback), baton_(baton) {
-    }
-
-  ~WaitForEventsWorker() {
-    if(baton_) {
-      NanScope();
-      if (!baton_->parent.IsEmpty()) NanDisposePersistent(baton_->parent);
-      if (!baton_->data.IsEmpty()) NanDisposePersistent(baton_->data);
-      // if (baton_->callback) delete baton_->callback;
-      delete baton_;
-    }
-  }
-
-  // Executed inside the worker-thread.
-  // It is not safe to access V8, or V8 data structures
-  // here, so everything we need for input and output
-  // should go on `this`.
-  void Execute () {
-    // SetErrorMessage("Error");
-    // printf("[async event] execute\n");
-    Local<Array> eventsArray = Local<Array>::Cast(NanNew(baton_->data));
-    std::vector<cl_event> events;
-    for (uint32_t i=0; i<eventsArray->Length(); i++) {
-     Event *we=ObjectWrap::Unwrap<Event>(eventsArray->Get(i)->ToObject());
-      cl_event e = we->getEvent();
-      events.push_back(e);
-    }
-    cl_int ret = baton_->error = ::clWaitForEvents( (int) events.size(), &events.front());
-    if (ret != CL_SUCCESS) {
-      REQ_ERROR_THROW_NONE(INVALID_VALUE);
-      REQ_ERROR_THROW_NONE(INVALID_CONTEXT);
-      REQ_ERROR_THROW_NONE(INVALID_EVENT);
-      REQ_ERROR_THROW_NONE(EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST);
-      REQ_ERROR_THROW_NONE(OUT_OF_RESOURCES);
-      REQ_ERROR_THROW_NONE(OUT_OF_HOST_MEMORY);
-      return;
-    }
-  }
-
-  // Executed when the async work is complete
-  // this function will be run inside the main event loop
-  // so it is safe to use V8 again
-  void HandleOKCallback () {
-    NanScope();
-
-    // must return passed data
-    Local<Value> argv[] = {
-      JS_INT(baton_->error)
-    };
-
-    // printf("[async event] callback JS\n");
-    callback->Call(1, argv);
-  }
-
-  private:
-    Baton *baton_;
-};
-
 NAN_METHOD(waitForEvents) {
   NanScope();
 
-  if (!args[0]->IsArray())
-    NanThrowError("INVALID_VALUE");
-
-  if(args[1]->IsFunction()) {
-      Baton *baton=new Baton();
-      NanAssignPersistent(baton->data, args[0]);
-      baton->callback=new NanCallback(args[1].As<Function>());
-      NanAsyncQueueWorker(new WaitForEventsWorker(baton));
-      NanReturnUndefined();
-  }
+  EventWaitList wait_list;
+  if(!wait_list.set(args[0]) || wait_list.size()==0)
+    return NanThrowError("INVALID_VALUE");
 
-  Local<Array> eventsArray = Local<Array>::Cast(args[0]);
-  std::vector<cl_event> events;
-  for (uint32_t i=0; i<eventsArray->Length(); i++) {
-    Event *we=ObjectWrap::Unwrap<Event>(eventsArray->Get(i)->ToObject());
-    cl_event e = we->getEvent();
-    events.push_back(e);
-  }
+  cl_int ret;
+  if(args[1]->IsFunction())
+    ret=Completion::watchAll(wait_list.data(), wait_list.size(), args[1].As<Function>());
+  else
+    ret=::clWaitForEvents(wait_list.size(), wait_list.data());
 
-  // printf("Waiting for %d events\n",events.size());
-  // for(int i=0;i<events.size();i++)
-    // printf("   %p\n",events[i]);
-  cl_int ret=::clWaitForEvents( (int) events.size(), &events.front());
   if (ret != CL_SUCCESS) {
     REQ_ERROR_THROW(INVALID_VALUE);
     REQ_ERROR_THROW(INVALID_CONTEXT);
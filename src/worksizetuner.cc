@@ -0,0 +1,587 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "worksizetuner.h"
+#include "program.h"
+#include "programcache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#ifdef _WIN32
+  #include <process.h>
+  #define getpid _getpid
+#else
+  #include <unistd.h>
+#endif
+
+using namespace v8;
+
+namespace webcl {
+
+std::string WorkSizeTuner::file;
+bool WorkSizeTuner::initialized=false;
+bool WorkSizeTuner::loaded=false;
+unsigned long WorkSizeTuner::generation=0;
+unsigned long WorkSizeTuner::serial=0;
+std::map<std::string, WorkSizeTuner::Result> WorkSizeTuner::results;
+std::map<cl_device_id, std::string> WorkSizeTuner::devices;
+WorkSizeTuner::Stats WorkSizeTuner::stats_={ 0, 0, 0 };
+
+static const char HEADER[]="# node-webcl local work sizes\n";
+
+// most local sizes benchmarked per tuning, the largest are kept
+static const size_t MAX_CANDIDATES=32;
+
+// most size classes cached per kernel
+static const size_t MAX_CACHED=8;
+
+#ifdef _WIN32
+static const char SEPARATOR='\\';
+#else
+static const char SEPARATOR='/';
+#endif
+
+// tabs and newlines separate fields in the results file
+static std::string field(const std::string &str)
+{
+  std::string value(str);
+  for(size_t i=0;i<value.size();i++)
+    if(value[i]=='\t' || value[i]=='\n' || value[i]=='\r')
+      value[i]=' ';
+  return value;
+}
+
+static std::string deviceString(cl_device_id device, cl_device_info param)
+{
+  size_t size=0;
+  if(::clGetDeviceInfo(device, param, 0, NULL, &size)!=CL_SUCCESS || size==0)
+    return "";
+  std::vector<char> value(size);
+  ::clGetDeviceInfo(device, param, size, &value.front(), NULL);
+  return std::string(&value.front());
+}
+
+void WorkSizeTuner::setFile(const std::string &f)
+{
+  file=f;
+  initialized=true;
+  loaded=false;
+  results.clear();
+  generation++;
+}
+
+const std::string &WorkSizeTuner::getFile()
+{
+  if(!initialized) {
+    initialized=true;
+    const char *env=getenv("WEBCL_WORKSIZE_FILE");
+    if(env)
+      file=env;
+    else if(!ProgramCache::getDirectory().empty())
+      file=ProgramCache::getDirectory()+SEPARATOR+"worksizes.txt";
+  }
+  return file;
+}
+
+std::string WorkSizeTuner::kernelId(cl_kernel kernel)
+{
+  std::string name;
+  size_t size=0;
+  if(::clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, 0, NULL, &size)==CL_SUCCESS && size>0) {
+    std::vector<char> value(size);
+    ::clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, size, &value.front(), NULL);
+    name=&value.front();
+  }
+
+  cl_program program=NULL;
+  ::clGetKernelInfo(kernel, CL_KERNEL_PROGRAM, sizeof(cl_program), &program, NULL);
+
+  // The program object keeps its source and options, also when it was
+  // built from cached binaries, so ids don't change with the binary cache.
+  // -D constants change the kernel, so the build options are part of it.
+  std::string data;
+  WebCLObject *obj=findCLObj((void*)program);
+  Program *owner = (obj && obj->isProgram()) ? static_cast<Program*>(obj) : NULL;
+  if(owner && !owner->getSource().empty()) {
+    data=owner->getSource()+"\n"+owner->getBuildOptions();
+    return field(name)+" "+ProgramCache::digest(data);
+  }
+
+  // other programs are identified by their source or, if they were created
+  // from binaries, by their binaries
+  size=0;
+  if(::clGetProgramInfo(program, CL_PROGRAM_SOURCE, 0, NULL, &size)==CL_SUCCESS && size>1) {
+    std::vector<char> value(size);
+    ::clGetProgramInfo(program, CL_PROGRAM_SOURCE, size, &value.front(), NULL);
+    data.assign(&value.front(), size-1);
+  }
+  else {
+    std::vector<cl_device_id> program_devices;
+    std::vector<std::vector<unsigned char> > binaries;
+    if(ProgramCache::getBinaries(program, program_devices, binaries)==CL_SUCCESS)
+      for(size_t i=0;i<binaries.size();i++)
+        if(!binaries[i].empty())
+          data.append((const char*) &binaries[i].front(), binaries[i].size());
+  }
+
+  cl_device_id device=NULL;
+  size=0;
+  if(::clGetProgramInfo(program, CL_PROGRAM_DEVICES, sizeof(cl_device_id), &device, NULL)==CL_SUCCESS &&
+     ::clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_OPTIONS, 0, NULL, &size)==CL_SUCCESS && size>1) {
+    std::vector<char> value(size);
+    ::clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_OPTIONS, size, &value.front(), NULL);
+    data+="\n";
+    data+=&value.front();
+  }
+
+  return field(name)+" "+ProgramCache::digest(data);
+}
+
+std::string WorkSizeTuner::deviceId(cl_device_id device)
+{
+  std::map<cl_device_id, std::string>::iterator it=devices.find(device);
+  if(it!=devices.end())
+    return it->second;
+  std::string id=field(deviceString(device, CL_DEVICE_NAME)+" / "+deviceString(device, CL_DRIVER_VERSION));
+  devices[device]=id;
+  return id;
+}
+
+// each global size is rounded up to a power of two, e.g. 1000x600 -> 1024x1024
+void WorkSizeTuner::sizeClass(cl_uint work_dim, const size_t *globals, size_t *size_class)
+{
+  for(cl_uint i=0;i<3;i++) {
+    size_t n=1;
+    while(i<work_dim && n<globals[i] && n<((size_t) -1)/2+1)
+      n*=2;
+    size_class[i]=n;
+  }
+}
+
+std::string WorkSizeTuner::key(const std::string &kernel_id, cl_device_id device,
+                               cl_uint work_dim, const size_t *globals)
+{
+  size_t n[3];
+  sizeClass(work_dim, globals, n);
+  std::string size_class;
+  for(cl_uint i=0;i<work_dim;i++) {
+    char str[32];
+    snprintf(str, sizeof(str), i ? "x%lu" : "%lu", (unsigned long) n[i]);
+    size_class+=str;
+  }
+  return kernel_id+"\t"+deviceId(device)+"\t"+size_class;
+}
+
+bool WorkSizeTuner::hasResults()
+{
+  if(!loaded)
+    load();
+  return !results.empty();
+}
+
+bool WorkSizeTuner::lookup(const std::string &kernel_id, cl_device_id device,
+                           cl_uint work_dim, const size_t *globals, Result &result)
+{
+  if(!hasResults())
+    return false;
+
+  std::map<std::string, Result>::iterator it=results.find(key(kernel_id, device, work_dim, globals));
+  if(it==results.end() || it->second.work_dim!=work_dim) {
+    stats_.misses++;
+    return false;
+  }
+  stats_.hits++;
+  result=it->second;
+  return true;
+}
+
+bool WorkSizeTuner::lookup(Cache &cache, const std::string &kernel_id, cl_device_id device,
+                           cl_uint work_dim, const size_t *globals, Result &result)
+{
+  if(!hasResults())
+    return false;
+
+  size_t size_class[3];
+  sizeClass(work_dim, globals, size_class);
+
+  Cached *c=NULL;
+  for(size_t i=0;i<cache.size() && !c;i++)
+    if(cache[i].device==device && cache[i].work_dim==work_dim &&
+       memcmp(cache[i].size_class, size_class, sizeof(size_class))==0)
+      c=&cache[i];
+
+  if(c && c->generation==generation) {
+    if(!c->found) {
+      stats_.misses++;
+      return false;
+    }
+    stats_.hits++;
+    result=c->result;
+    return true;
+  }
+
+  if(!c) {
+    if(cache.size()>=MAX_CACHED)
+      cache.clear();
+    cache.push_back(Cached());
+    c=&cache.back();
+    c->device=device;
+    c->work_dim=work_dim;
+    memcpy(c->size_class, size_class, sizeof(size_class));
+  }
+  c->generation=generation;
+  c->found=lookup(kernel_id, device, work_dim, globals, c->result);
+  if(c->found)
+    result=c->result;
+  return c->found;
+}
+
+// Lines are "kernel \t device \t size class \t work_dim \t locals \t time",
+// anything else is skipped.
+static void readResults(const std::string &file, std::map<std::string, WorkSizeTuner::Result> &results)
+{
+  FILE *f=fopen(file.c_str(), "r");
+  if(!f)
+    return;
+
+  char line[4096];
+  while(fgets(line, sizeof(line), f)) {
+    if(line[0]=='#')
+      continue;
+    std::vector<char*> fields;
+    char *p=line;
+    fields.push_back(p);
+    while((p=strpbrk(p, "\t\r\n"))!=NULL) {
+      bool tab=(*p=='\t');
+      *p++=0;
+      if(!tab) break;
+      fields.push_back(p);
+    }
+    if(fields.size()!=6)
+      continue;
+
+    WorkSizeTuner::Result r;
+    unsigned long l[3]={ 0, 0, 0 };
+    r.work_dim=(cl_uint) strtoul(fields[3], NULL, 10);
+    if(r.work_dim<1 || r.work_dim>3 || sscanf(fields[4], "%lu %lu %lu", &l[0], &l[1], &l[2])!=3)
+      continue;
+    for(int i=0;i<3;i++)
+      r.locals[i]=l[i];
+    r.time=strtod(fields[5], NULL);
+    results[std::string(fields[0])+"\t"+fields[1]+"\t"+fields[2]]=r;
+  }
+  fclose(f);
+}
+
+void WorkSizeTuner::load()
+{
+  loaded=true;
+  if(!getFile().empty())
+    readResults(getFile(), results);
+  generation++;
+}
+
+// Results of other processes saved since this one loaded the file are
+// kept. The file is replaced with rename() so readers never see a partial
+// one.
+void WorkSizeTuner::save(const std::string &k, const Result &result)
+{
+  if(getFile().empty())
+    return;
+
+  std::map<std::string, Result> saved;
+  readResults(getFile(), saved);
+  saved[k]=result;
+
+  size_t sep=getFile().find_last_of("/\\");
+  if(sep!=std::string::npos && sep>0)
+    ProgramCache::makeDirectories(getFile().substr(0, sep));
+
+  // temporary files are unique per process and write
+  char suffix[64];
+  snprintf(suffix, sizeof(suffix), ".%lu.%lu.tmp", (unsigned long) getpid(), ++serial);
+  std::string tmp=getFile()+suffix;
+  FILE *f=fopen(tmp.c_str(), "w");
+  if(!f)
+    return;
+  bool ok = fputs(HEADER, f)>=0;
+  std::map<std::string, Result>::iterator it;
+  for(it=saved.begin(); ok && it!=saved.end(); ++it) {
+    const Result &r=it->second;
+    ok = fprintf(f, "%s\t%u\t%lu %lu %lu\t%.0f\n", it->first.c_str(), r.work_dim,
+                 (unsigned long) r.locals[0], (unsigned long) r.locals[1], (unsigned long) r.locals[2], r.time)>0;
+  }
+  ok = (fclose(f)==0) && ok;
+
+#ifdef _WIN32
+  if(ok) remove(getFile().c_str());
+#endif
+  if(!ok || rename(tmp.c_str(), getFile().c_str())!=0)
+    remove(tmp.c_str());
+}
+
+void WorkSizeTuner::clear()
+{
+  results.clear();
+  loaded=true;
+  generation++;
+  if(!getFile().empty())
+    remove(getFile().c_str());
+}
+
+static bool largerGroup(const WorkSizeTuner::Result &a, const WorkSizeTuner::Result &b)
+{
+  return a.locals[0]*a.locals[1]*a.locals[2] > b.locals[0]*b.locals[1]*b.locals[2];
+}
+
+// Local sizes are powers of two or power-of-two multiples of the preferred
+// multiple, within the device's work-item sizes and the kernel's work-group
+// size, and must divide the global sizes. Groups whose size is not a
+// multiple of the preferred one are only tried if there are no others.
+// When the kernel's local memory limits how many groups fit on a compute
+// unit, groups too small to fill it are dropped as well. The driver's own
+// choice is always tried last.
+cl_int WorkSizeTuner::candidates(cl_kernel kernel, cl_device_id device, cl_uint work_dim,
+                                 const size_t *globals, std::vector<Result> &list)
+{
+  size_t max_size=0, multiple=1, size=0;
+  cl_ulong kernel_local=0, device_local=0;
+  cl_int ret=::clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &max_size, NULL);
+  if(ret==CL_SUCCESS)
+    ret=::clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(size_t), &multiple, NULL);
+  if(ret==CL_SUCCESS)
+    ret=::clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_LOCAL_MEM_SIZE, sizeof(cl_ulong), &kernel_local, NULL);
+  if(ret==CL_SUCCESS)
+    ret=::clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &device_local, NULL);
+  if(ret==CL_SUCCESS)
+    ret=::clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, 0, NULL, &size);
+  if(ret!=CL_SUCCESS)
+    return ret;
+  std::vector<size_t> max_items(std::max(size/sizeof(size_t), (size_t) 3), 1);
+  ret=::clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, size, &max_items.front(), NULL);
+  if(ret!=CL_SUCCESS)
+    return ret;
+
+  if(kernel_local>device_local)
+    return CL_OUT_OF_RESOURCES;
+  if(multiple==0)
+    multiple=1;
+  size_t min_size=1;
+  if(kernel_local>0 && max_size>device_local/kernel_local)
+    min_size=(size_t) (max_size/(device_local/kernel_local));
+
+  std::vector<size_t> sizes[3];
+  for(cl_uint d=0;d<3;d++) {
+    if(d>=work_dim) {
+      sizes[d].push_back(1);
+      continue;
+    }
+    std::set<size_t> values;
+    size_t limit=std::min(std::min(globals[d], max_items[d]), max_size);
+    for(size_t s=1; s<=limit; s*=2)
+      values.insert(s);
+    for(size_t s=multiple; s<=limit; s*=2)
+      values.insert(s);
+    std::set<size_t>::iterator it;
+    for(it=values.begin(); it!=values.end(); ++it)
+      if(globals[d]%*it==0)
+        sizes[d].push_back(*it);
+  }
+
+  std::vector<Result> all, preferred, filling;
+  for(size_t i=0;i<sizes[0].size();i++)
+    for(size_t j=0;j<sizes[1].size();j++)
+      for(size_t k=0;k<sizes[2].size();k++) {
+        Result r;
+        r.work_dim=work_dim;
+        r.locals[0]=sizes[0][i];
+        r.locals[1]=sizes[1][j];
+        r.locals[2]=sizes[2][k];
+        r.time=0;
+        size_t n=r.locals[0]*r.locals[1]*r.locals[2];
+        if(n>max_size)
+          continue;
+        all.push_back(r);
+        if(n%multiple==0) {
+          preferred.push_back(r);
+          if(n>=min_size)
+            filling.push_back(r);
+        }
+      }
+
+  list = !filling.empty() ? filling : !preferred.empty() ? preferred : all;
+  std::stable_sort(list.begin(), list.end(), largerGroup);
+  if(list.size()>MAX_CANDIDATES)
+    list.resize(MAX_CANDIDATES);
+
+  Result driver;
+  driver.work_dim=work_dim;
+  driver.locals[0]=driver.locals[1]=driver.locals[2]=0;
+  driver.time=0;
+  list.push_back(driver);
+  return CL_SUCCESS;
+}
+
+// Shortest of iterations launches, in ns. Launches the device refuses to
+// run with these locals return their error.
+static cl_int timeLaunches(cl_command_queue queue, cl_kernel kernel, cl_uint work_dim,
+                           const size_t *offsets, const size_t *globals, const size_t *locals,
+                           cl_uint iterations, double &time)
+{
+  // the first launch is not timed, it may include one-time setup
+  cl_int ret=::clEnqueueNDRangeKernel(queue, kernel, work_dim, offsets, globals, locals, 0, NULL, NULL);
+  if(ret==CL_SUCCESS)
+    ret=::clFinish(queue);
+
+  std::vector<cl_event> events;
+  for(cl_uint i=0;i<iterations && ret==CL_SUCCESS;i++) {
+    cl_event event=NULL;
+    ret=::clEnqueueNDRangeKernel(queue, kernel, work_dim, offsets, globals, locals, 0, NULL, &event);
+    if(ret==CL_SUCCESS)
+      events.push_back(event);
+  }
+  if(ret==CL_SUCCESS)
+    ret=::clFinish(queue);
+
+  time=-1;
+  for(size_t i=0;i<events.size();i++) {
+    cl_ulong start=0, end=0;
+    if(ret==CL_SUCCESS)
+      ret=::clGetEventProfilingInfo(events[i], CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+    if(ret==CL_SUCCESS)
+      ret=::clGetEventProfilingInfo(events[i], CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+    if(ret==CL_SUCCESS && (time<0 || end-start<time))
+      time=(double) (end-start);
+    ::clReleaseEvent(events[i]);
+  }
+  return ret;
+}
+
+cl_int WorkSizeTuner::tune(cl_command_queue queue, cl_kernel kernel, const std::string &kernel_id,
+                           cl_uint work_dim, const size_t *offsets, const size_t *globals,
+                           cl_uint iterations, Result &best, std::vector<Result> *tried)
+{
+  cl_device_id device=NULL;
+  cl_context context=NULL;
+  cl_command_queue_properties properties=0;
+  cl_int ret=::clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE, sizeof(cl_device_id), &device, NULL);
+  if(ret==CL_SUCCESS)
+    ret=::clGetCommandQueueInfo(queue, CL_QUEUE_CONTEXT, sizeof(cl_context), &context, NULL);
+  if(ret==CL_SUCCESS)
+    ret=::clGetCommandQueueInfo(queue, CL_QUEUE_PROPERTIES, sizeof(properties), &properties, NULL);
+
+  std::vector<Result> list;
+  if(ret==CL_SUCCESS)
+    ret=candidates(kernel, device, work_dim, globals, list);
+  // commands still queued may use the kernel's arguments
+  if(ret==CL_SUCCESS)
+    ret=::clFinish(queue);
+  if(ret!=CL_SUCCESS)
+    return ret;
+
+  // launches are timed on a profiling queue of the same device
+  cl_command_queue profiling=queue;
+  if(!(properties & CL_QUEUE_PROFILING_ENABLE)) {
+    profiling=::clCreateCommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE, &ret);
+    if(ret!=CL_SUCCESS)
+      return ret;
+  }
+
+  if(iterations==0)
+    iterations=1;
+  best.time=-1;
+  for(size_t i=0;i<list.size() && ret==CL_SUCCESS;i++) {
+    Result &r=list[i];
+    cl_int status=timeLaunches(profiling, kernel, work_dim, offsets, globals,
+                               r.locals[0] ? r.locals : NULL, iterations, r.time);
+    if(status==CL_INVALID_WORK_GROUP_SIZE || status==CL_INVALID_WORK_ITEM_SIZE || status==CL_OUT_OF_RESOURCES)
+      continue;
+    if(status!=CL_SUCCESS) {
+      ret=status;
+      break;
+    }
+    if(tried)
+      tried->push_back(r);
+    if(best.time<0 || r.time<best.time)
+      best=r;
+  }
+
+  if(profiling!=queue)
+    ::clReleaseCommandQueue(profiling);
+  if(ret!=CL_SUCCESS)
+    return ret;
+  if(best.time<0)
+    return CL_INVALID_WORK_GROUP_SIZE;
+
+  std::string k=key(kernel_id, device, work_dim, globals);
+  if(!loaded)
+    load();
+  results[k]=best;
+  generation++;
+  stats_.tuned++;
+  save(k, best);
+  return CL_SUCCESS;
+}
+
+NAN_METHOD(WorkSizeTuner::setTuningFile)
+{
+  NanScope();
+  if(args[0]->IsString()) {
+    String::Utf8Value f(args[0]);
+    setFile(*f);
+  }
+  else
+    setFile("");
+  NanReturnUndefined();
+}
+
+NAN_METHOD(WorkSizeTuner::getTuningStats)
+{
+  NanScope();
+
+  if(!loaded)
+    load();
+  Local<Object> obj = NanNew<Object>();
+  obj->Set(JS_STR("file"), JS_STR(getFile().c_str()));
+  obj->Set(JS_STR("entries"), JS_NUM((double) results.size()));
+  obj->Set(JS_STR("hits"), JS_NUM(stats_.hits));
+  obj->Set(JS_STR("misses"), JS_NUM(stats_.misses));
+  obj->Set(JS_STR("tuned"), JS_NUM(stats_.tuned));
+
+  NanReturnValue(obj);
+}
+
+NAN_METHOD(WorkSizeTuner::clearTuning)
+{
+  NanScope();
+  clear();
+  NanReturnUndefined();
+}
+
+} // namespace
@@ -0,0 +1,121 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef WORKSIZETUNER_H_
+#define WORKSIZETUNER_H_
+
+#include "common.h"
+#include <map>
+#include <vector>
+
+namespace webcl {
+
+// Local work sizes found by benchmarking a kernel, kept per kernel, device
+// and global size class (each global size rounded up to a power of two).
+// Results are saved to a text file so tuning is done once per machine, and
+// enqueueNDRangeKernel() uses them whenever it is called without locals.
+//
+// The file is $WEBCL_WORKSIZE_FILE if set (empty disables persistence),
+// otherwise worksizes.txt in the program cache directory.
+class WorkSizeTuner
+{
+
+public:
+  struct Result {
+    cl_uint work_dim;
+    size_t locals[3]; // locals[0]==0 for the driver's choice
+    double time; // ns per launch
+  };
+
+  struct Stats {
+    double hits, misses, tuned;
+  };
+
+  // Recent lookups of one kernel by device and size class, so launches
+  // without locals don't build a key each time. Entries are refreshed once
+  // the results change.
+  struct Cached {
+    cl_device_id device;
+    cl_uint work_dim;
+    size_t size_class[3];
+    unsigned long generation;
+    bool found;
+    Result result;
+  };
+  typedef std::vector<Cached> Cache;
+
+  static void setFile(const std::string &file);
+  static const std::string &getFile();
+
+  // identifies a kernel across runs: its name, program source and options
+  static std::string kernelId(cl_kernel kernel);
+
+  // true if any kernel was tuned, cheap enough to check on every launch
+  static bool hasResults();
+
+  // tuned locals of kernelId for device and globals, false if none
+  static bool lookup(const std::string &kernel_id, cl_device_id device,
+                     cl_uint work_dim, const size_t *globals, Result &result);
+
+  // same, going through the cache of the kernel first
+  static bool lookup(Cache &cache, const std::string &kernel_id, cl_device_id device,
+                     cl_uint work_dim, const size_t *globals, Result &result);
+
+  // Benchmarks the local sizes allowed for kernel on the device of queue,
+  // with the arguments currently set, and keeps the fastest. Every
+  // candidate tried is added to tried if not NULL.
+  static cl_int tune(cl_command_queue queue, cl_kernel kernel, const std::string &kernel_id,
+                     cl_uint work_dim, const size_t *offsets, const size_t *globals,
+                     cl_uint iterations, Result &best, std::vector<Result> *tried);
+
+  // forgets all results, in memory and on disk
+  static void clear();
+
+  static NAN_METHOD(setTuningFile);
+  static NAN_METHOD(getTuningStats);
+  static NAN_METHOD(clearTuning);
+
+private:
+  static std::string deviceId(cl_device_id device);
+  static void sizeClass(cl_uint work_dim, const size_t *globals, size_t *size_class);
+  static std::string key(const std::string &kernel_id, cl_device_id device,
+                         cl_uint work_dim, const size_t *globals);
+  static cl_int candidates(cl_kernel kernel, cl_device_id device, cl_uint work_dim,
+                           const size_t *globals, std::vector<Result> &list);
+  static void load();
+  static void save(const std::string &key, const Result &result);
+
+  static std::string file;
+  static bool initialized, loaded;
+  static unsigned long generation, serial;
+  static std::map<std::string, Result> results;
+  static std::map<cl_device_id, std::string> devices;
+  static Stats stats_;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,99 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Promise returning enqueues.
+//
+// Runs a write -> kernel -> read pipeline with the enqueue*Async variants,
+// chaining each frame on the previous one without calling finish(), and
+// checks the result of every frame.
+//
+// usage: node async_enqueue.js [frames]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var FRAMES = parseInt(process.argv[2]) || 100;
+var N = 1024;
+
+var ctx=WebCL.createContext({
+  deviceType: WebCL.DEVICE_TYPE_ALL,
+  platform: WebCL.getPlatforms()[0]
+});
+var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+var queue=ctx.createCommandQueue(device, 0);
+
+var source = [
+  "__kernel void scale(__global float *a, float s) {",
+  "  int i = get_global_id(0);",
+  "  a[i] *= s;",
+  "}"
+].join("\n");
+
+var program=ctx.createProgram(source);
+program.build([device]);
+var kernel=program.createKernel("scale");
+
+var size=N*Float32Array.BYTES_PER_ELEMENT;
+var buffer=ctx.createBuffer(WebCL.MEM_READ_WRITE, size);
+kernel.setArg(0, buffer);
+kernel.setArg(1, new Float32Array([2]));
+
+var input=new Float32Array(N), output=new Float32Array(N);
+for(var i=0;i<N;i++) input[i]=i;
+
+function frame(f) {
+  for(var i=0;i<N;i++) output[i]=0;
+  return queue.enqueueWriteBufferAsync(buffer, false, 0, size, input)
+    .then(function () {
+      return queue.enqueueNDRangeKernelAsync(kernel, 1, null, [N], null);
+    })
+    .then(function () {
+      return queue.enqueueReadBufferAsync(buffer, false, 0, size, output);
+    })
+    .then(function () {
+      for(var i=0;i<N;i++) {
+        if(output[i]!==2*i)
+          throw new Error("frame "+f+" FAILED at "+i+": "+output[i]+" != "+(2*i));
+      }
+    });
+}
+
+var t=process.hrtime();
+var pipeline=Promise.resolve();
+for(var f=0;f<FRAMES;f++)
+  pipeline=pipeline.then(frame.bind(null, f));
+
+pipeline.then(function () {
+  var dt=process.hrtime(t);
+  log(FRAMES+" frames: "+((dt[0]*1e3 + dt[1]/1e6)/FRAMES).toFixed(3)+" ms/frame");
+  WebCL.releaseAll();
+}, function (err) {
+  log(err.message);
+  process.exit(1);
+});
@@ -0,0 +1,106 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Non-blocking transfers.
+//
+// Reads back a large buffer with a blocking enqueueReadBuffer and with
+// enqueueReadBufferAsync while a timer measures how late the event loop
+// runs. The async readback should leave the loop responsive.
+//
+// usage: node async_transfer.js [MB]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var MB = parseInt(process.argv[2]) || 128;
+var size = MB*1024*1024;
+var TICK = 1; // ms
+
+var ctx=WebCL.createContext({
+  deviceType: WebCL.DEVICE_TYPE_ALL,
+  platform: WebCL.getPlatforms()[0]
+});
+var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+var queue=ctx.createCommandQueue(device, 0);
+
+var buffer=ctx.createBuffer(WebCL.MEM_READ_WRITE, size);
+var input=new Uint8Array(size);
+for(var i=0;i<size;i+=4096) input[i]=i>>12 & 0xff;
+queue.enqueueWriteBuffer(buffer, true, 0, size, input);
+
+function now() {
+  var t=process.hrtime();
+  return t[0]*1e3 + t[1]/1e6; // ms
+}
+
+// calls done(max loop delay in ms) after transfer(cb) has called cb
+function measure(transfer, done) {
+  var last=now(), max_lag=0;
+  var timer=setInterval(function () {
+    var t=now();
+    max_lag=Math.max(max_lag, t-last-TICK);
+    last=t;
+  }, TICK);
+
+  setTimeout(function () {
+    transfer(function () {
+      setTimeout(function () {
+        clearInterval(timer);
+        done(max_lag);
+      }, 10*TICK);
+    });
+  }, 10*TICK);
+}
+
+function check(name, output) {
+  for(var i=0;i<size;i+=4096) {
+    if(output[i]!==(i>>12 & 0xff)) {
+      log(name+": FAILED at "+i);
+      process.exit(1);
+    }
+  }
+}
+
+var output=new Uint8Array(size);
+measure(function (cb) {
+  queue.enqueueReadBuffer(buffer, true, 0, size, output);
+  cb();
+}, function (lag) {
+  check("blocking", output);
+  log("blocking read of "+MB+" MB: max loop delay "+lag.toFixed(1)+" ms");
+
+  output=new Uint8Array(size);
+  measure(function (cb) {
+    queue.enqueueReadBufferAsync(buffer, true, 0, size, output).then(cb);
+  }, function (lag) {
+    check("async", output);
+    log("async read of "+MB+" MB:    max loop delay "+lag.toFixed(1)+" ms");
+    WebCL.releaseAll();
+  });
+});
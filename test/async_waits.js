@@ -0,0 +1,107 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Asynchronous finish() and waitForEvents().
+//
+// Keeps several queues busy and waits on all of them, and on hundreds of
+// their events, with callbacks, while timing fs calls. The waits do not
+// take threadpool threads, so fs latency should stay low.
+//
+// usage: node async_waits.js [queues] [waits]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+var fs=require('fs');
+
+var QUEUES = parseInt(process.argv[2]) || 8;
+var WAITS = parseInt(process.argv[3]) || 500;
+var N = 1<<20;
+
+var ctx=WebCL.createContext({
+  deviceType: WebCL.DEVICE_TYPE_ALL,
+  platform: WebCL.getPlatforms()[0]
+});
+var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+
+var source = [
+  "__kernel void spin(__global float *a) {",
+  "  int i = get_global_id(0);",
+  "  float x = a[i];",
+  "  for(int k=0; k<256; k++) x = x*0.999f + 1.0f;",
+  "  a[i] = x;",
+  "}"
+].join("\n");
+
+var program=ctx.createProgram(source);
+program.build([device]);
+
+function now() {
+  var t=process.hrtime();
+  return t[0]*1e3 + t[1]/1e6; // ms
+}
+
+var queues=[], events=[];
+for(var q=0;q<QUEUES;q++) {
+  var queue=ctx.createCommandQueue(device, 0);
+  var kernel=program.createKernel("spin");
+  kernel.setArg(0, ctx.createBuffer(WebCL.MEM_READ_WRITE, N*4));
+  for(var k=0;k<WAITS/QUEUES;k++) {
+    var ev=new WebCL.WebCLEvent();
+    queue.enqueueNDRangeKernel(kernel, 1, null, [N], null, null, ev);
+    events.push(ev);
+  }
+  queue.flush();
+  queues.push(queue);
+}
+
+var t0=now(), remaining=QUEUES+events.length;
+function done() {
+  if(--remaining>0) return;
+  log(QUEUES+" finish() and "+events.length+" waitForEvents() done in "+(now()-t0).toFixed(1)+" ms");
+  clearTimeout(timer);
+  WebCL.releaseAll();
+}
+
+for(var q=0;q<QUEUES;q++)
+  queues[q].finish(done);
+for(var i=0;i<events.length;i++)
+  WebCL.waitForEvents([events[i]], done);
+
+// fs calls issued while all the waits are pending
+var fsMax=0, timer;
+(function fsProbe() {
+  var t=now();
+  fs.stat(__filename, function () {
+    fsMax=Math.max(fsMax, now()-t);
+    timer=setTimeout(fsProbe, 1);
+  });
+})();
+process.on('exit', function () {
+  log("max fs.stat latency: "+fsMax.toFixed(1)+" ms");
+});
@@ -42,7 +42,8 @@ var CACHE_CLEAR_SIZE    = (1 << 24);               //16 M
 //enums, project
 var QUICK_MODE=0, RANGE_MODE=1; // test modes
 var DEVICE_TO_HOST=0, HOST_TO_DEVICE=1, DEVICE_TO_DEVICE=2; // memory copy kind
-var PAGEABLE=0, PINNED=1; // memory modes
+var PAGEABLE=0, PINNED=1, STAGED=2; // memory modes, STAGED is pageable memory
+                                      // copied through the queue's pinned staging
 var MAPPED=0, DIRECT=1; // access modes
 
 //First check if the WebCL extension is installed at all 
@@ -96,8 +97,10 @@ var startDevice=0;
 var endDevice=devices.length-1;
 
 var cqCommandQueue=null;
-testBandwidth(start, end, increment, mode, HOST_TO_DEVICE, accMode, memMode, startDevice, endDevice);
-testBandwidth(start, end, increment, mode, DEVICE_TO_HOST, accMode, memMode, startDevice, endDevice);
+[PAGEABLE, STAGED, PINNED].forEach(function(memMode) {
+  testBandwidth(start, end, increment, mode, HOST_TO_DEVICE, accMode, memMode, startDevice, endDevice);
+  testBandwidth(start, end, increment, mode, DEVICE_TO_HOST, accMode, memMode, startDevice, endDevice);
+});
 testBandwidth(start, end, increment, mode, DEVICE_TO_DEVICE, accMode, memMode, startDevice, endDevice);
 
 
@@ -117,16 +120,16 @@ createQueue(device)
 ///////////////////////////////////////////////////////////////////////////////
 function
 testBandwidth(start, end, increment, 
-              mode, kind, printmode, accMode, 
+              mode, kind, accMode, 
               memMode, startDevice, endDevice)
 {
     switch(mode)
     {
     case QUICK_MODE:
-        testBandwidthQuick( DEFAULT_SIZE, kind, printmode, accMode, memMode, startDevice, endDevice);
+        testBandwidthQuick( DEFAULT_SIZE, kind, accMode, memMode, startDevice, endDevice);
         break;
     case RANGE_MODE:
-        testBandwidthRange(start, end, increment, kind, printmode, accMode, memMode, startDevice, endDevice);
+        testBandwidthRange(start, end, increment, kind, accMode, memMode, startDevice, endDevice);
         break;
     //case SHMOO_MODE: 
     //    testBandwidthShmoo(kind, printmode, accMode, memMode, startDevice, endDevice);
@@ -141,10 +144,10 @@ testBandwidth(start, end, increment,
 //Run a quick mode bandwidth test
 //////////////////////////////////////////////////////////////////////
 function
-testBandwidthQuick(size, kind, printmode, accMode, 
+testBandwidthQuick(size, kind, accMode, 
                     memMode, startDevice, endDevice)
 {
- testBandwidthRange(size, size, DEFAULT_INCREMENT, kind, printmode, accMode, memMode, startDevice, endDevice);
+ testBandwidthRange(size, size, DEFAULT_INCREMENT, kind, accMode, memMode, startDevice, endDevice);
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -169,6 +172,9 @@ function testBandwidthRange(start, end, increment,
   {
       // Allocate command queue for the device (dealloc first if already allocated)
       createQueue(d);
+
+      // pageable transfers must not go through the staging buffers
+      cqCommandQueue.setStagingOptions({ threshold: memMode == STAGED ? 1 : 0 });
   
       //run each of the copies
       for(var i = 0; i < count; i++)
@@ -205,7 +211,8 @@ function printResults(memSizes, bandwidths, count, kind, accMode, memMode, iNumD
     str += (kind == DEVICE_TO_HOST) ? "Device -> Host" : "Host -> Device";
     str += " Bandwidth, "+iNumDevs+" Device(s), ";
 
-    str += (memMode == PAGEABLE) ? "Paged memory" : "Pinned memory";
+    str += (memMode == PAGEABLE) ? "Paged memory" :
+           (memMode == STAGED) ? "Paged memory, pinned staging" : "Pinned memory";
     str += (accMode == DIRECT) ? ", direct access\n" : ", mapped access";
   }
 
@@ -269,9 +276,10 @@ function testDeviceToHostTransfer(memSize, accMode, memMode)
   cqCommandQueue.finish();
   var start=new Date();
   if(accMode == DIRECT) { 
-      // DIRECT:  API access to device buffer 
+      // DIRECT:  API access to device buffer. Staged reads are blocking.
+      var blocking = (memMode == STAGED) ? WebCL.TRUE : WebCL.FALSE;
       for(var i = 0; i < MEMCOPY_ITERATIONS; i++) {
-          ciErrNum = cqCommandQueue.enqueueReadBuffer(cmDevData, WebCL.FALSE, 0, memSize, h_data);
+          ciErrNum = cqCommandQueue.enqueueReadBuffer(cmDevData, blocking, 0, memSize, h_data);
       }
       cqCommandQueue.finish();
   } 
@@ -287,7 +295,7 @@ function testDeviceToHostTransfer(memSize, accMode, memMode)
   }
   
   //get the the elapsed time in seconds
-  var elapsedTimeInSec = new Date()-start;
+  var elapsedTimeInSec = (new Date()-start)/1e3;
   
   //calculate bandwidth in MB/s
   bandwidthInMBs = (memSize * MEMCOPY_ITERATIONS) / (elapsedTimeInSec * (1 << 20));
@@ -353,9 +361,10 @@ function testHostToDeviceTransfer(memSize, accMode, memMode) {
       h_data = cqCommandQueue.enqueueMapBuffer(cmPinnedData, WebCL.TRUE, WebCL.MAP_READ, 0, memSize);
     }
   
-    // DIRECT: API access to device buffer
+    // DIRECT: API access to device buffer. Staged writes are blocking.
+    var blocking = (memMode == STAGED) ? WebCL.TRUE : WebCL.FALSE;
     for(var i = 0; i < MEMCOPY_ITERATIONS; i++) {
-      ciErrNum = cqCommandQueue.enqueueWriteBuffer(cmDevData, WebCL.FALSE, 0, memSize, h_data);
+      ciErrNum = cqCommandQueue.enqueueWriteBuffer(cmDevData, blocking, 0, memSize, h_data);
     }
     cqCommandQueue.finish();
   } 
@@ -374,7 +383,7 @@ function testHostToDeviceTransfer(memSize, accMode, memMode) {
   }
   
   // get the the elapsed time in seconds
-  var elapsedTimeInSec = new Date()-start;
+  var elapsedTimeInSec = (new Date()-start)/1e3;
   
   // calculate bandwidth in MB/s
   bandwidthInMBs = (memSize * MEMCOPY_ITERATIONS)/(elapsedTimeInSec * (1 << 20));
@@ -424,7 +433,7 @@ function testDeviceToDeviceTransfer(memSize)
   cqCommandQueue.finish();
 
   //get the the elapsed time in seconds
-  elapsedTimeInSec = new Date()-start;
+  elapsedTimeInSec = (new Date()-start)/1e3;
 
   // Calculate bandwidth in MB/s 
   //      This is for kernels that read and write GMEM simultaneously 
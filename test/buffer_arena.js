@@ -0,0 +1,130 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Sub-buffer arena.
+//
+// Allocates and releases thousands of small buffers of random sizes, once
+// with createBuffer and once as sub-buffers of a WebCLBufferArena, and
+// prints the cost per buffer. The arena is then churned with random frees
+// and allocations and its fragmentation metrics are printed. Last, a
+// buffer held by a command list must keep its block after its release.
+//
+// usage: node buffer_arena.js [buffers] [arena MB]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var COUNT = parseInt(process.argv[2]) || 10000;
+var ARENA = (parseInt(process.argv[3]) || 256)*1024*1024;
+
+var ctx=null;
+try {
+  ctx=WebCL.createContext({
+    deviceType: WebCL.DEVICE_TYPE_ALL,
+    platform: WebCL.getPlatforms()[0]
+  });
+}
+catch(ex) {
+  throw new Error("Can't create CL context");
+}
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e3 + dt[1]/1e6; // ms
+}
+
+// small tensors: 16 bytes to 16KB, same sequence for both runs
+var seed=1;
+function random() {
+  seed=(seed*16807) % 2147483647;
+  return seed/2147483647;
+}
+var sizes=[];
+for(var i=0;i<COUNT;i++)
+  sizes.push(16 << Math.floor(random()*11));
+
+function run(create) {
+  var buffers=new Array(COUNT);
+  var t=process.hrtime();
+  for(var i=0;i<COUNT;i++)
+    buffers[i]=create(sizes[i]);
+  var tCreate=elapsed(t)*1e6/COUNT;
+  t=process.hrtime();
+  for(var i=0;i<COUNT;i++)
+    buffers[i].release();
+  var tRelease=elapsed(t)*1e6/COUNT;
+  return [tCreate, tRelease];
+}
+
+var arena=ctx.createBufferArena(WebCL.MEM_READ_WRITE, ARENA);
+log("arena: "+JSON.stringify(arena.getStats()));
+
+var plain=run(function(size) { return ctx.createBuffer(WebCL.MEM_READ_WRITE, size); });
+var sub=run(function(size) { return arena.allocate(size); });
+
+log("\t\tcreate (ns/op)\trelease (ns/op)");
+log("createBuffer\t"+plain[0].toFixed(1)+"\t\t"+plain[1].toFixed(1));
+log("arena\t\t"+sub[0].toFixed(1)+"\t\t"+sub[1].toFixed(1));
+
+// everything was released, nothing may be left allocated
+var stats=arena.getStats();
+if(stats.bytesAllocated!==0)
+  throw new Error("arena leaks "+stats.bytesAllocated+" bytes");
+
+// churn: keep about half of the buffers alive
+var live=[];
+for(var i=0;i<COUNT*4;i++) {
+  if(live.length && random()<0.5)
+    live.splice(Math.floor(random()*live.length), 1)[0].release();
+  else
+    live.push(arena.allocate(sizes[i % COUNT]));
+}
+stats=arena.getStats();
+log("after churn: "+live.length+" live buffers");
+log("  allocated "+stats.bytesAllocated+" bytes for "+stats.bytesRequested+" requested, "+
+    "internal fragmentation "+(stats.internalFragmentation*100).toFixed(1)+"%");
+log("  largest free block "+stats.largestFreeBlock+" of "+stats.bytesFree+" free bytes, "+
+    "external fragmentation "+(stats.externalFragmentation*100).toFixed(1)+"%");
+
+live.forEach(function(b) { b.release(); });
+
+// a released buffer still held by a recorded command list keeps its block
+var held=arena.allocate(256);
+var offset=held.getInfo(WebCL.MEM_OFFSET);
+var list=ctx.createCommandList();
+list.enqueueWriteBuffer(held, false, 0, 256, new Uint8Array(256));
+held.release();
+var next=arena.allocate(256);
+if(next.getInfo(WebCL.MEM_OFFSET)===offset)
+  throw new Error("the block of a buffer in use should not be handed out again");
+next.release();
+list.release();
+
+arena.release();
+ctx.release();
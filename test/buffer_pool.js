@@ -0,0 +1,116 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Pooled buffer allocation.
+//
+// Allocates and releases buffers of a few recurring sizes, once with
+// createBuffer and once with createPooledBuffer, and prints the cost per
+// allocation with the pool statistics. Then checks that the high-water
+// marks and trimBufferPool() bound the cached bytes, and that a buffer
+// released while mapped is not cached.
+//
+// usage: node buffer_pool.js [iterations]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var ITERATIONS = parseInt(process.argv[2]) || 10000;
+var SIZES = [ 1000, 4096, 65536, 300000, 1<<20 ];
+
+var ctx=null;
+try {
+  ctx=WebCL.createContext({
+    deviceType: WebCL.DEVICE_TYPE_ALL,
+    platform: WebCL.getPlatforms()[0]
+  });
+}
+catch(ex) {
+  throw new Error("Can't create CL context");
+}
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e3 + dt[1]/1e6; // ms
+}
+
+function run(create) {
+  var t=process.hrtime();
+  for(var i=0;i<ITERATIONS;i++) {
+    // a request holds a couple of buffers at a time
+    var a=create(WebCL.MEM_READ_ONLY, SIZES[i % SIZES.length]);
+    var b=create(WebCL.MEM_WRITE_ONLY, SIZES[(i*3) % SIZES.length]);
+    a.release();
+    b.release();
+  }
+  return elapsed(t)*1e6/(2*ITERATIONS);
+}
+
+var tPlain=run(function(flags, size) { return ctx.createBuffer(flags, size); });
+var tPooled=run(function(flags, size) { return ctx.createPooledBuffer(flags, size); });
+
+log("createBuffer:       "+tPlain.toFixed(1)+" ns/buffer");
+log("createPooledBuffer: "+tPooled.toFixed(1)+" ns/buffer ("+(tPlain/tPooled).toFixed(1)+"x)");
+log("pool stats: "+JSON.stringify(ctx.getBufferPoolStats()));
+
+// pooled buffers are rounded up to their size class
+var buffer=ctx.createPooledBuffer(WebCL.MEM_READ_WRITE, 1000);
+if(buffer.getInfo(WebCL.MEM_SIZE)!==1024)
+  throw new Error("expected a 1024 bytes buffer, got "+buffer.getInfo(WebCL.MEM_SIZE));
+buffer.release();
+
+// high-water marks
+ctx.setBufferPoolLimits({ maxBytes: 1<<20, maxBuffersPerClass: 2 });
+var buffers=[];
+for(var i=0;i<8;i++)
+  buffers.push(ctx.createPooledBuffer(WebCL.MEM_READ_WRITE, 65536));
+buffers.forEach(function(b) { b.release(); });
+var stats=ctx.getBufferPoolStats();
+log("after limits: "+JSON.stringify(stats));
+if(stats.bytesCached>1<<20)
+  throw new Error("pool exceeds maxBytes");
+if(stats.buffersInUse!==0)
+  throw new Error("expected no buffer in use");
+
+// a buffer released while still mapped is not cached
+var queue=ctx.createCommandQueue();
+var mapped=ctx.createPooledBuffer(WebCL.MEM_READ_WRITE, 4096);
+queue.enqueueMapBuffer(mapped, true, WebCL.MAP_WRITE, 0, 4096);
+var cached=ctx.getBufferPoolStats().buffersCached;
+mapped.release();
+if(ctx.getBufferPoolStats().buffersCached!==cached)
+  throw new Error("a mapped buffer went back to the pool");
+queue.release();
+
+ctx.trimBufferPool();
+stats=ctx.getBufferPoolStats();
+log("after trim: "+JSON.stringify(stats));
+if(stats.bytesCached!==0 || stats.buffersCached!==0)
+  throw new Error("trimBufferPool() left cached buffers");
+
+ctx.release();
@@ -0,0 +1,116 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Program builds on worker threads.
+//
+// Builds a few distinct programs one after the other with build(), then
+// all at once with buildAsync(), counting how often a 1ms timer fires
+// meanwhile: blocking builds starve the event loop, worker builds don't.
+// Finally builds a broken program and prints its per-device log.
+//
+// usage: node build_async.js [programs]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var PROGRAMS = parseInt(process.argv[2]) || 8;
+
+var ctx=null;
+try {
+  ctx=WebCL.createContext({
+    deviceType: WebCL.DEVICE_TYPE_ALL,
+    platform: WebCL.getPlatforms()[0]
+  });
+}
+catch(ex) {
+  throw new Error("Can't create CL context");
+}
+
+// the binary cache would hide the compiles
+WebCL.setProgramCache(null);
+
+function source(i) {
+  return [
+    "__kernel void k"+i+"(__global float *x, uint n)",
+    "{",
+    "  size_t id = get_global_id(0);",
+    "  float v = x[id];",
+    "  for(uint j=0; j<n; j++) v = sin(v) * "+(i+1)+".0f + cos(v);",
+    "  x[id] = v;",
+    "}"
+  ].join("\n");
+}
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e3 + dt[1]/1e6; // ms
+}
+
+var ticks=0;
+var timer=setInterval(function() { ticks++; }, 1);
+
+var t=process.hrtime();
+for(var i=0;i<PROGRAMS;i++)
+  ctx.createProgram(source(i)).build(null, "-D SYNC");
+var tSync=elapsed(t);
+
+// let the timer catch up before counting again
+setTimeout(function() {
+  ticks=0;
+  t=process.hrtime();
+  var builds=[];
+  for(var i=0;i<PROGRAMS;i++)
+    builds.push(ctx.createProgram(source(i)).buildAsync(null, "-D ASYNC"));
+
+  Promise.all(builds).then(function(results) {
+    var tAsync=elapsed(t);
+    log("build:      "+tSync.toFixed(1)+" ms for "+PROGRAMS+" programs, event loop blocked");
+    log("buildAsync: "+tAsync.toFixed(1)+" ms for "+PROGRAMS+" programs, timer fired "+ticks+" times");
+    results.forEach(function(result) {
+      if(result.status!==WebCL.SUCCESS || result.devices[0].status!==WebCL.BUILD_SUCCESS)
+        throw new Error("build should have succeeded");
+    });
+
+    return ctx.createProgram("__kernel void broken(__global float *x) { x[0] = y; }").buildAsync();
+  }).then(function() {
+    throw new Error("broken program should not build");
+  }, function(err) {
+    log("broken program: "+err.message+" ("+err.code+")");
+    err.build.devices.forEach(function(d) {
+      log("  "+d.device.getInfo(WebCL.DEVICE_NAME)+": status "+d.status+"\n"+d.log);
+    });
+  }).then(function() {
+    clearInterval(timer);
+    ctx.release();
+  }).catch(function(err) {
+    clearInterval(timer);
+    log(err.stack);
+    process.exit(1);
+  });
+}, 10);
@@ -0,0 +1,126 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Captured kernel arguments.
+//
+// Captures two launches of one kernel with different arguments, changes the
+// kernel's arguments after capture, and checks that replay uses the
+// arguments each launch was captured with, while the kernel keeps its own
+// arguments for later launches. Then rebinds the slot of a
+// buffer passed as a kernel argument and checks replay writes the new one.
+//
+// usage: node capture_kernel_args.js
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var N = 256;
+
+var ctx=WebCL.createContext({
+  deviceType: WebCL.DEVICE_TYPE_ALL,
+  platform: WebCL.getPlatforms()[0]
+});
+var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+var queue=ctx.createCommandQueue(device, 0);
+
+var program=ctx.createProgram([
+  "__kernel void fill(__global float *x, float a)",
+  "{",
+  "  x[get_global_id(0)] = a;",
+  "}"
+].join("\n"));
+program.build([device]);
+var kernel=program.createKernel("fill");
+
+var size=N*Float32Array.BYTES_PER_ELEMENT;
+var bufA=ctx.createBuffer(WebCL.MEM_READ_WRITE, size);
+var bufB=ctx.createBuffer(WebCL.MEM_READ_WRITE, size);
+var bufC=ctx.createBuffer(WebCL.MEM_READ_WRITE, size);
+var bufD=ctx.createBuffer(WebCL.MEM_READ_WRITE, size);
+
+function read(buffer) {
+  var data=new Float32Array(N);
+  queue.enqueueReadBuffer(buffer, true, 0, size, data);
+  return data;
+}
+
+function expect(buffer, value, what) {
+  var data=read(buffer);
+  for(var i=0;i<N;i++) {
+    if(data[i]!==value)
+      throw new Error(what+": element "+i+" is "+data[i]+", expected "+value);
+  }
+}
+
+// clear all buffers
+[bufA, bufB, bufC, bufD].forEach(function(b) {
+  kernel.setArg(0, b);
+  kernel.setArg(1, new Float32Array([0]));
+  queue.enqueueNDRangeKernel(kernel, 1, null, [N], null);
+});
+
+queue.beginCapture();
+kernel.setArg(0, bufA);
+kernel.setArg(1, new Float32Array([2]));
+queue.enqueueNDRangeKernel(kernel, 1, null, [N], null);
+kernel.setArg(0, bufB);
+kernel.setArg(1, new Float32Array([3]));
+queue.enqueueNDRangeKernel(kernel, 1, null, [N], null);
+var graph=queue.endCapture();
+log("captured "+graph.length+" launches, "+graph.slotCount+" buffer slots");
+if(graph.slotCount!==2)
+  throw new Error("buffers passed as kernel arguments should get slots");
+
+// arguments set after capture must not leak into the replay
+kernel.setArg(0, bufC);
+kernel.setArg(1, new Float32Array([100]));
+queue.replay(graph);
+queue.finish();
+expect(bufA, 2, "first launch");
+expect(bufB, 3, "second launch");
+expect(bufC, 0, "buffer set after capture");
+
+// replay leaves the kernel's own arguments alone
+queue.enqueueNDRangeKernel(kernel, 1, null, [N], null);
+expect(bufC, 100, "launch after replay");
+
+// rebinding the slot of bufA redirects the first launch
+var slotA=-1;
+for(var s=0;s<graph.slotCount;s++)
+  if(graph.getSlot(s)===bufA) slotA=s;
+if(slotA<0)
+  throw new Error("no slot for the buffer of the first launch");
+graph.setSlot(slotA, bufD);
+queue.replay(graph);
+queue.finish();
+expect(bufD, 2, "rebound first launch");
+
+log("PASSED");
+graph.release();
+WebCL.releaseAll();
@@ -0,0 +1,106 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Capture and replay of a command graph.
+//
+// Captures a write -> copy -> N kernels -> copy -> read frame once, then
+// replays it every frame. Halfway through, the input slot is rebound to
+// another buffer to check that replays pick up the new handle.
+//
+// usage: node capture_replay.js [frames]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var FRAMES = parseInt(process.argv[2]) || 1000;
+var N = 1024;
+var KERNELS = 8;
+
+var ctx=WebCL.createContext({
+  deviceType: WebCL.DEVICE_TYPE_ALL,
+  platform: WebCL.getPlatforms()[0]
+});
+var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+var queue=ctx.createCommandQueue(device, 0);
+
+var source = [
+  "__kernel void inc(__global float *a) {",
+  "  int i = get_global_id(0);",
+  "  a[i] += 1.0f;",
+  "}"
+].join("\n");
+
+var program=ctx.createProgram(source);
+program.build([device]);
+var kernel=program.createKernel("inc");
+
+var size=N*Float32Array.BYTES_PER_ELEMENT;
+var inBuf=ctx.createBuffer(WebCL.MEM_READ_ONLY, size);
+var inBuf2=ctx.createBuffer(WebCL.MEM_READ_ONLY, size);
+var work=ctx.createBuffer(WebCL.MEM_READ_WRITE, size);
+var outBuf=ctx.createBuffer(WebCL.MEM_WRITE_ONLY, size);
+kernel.setArg(0, work);
+
+var input=new Float32Array(N), output=new Float32Array(N);
+
+queue.beginCapture();
+queue.enqueueWriteBuffer(inBuf, false, 0, size, input);
+queue.enqueueCopyBuffer(inBuf, work, 0, 0, size);
+for(var k=0;k<KERNELS;k++)
+  queue.enqueueNDRangeKernel(kernel, 1, null, [N], null);
+queue.enqueueCopyBuffer(work, outBuf, 0, 0, size);
+queue.enqueueReadBuffer(outBuf, true, 0, size, output);
+var graph=queue.endCapture();
+log("captured "+graph.length+" commands, "+graph.slotCount+" buffer slots");
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e3 + dt[1]/1e6; // ms
+}
+
+var t=process.hrtime();
+for(var f=0;f<FRAMES;f++) {
+  if(f==FRAMES/2)
+    graph.setSlot(0, inBuf2);
+
+  for(var i=0;i<N;i++) input[i]=f+i;
+  queue.replay(graph);
+
+  for(var i=0;i<N;i++) {
+    if(output[i]!==f+i+KERNELS) {
+      log("FAILED frame "+f+" at "+i+": "+output[i]+" != "+(f+i+KERNELS));
+      process.exit(1);
+    }
+  }
+}
+log("replay: "+(elapsed(t)/FRAMES).toFixed(3)+" ms/frame");
+log(graph.getSlot(0)===inBuf2 ? "PASSED" : "FAILED rebinding slot 0");
+
+graph.release();
+WebCL.releaseAll();
@@ -0,0 +1,114 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Recorded command lists.
+//
+// Runs the same write -> kernel -> read frame many times, once with
+// individual enqueue calls and once by submitting a WebCLCommandList,
+// checks both give the same result and reports the time per frame.
+//
+// usage: node command_list.js [frames]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var FRAMES = parseInt(process.argv[2]) || 1000;
+var N = 1024;
+var KERNELS = 8; // kernel launches per frame
+
+var ctx=WebCL.createContext({
+  deviceType: WebCL.DEVICE_TYPE_ALL,
+  platform: WebCL.getPlatforms()[0]
+});
+var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+var queue=ctx.createCommandQueue(device, 0);
+
+var source = [
+  "__kernel void inc(__global float *a) {",
+  "  int i = get_global_id(0);",
+  "  a[i] += 1.0f;",
+  "}"
+].join("\n");
+
+var program=ctx.createProgram(source);
+program.build([device]);
+var kernel=program.createKernel("inc");
+
+var size=N*Float32Array.BYTES_PER_ELEMENT;
+var buffer=ctx.createBuffer(WebCL.MEM_READ_WRITE, size);
+kernel.setArg(0, buffer);
+
+var input=new Float32Array(N), output=new Float32Array(N);
+for(var i=0;i<N;i++) input[i]=i;
+
+function check(name) {
+  for(var i=0;i<N;i++) {
+    if(output[i]!==i+KERNELS) {
+      log(name+": FAILED at "+i+": "+output[i]+" != "+(i+KERNELS));
+      process.exit(1);
+    }
+  }
+}
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e3 + dt[1]/1e6; // ms
+}
+
+// individual enqueues
+var t=process.hrtime();
+for(var f=0;f<FRAMES;f++) {
+  queue.enqueueWriteBuffer(buffer, false, 0, size, input);
+  for(var k=0;k<KERNELS;k++)
+    queue.enqueueNDRangeKernel(kernel, 1, null, [N], null);
+  queue.enqueueReadBuffer(buffer, true, 0, size, output);
+}
+var tEnqueue=elapsed(t)/FRAMES;
+check("enqueue");
+
+// same frame recorded once and submitted in one call
+var list=ctx.createCommandList();
+list.enqueueWriteBuffer(buffer, false, 0, size, input);
+for(var k=0;k<KERNELS;k++)
+  list.enqueueNDRangeKernel(kernel, 1, null, [N], null);
+list.enqueueReadBuffer(buffer, true, 0, size, output);
+log("recorded "+list.length+" commands");
+
+for(var i=0;i<N;i++) output[i]=0;
+t=process.hrtime();
+for(var f=0;f<FRAMES;f++)
+  queue.submit(list);
+var tSubmit=elapsed(t)/FRAMES;
+check("submit");
+
+log("enqueue: "+tEnqueue.toFixed(3)+" ms/frame");
+log("submit:  "+tSubmit.toFixed(3)+" ms/frame");
+
+list.release();
+WebCL.releaseAll();
@@ -0,0 +1,103 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Event callback latency.
+//
+// Completes user events from JS and measures the time until their
+// setCallback callback runs, one event at a time and in batches, while
+// the libuv threadpool is kept busy with fs work.
+//
+// usage: node event_callback_latency.js [events]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+var fs=require('fs');
+
+var EVENTS = parseInt(process.argv[2]) || 10000;
+var BATCH = 100;
+
+var ctx=WebCL.createContext({
+  deviceType: WebCL.DEVICE_TYPE_ALL,
+  platform: WebCL.getPlatforms()[0]
+});
+
+function now() {
+  var t=process.hrtime();
+  return t[0]*1e6 + t[1]/1e3; // us
+}
+
+// keeps every threadpool thread busy until stopped
+var busy=true;
+function fsLoad() {
+  if(busy) fs.readFile(__filename, fsLoad);
+}
+for(var i=0;i<16;i++) fsLoad();
+
+function report(name, samples) {
+  samples.sort(function (a, b) { return a-b; });
+  var sum=0;
+  for(var i=0;i<samples.length;i++) sum+=samples[i];
+  log(name+": mean "+(sum/samples.length).toFixed(1)+" us, p50 "+
+      samples[samples.length>>1].toFixed(1)+" us, p99 "+
+      samples[Math.floor(samples.length*0.99)].toFixed(1)+" us");
+}
+
+// completes n events at once, calls done(latencies)
+function batch(n, done) {
+  var events=[], latencies=[], count=0, t0;
+  for(var i=0;i<n;i++) {
+    var ev=ctx.createUserEvent();
+    ev.setCallback(WebCL.COMPLETE, function (event) {
+      latencies.push(now()-t0);
+      event.release();
+      if(++count===n) done(latencies);
+    });
+    events.push(ev);
+  }
+  t0=now();
+  for(var i=0;i<n;i++)
+    events[i].setUserEventStatus(WebCL.COMPLETE);
+}
+
+function run(n, rounds, samples, done) {
+  if(rounds===0) return done(samples);
+  batch(n, function (latencies) {
+    samples.push.apply(samples, latencies);
+    run(n, rounds-1, samples, done);
+  });
+}
+
+run(1, EVENTS, [], function (single) {
+  report("single event", single);
+  run(BATCH, Math.max(1, EVENTS/BATCH), [], function (batched) {
+    report("batches of "+BATCH, batched);
+    busy=false;
+    WebCL.releaseAll();
+  });
+});
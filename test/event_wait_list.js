@@ -0,0 +1,104 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Event wait lists.
+//
+// Enqueues waits on 1..32 completed events, passing the wait list
+// either as a plain array or as a reusable WebCLEventList, and
+// reports the time per enqueue. Then checks that an array holding
+// something else than events is rejected.
+//
+// usage: node event_wait_list.js [iterations]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var ITERATIONS = parseInt(process.argv[2]) || 10000;
+var SIZES = [1, 4, 16, 32];
+
+var ctx=WebCL.createContext({
+  deviceType: WebCL.DEVICE_TYPE_ALL,
+  platform: WebCL.getPlatforms()[0]
+});
+var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+var queue=ctx.createCommandQueue(device, 0);
+
+var events=[];
+for(var i=0;i<SIZES[SIZES.length-1];i++) {
+  var ev=new WebCL.WebCLEvent();
+  queue.enqueueMarker(ev);
+  events.push(ev);
+}
+queue.finish();
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e6 + dt[1]/1e3; // us
+}
+
+function run(wait_list) {
+  var t=process.hrtime();
+  for(var i=0;i<ITERATIONS;i++)
+    queue.enqueueWaitForEvents(wait_list);
+  var dt=elapsed(t)/ITERATIONS;
+  queue.finish();
+  return dt;
+}
+
+var list=new WebCL.WebCLEventList();
+for(var s=0;s<SIZES.length;s++) {
+  var n=SIZES[s];
+  var array=events.slice(0, n);
+  list.set(array);
+  if(list.length!==n) {
+    log("FAILED: list has "+list.length+" events, expected "+n);
+    process.exit(1);
+  }
+
+  var tArray=run(array);
+  var tList=run(list);
+  log(n+" events: array "+tArray.toFixed(2)+" us, WebCLEventList "+tList.toFixed(2)+" us");
+}
+
+// arrays may only hold events
+var bogus=ctx.createBuffer(WebCL.MEM_READ_WRITE, 16);
+var accepted=false;
+try {
+  queue.enqueueWaitForEvents([events[0], bogus]);
+  accepted=true;
+}
+catch(ex) {}
+if(accepted) {
+  log("FAILED: a wait list holding a buffer was accepted");
+  process.exit(1);
+}
+bogus.release();
+
+list.release();
+WebCL.releaseAll();
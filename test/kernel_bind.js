@@ -0,0 +1,116 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Kernel arguments bound by name.
+//
+// Two versions of a generated kernel declare the same arguments in a
+// different order. Both are bound with kernel.bind() and a reusable
+// binding, run, and must compute the same result. Then times binding all
+// arguments by name per launch.
+//
+// usage: node kernel_bind.js [iterations]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var ITERATIONS = parseInt(process.argv[2]) || 100000;
+var N = 1024;
+
+var ctx=WebCL.createContext({
+  deviceType: WebCL.DEVICE_TYPE_ALL,
+  platform: WebCL.getPlatforms()[0]
+});
+var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+var queue=ctx.createCommandQueue(device, 0);
+
+var body = [
+  "{",
+  "  size_t i = get_global_id(0);",
+  "  if(i < n) out[i] = in[i] * scale + bias;",
+  "}"
+];
+var versions = [
+  "__kernel void saxpb(__global const float *in, __global float *out, float scale, float bias, uint n)",
+  "__kernel void saxpb(uint n, float bias, __global float *out, float scale, __global const float *in)"
+];
+
+var size=N*Float32Array.BYTES_PER_ELEMENT;
+var input=new Float32Array(N), output=new Float32Array(N);
+for(var i=0;i<N;i++) input[i]=i;
+var inBuffer=ctx.createBuffer(WebCL.MEM_READ_ONLY, size);
+var outBuffer=ctx.createBuffer(WebCL.MEM_WRITE_ONLY, size);
+queue.enqueueWriteBuffer(inBuffer, true, 0, size, input);
+
+function run(kernel, name) {
+  queue.enqueueNDRangeKernel(kernel, 1, null, [N], null);
+  queue.enqueueReadBuffer(outBuffer, true, 0, size, output);
+  for(var i=0;i<N;i++) {
+    if(output[i]!==i*2+1) {
+      log(name+": FAILED at "+i+": "+output[i]+" != "+(i*2+1));
+      process.exit(1);
+    }
+  }
+}
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e3 + dt[1]/1e6; // ms
+}
+
+versions.forEach(function(signature, v) {
+  var program=ctx.createProgram([signature].concat(body).join("\n"));
+  program.build([device], "-cl-kernel-arg-info");
+  var kernel=program.createKernel("saxpb");
+
+  kernel.bind({ in: inBuffer, out: outBuffer, scale: 2, bias: 1, n: N });
+  run(kernel, "version "+v+" bind");
+
+  var binding=kernel.createBinding({ in: inBuffer, out: outBuffer, n: N });
+  binding.set("scale", 2).set("bias", 1).apply();
+  run(kernel, "version "+v+" binding");
+
+  var t=process.hrtime();
+  for(var i=0;i<ITERATIONS;i++)
+    kernel.bind({ in: inBuffer, out: outBuffer, scale: 2, bias: 1, n: N });
+  var tBind=elapsed(t)*1e6/ITERATIONS;
+
+  t=process.hrtime();
+  for(var i=0;i<ITERATIONS;i++)
+    binding.set("scale", 2).apply();
+  var tBinding=elapsed(t)*1e6/ITERATIONS;
+
+  log("version "+v+" (n is argument "+kernel.getArgIndex("n")+"): bind "+tBind.toFixed(1)+
+      " ns/launch, binding.apply "+tBinding.toFixed(1)+" ns/launch");
+
+  kernel.release();
+  program.release();
+});
+
+queue.release();
+ctx.release();
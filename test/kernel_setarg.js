@@ -0,0 +1,152 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Kernel argument setting cost.
+//
+// Times setArg for each kind of argument of a kernel: memory object,
+// scalar, vector and __local size. Argument types are read from the driver
+// once when the kernel is created, so scalar and vector arguments should
+// cost about as much as a buffer argument, i.e. one clSetKernelArg call.
+// Then times the typed fast paths (setArgMem, setArgFloat, ...) that skip
+// classifying the value, and binding all arguments of a launch with one
+// setArgs() call, with the scalars given as numbers or in a packed buffer.
+//
+// usage: node kernel_setarg.js [iterations]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var ITERATIONS = parseInt(process.argv[2]) || 1000000;
+
+var ctx=null;
+try {
+  ctx=WebCL.createContext({
+    deviceType: WebCL.DEVICE_TYPE_ALL,
+    platform: WebCL.getPlatforms()[0]
+  });
+}
+catch(ex) {
+  throw new Error("Can't create CL context");
+}
+
+var source = [
+  "__kernel void args(__global float *out, float scale, float4 offset, __local float *tmp, uint n)",
+  "{",
+  "  size_t id = get_global_id(0);",
+  "  tmp[get_local_id(0)] = scale * offset.x + n;",
+  "  barrier(CLK_LOCAL_MEM_FENCE);",
+  "  out[id] = tmp[get_local_id(0)] + offset.w;",
+  "}"
+].join("\n");
+
+var program=ctx.createProgram(source);
+program.build(null, "-cl-kernel-arg-info");
+var kernel=program.createKernel("args");
+
+var buffer=ctx.createBuffer(WebCL.MEM_WRITE_ONLY, 1024*4);
+var cases = [
+  [ "buffer", 0, buffer ],
+  [ "float", 1, new Float32Array([2]) ],
+  [ "float4", 2, new Float32Array([1, 2, 3, 4]) ],
+  [ "__local", 3, new Uint32Array([64*4]) ],
+  [ "uint", 4, new Uint32Array([1024]) ]
+];
+
+var fastCases = [
+  [ "setArgMem", 0, function(i) { kernel.setArgMem(0, buffer); } ],
+  [ "setArgFloat", 1, function(i) { kernel.setArgFloat(1, 2); } ],
+  [ "setArgLocal", 3, function(i) { kernel.setArgLocal(3, 64*4); } ],
+  [ "setArgUint", 4, function(i) { kernel.setArgUint(4, 1024); } ]
+];
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e3 + dt[1]/1e6; // ms
+}
+
+log("argument\tsetArg (ns/call)");
+cases.forEach(function(c) {
+  // warm up
+  for(var i=0;i<1000;i++)
+    kernel.setArg(c[1], c[2]);
+
+  var t=process.hrtime();
+  for(var i=0;i<ITERATIONS;i++)
+    kernel.setArg(c[1], c[2]);
+  log(c[0]+"\t\t"+(elapsed(t)*1e6/ITERATIONS).toFixed(1));
+});
+
+fastCases.forEach(function(c) {
+  var set=c[2];
+  for(var i=0;i<1000;i++)
+    set(i);
+
+  var t=process.hrtime();
+  for(var i=0;i<ITERATIONS;i++)
+    set(i);
+  log(c[0]+"\t"+(elapsed(t)*1e6/ITERATIONS).toFixed(1));
+});
+
+// all arguments of a launch
+var layout=kernel.getArgLayout();
+var packed=new ArrayBuffer(layout.size);
+var view=new DataView(packed);
+layout.args.forEach(function(arg) {
+  if(arg.type==="float") view.setFloat32(arg.offset, 2, true);
+  else if(arg.type==="float4") [1, 2, 3, 4].forEach(function(v, i) { view.setFloat32(arg.offset+4*i, v, true); });
+  else if(arg.type==="uint") view.setUint32(arg.offset, 1024, true);
+});
+var scale=new Float32Array([2]), offset=new Float32Array([1, 2, 3, 4]);
+var local=new Uint32Array([64*4]), n=new Uint32Array([1024]);
+
+var launches = [
+  [ "5 x setArg", function() {
+      kernel.setArg(0, buffer); kernel.setArg(1, scale); kernel.setArg(2, offset);
+      kernel.setArg(3, local); kernel.setArg(4, n);
+    } ],
+  [ "setArgs", function() { kernel.setArgs([ buffer, 2, offset, local, 1024 ]); } ],
+  [ "setArgs+packed", function() { kernel.setArgs([ buffer, null, null, local ], packed); } ]
+];
+
+log("\nlaunch\t\tbinding (ns/launch)");
+launches.forEach(function(c) {
+  var bind=c[1];
+  for(var i=0;i<1000;i++)
+    bind();
+
+  var t=process.hrtime();
+  for(var i=0;i<ITERATIONS/5;i++)
+    bind();
+  log(c[0]+"\t"+(elapsed(t)*1e6*5/ITERATIONS).toFixed(1));
+});
+
+kernel.release();
+program.release();
+buffer.release();
+ctx.release();
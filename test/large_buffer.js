@@ -0,0 +1,100 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// 64-bit buffer sizes and chunked transfers.
+//
+// Allocates the largest buffer the device allows (capped to the requested
+// size), writes it from a list of host chunks, reads the tail back with an
+// offset above 4GB when the buffer is that large, and checks the contents.
+// Offsets are passed as BigInt when the runtime supports them.
+//
+// usage: node large_buffer.js [GB] [chunk MB]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var GB = parseFloat(process.argv[2]) || 5;
+var CHUNK = (parseInt(process.argv[3]) || 256)*1024*1024;
+
+var ctx=WebCL.createContext({
+  deviceType: WebCL.DEVICE_TYPE_ALL,
+  platform: WebCL.getPlatforms()[0]
+});
+var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+var queue=ctx.createCommandQueue(device, 0);
+
+var max_alloc=device.getInfo(WebCL.DEVICE_MAX_MEM_ALLOC_SIZE);
+var size=Math.min(Math.floor(GB*1024*1024*1024), max_alloc);
+size-=size % CHUNK;
+log('max alloc size: '+max_alloc+' bytes, using '+size+' bytes in '+(size/CHUNK)+' chunks');
+
+var buffer=ctx.createBuffer(WebCL.MEM_READ_WRITE, size);
+if(buffer.getInfo(WebCL.MEM_SIZE)!==size)
+  throw new Error('MEM_SIZE '+buffer.getInfo(WebCL.MEM_SIZE)+' != '+size);
+
+// one host chunk per CHUNK bytes, each tagged with its index
+var chunks=[];
+for(var c=0;c<size/CHUNK;c++) {
+  var chunk=new Uint8Array(CHUNK);
+  for(var i=0;i<CHUNK;i+=4096) chunk[i]=c & 0xff;
+  chunks.push(chunk);
+}
+
+function now() {
+  var t=process.hrtime();
+  return t[0]*1e3 + t[1]/1e6; // ms
+}
+
+var t0=now();
+queue.enqueueWriteBuffer(buffer, true, 0, size, chunks);
+var t1=now();
+log('chunked write: '+(t1-t0).toFixed(1)+' ms, '+(size/1048576/((t1-t0)/1e3)).toFixed(1)+' MB/s');
+
+// read back the last chunk, which sits above 4GB for large buffers
+var offset=size-CHUNK;
+var result=new Uint8Array(CHUNK);
+queue.enqueueReadBuffer(buffer, true,
+  typeof BigInt !== 'undefined' ? BigInt(offset) : offset, CHUNK, result);
+
+var last=(size/CHUNK-1) & 0xff;
+for(var i=0;i<CHUNK;i+=4096) {
+  if(result[i]!==last)
+    throw new Error('mismatch at offset '+(offset+i)+': '+result[i]+' != '+last);
+}
+log('read back '+CHUNK+' bytes at offset '+offset+(offset>0xffffffff ? ' (above 4GB)' : '')+': OK');
+
+// chunked read of the whole buffer
+var t2=now();
+queue.enqueueReadBuffer(buffer, true, 0, size, chunks);
+var t3=now();
+log('chunked read: '+(t3-t2).toFixed(1)+' ms, '+(size/1048576/((t3-t2)/1e3)).toFixed(1)+' MB/s');
+
+buffer.release();
+queue.release();
+ctx.release();
@@ -0,0 +1,141 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Mapped buffers.
+//
+// Checks that views returned by enqueueMapBuffer are detached once
+// unmapped and that foreign arrays cannot be unmapped. Then runs a
+// producer/consumer loop over a host-backed buffer, once with a persistent
+// mapping, whose view is kept across unmaps, and once with
+// enqueueWriteBuffer copies, and prints the time per frame.
+//
+// usage: node mapped_buffers.js [frames] [KB]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var FRAMES = parseInt(process.argv[2]) || 1000;
+var SIZE = (parseInt(process.argv[3]) || 1024)*1024;
+
+var ctx=null;
+try {
+  ctx=WebCL.createContext({
+    deviceType: WebCL.DEVICE_TYPE_ALL,
+    platform: WebCL.getPlatforms()[0]
+  });
+}
+catch(ex) {
+  throw new Error("Can't create CL context");
+}
+var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+var queue=ctx.createCommandQueue(device, 0);
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e3 + dt[1]/1e6; // ms
+}
+
+// unmapping detaches the view
+var buffer=ctx.createBuffer(WebCL.MEM_READ_WRITE, SIZE);
+var view=queue.enqueueMapBuffer(buffer, true, WebCL.MAP_WRITE, 0, SIZE);
+if(!(view.buffer instanceof ArrayBuffer) || view.length!==SIZE)
+  throw new Error("expected a view of "+SIZE+" bytes");
+view[0]=42;
+queue.enqueueUnmapMemObject(buffer, view);
+if(view.length!==0 || view.buffer.byteLength!==0)
+  throw new Error("view still attached after unmap");
+
+// only mapped regions can be unmapped
+var unmapped=false;
+try {
+  queue.enqueueUnmapMemObject(buffer, new Uint8Array(SIZE));
+  unmapped=true;
+}
+catch(ex) {}
+if(unmapped)
+  throw new Error("unmapped an array that was never mapped");
+
+// producer/consumer: the host fills a frame, the device copies it
+var host=ctx.createBuffer(WebCL.MEM_READ_ONLY | WebCL.MEM_ALLOC_HOST_PTR, SIZE);
+var frame=ctx.createBuffer(WebCL.MEM_READ_WRITE, SIZE);
+var data=new Uint8Array(SIZE);
+
+// the persistent view survives unmap and is handed out again while the
+// driver maps the same host memory, a moved region gets a new view
+var prev=null, reused=0;
+var t=process.hrtime();
+for(var f=0;f<FRAMES;f++) {
+  var map=queue.enqueueMapBufferPersistent(host, true, WebCL.MAP_WRITE, 0, SIZE);
+  if(map.length!==SIZE)
+    throw new Error("frame "+f+": expected a view of "+SIZE+" bytes");
+  if(map===prev)
+    reused++;
+  else if(prev && prev.length!==0)
+    throw new Error("frame "+f+": view of a moved region still attached");
+  map[f % SIZE]=f & 0xff;
+  queue.enqueueUnmapMemObject(host, map);
+  if(map.length!==SIZE)
+    throw new Error("persistent view detached by unmap");
+  queue.enqueueCopyBuffer(host, frame, 0, 0, SIZE);
+  prev=map;
+}
+queue.finish();
+var tMapped=elapsed(t)/FRAMES;
+
+t=process.hrtime();
+for(var f=0;f<FRAMES;f++) {
+  data[f % SIZE]=f & 0xff;
+  queue.enqueueWriteBuffer(frame, true, 0, SIZE, data);
+}
+queue.finish();
+var tCopied=elapsed(t)/FRAMES;
+
+log("persistent map: "+tMapped.toFixed(3)+" ms/frame ("+reused+"/"+FRAMES+" views reused)");
+log("write copy:     "+tCopied.toFixed(3)+" ms/frame");
+
+// a persistent view unmapped twice is rejected like a foreign array
+unmapped=false;
+try {
+  queue.enqueueUnmapMemObject(host, prev);
+  unmapped=true;
+}
+catch(ex) {}
+if(unmapped)
+  throw new Error("unmapped a persistent view that is not mapped");
+
+// releasing the buffer detaches its views, mapped or not
+var last=queue.enqueueMapBufferPersistent(host, true, WebCL.MAP_WRITE, 0, SIZE);
+host.release();
+if(last.length!==0 || prev.length!==0)
+  throw new Error("persistent view still attached after release");
+
+frame.release();
+buffer.release();
+queue.release();
+ctx.release();
@@ -0,0 +1,122 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// NDRange work sizes.
+//
+// Launches a small kernel many times with its global and local sizes given
+// as plain arrays, Uint32Arrays and WebCLRange objects, checks the result
+// and reports the time per launch.
+//
+// usage: node ndrange_args.js [launches]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var LAUNCHES = parseInt(process.argv[2]) || 50000;
+var N = 256;
+
+var ctx=WebCL.createContext({
+  deviceType: WebCL.DEVICE_TYPE_ALL,
+  platform: WebCL.getPlatforms()[0]
+});
+var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+var queue=ctx.createCommandQueue(device, 0);
+
+var source = [
+  "__kernel void inc(__global uint *a) {",
+  "  a[get_global_id(0)] += 1;",
+  "}"
+].join("\n");
+
+var program=ctx.createProgram(source);
+program.build([device]);
+var kernel=program.createKernel("inc");
+
+var size=N*Uint32Array.BYTES_PER_ELEMENT;
+var buffer=ctx.createBuffer(WebCL.MEM_READ_WRITE, size);
+kernel.setArg(0, buffer);
+
+var data=new Uint32Array(N);
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e6 + dt[1]/1e3; // us
+}
+
+function run(name, globals, locals) {
+  for(var i=0;i<N;i++) data[i]=0;
+  queue.enqueueWriteBuffer(buffer, true, 0, size, data);
+
+  var t=process.hrtime();
+  for(var i=0;i<LAUNCHES;i++)
+    queue.enqueueNDRangeKernel(kernel, 1, null, globals, locals);
+  queue.finish();
+  var dt=elapsed(t)/LAUNCHES;
+
+  queue.enqueueReadBuffer(buffer, true, 0, size, data);
+  for(var i=0;i<N;i++) {
+    if(data[i]!==LAUNCHES) {
+      log(name+": FAILED at "+i+": "+data[i]+" != "+LAUNCHES);
+      process.exit(1);
+    }
+  }
+  log(name+": "+dt.toFixed(2)+" us/launch");
+}
+
+run("Array", [N], null);
+run("Uint32Array", new Uint32Array([N]), null);
+run("Float64Array", new Float64Array([N]), null);
+
+var globals=new WebCL.WebCLRange(N), locals=new WebCL.WebCLRange(1);
+if(globals.length!==1 || globals.get(0)!==N) {
+  log("WebCLRange: FAILED, got "+globals.length+" dims");
+  process.exit(1);
+}
+run("WebCLRange", globals, locals);
+
+// negative, fractional and non-finite sizes are rejected, not wrapped
+[[-1], [N+0.5], [NaN], [Infinity], new Float64Array([-1])].forEach(function(bad) {
+  var threw=false;
+  try { queue.enqueueNDRangeKernel(kernel, 1, null, bad, null); }
+  catch(ex) { threw=/INVALID_GLOBAL_WORK_SIZE/.test(ex.message); }
+  if(!threw) {
+    log("invalid globals "+bad[0]+": FAILED, not rejected with INVALID_GLOBAL_WORK_SIZE");
+    process.exit(1);
+  }
+});
+var threw=false;
+try { new WebCL.WebCLRange(-1); } catch(ex) { threw=true; }
+if(!threw) {
+  log("WebCLRange(-1): FAILED, not rejected");
+  process.exit(1);
+}
+
+globals.release();
+locals.release();
+WebCL.releaseAll();
@@ -0,0 +1,116 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Padded launches.
+//
+// Runs kernels over extents that are not multiples of any work-group size
+// (primes and odd image sizes) with enqueuePaddedNDRangeKernel(), which
+// pads the globals and passes the true extent as an argument, and checks
+// every element is written exactly once. Also checks the extent can be
+// given as a vector argument, a name, or scalar arguments in a row.
+//
+// usage: node padded_launch.js
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var ctx=null;
+try {
+  ctx=WebCL.createContext({
+    deviceType: WebCL.DEVICE_TYPE_ALL,
+    platform: WebCL.getPlatforms()[0]
+  });
+}
+catch(ex) {
+  throw new Error("Can't create CL context");
+}
+var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+var queue=ctx.createCommandQueue(device, 0);
+
+var program=ctx.createProgram([
+  "__kernel void fill1(__global int *out, uint n)",
+  "{",
+  "  size_t i = get_global_id(0);",
+  "  if (i >= n) return;",
+  "  out[i] += i + 1;",
+  "}",
+  "__kernel void fill2(__global int *out, int2 extent)",
+  "{",
+  "  int x = get_global_id(0), y = get_global_id(1);",
+  "  if (x >= extent.x || y >= extent.y) return;",
+  "  out[y * extent.x + x] += y * extent.x + x + 1;",
+  "}",
+  "__kernel void fill3(__global int *out, int w, int h, int d)",
+  "{",
+  "  int x = get_global_id(0), y = get_global_id(1), z = get_global_id(2);",
+  "  if (x >= w || y >= h || z >= d) return;",
+  "  int i = (z * h + y) * w + x;",
+  "  out[i] += i + 1;",
+  "}"
+].join("\n"));
+program.build(null, "-cl-kernel-arg-info");
+
+function check(name, extent, extentArg) {
+  var n=extent.reduce(function(a, b) { return a*b; }, 1);
+  var data=new Int32Array(n);
+  var buffer=ctx.createBuffer(WebCL.MEM_READ_WRITE | WebCL.MEM_COPY_HOST_PTR, data.byteLength, data);
+  var kernel=program.createKernel(name);
+  kernel.setArg(0, buffer);
+
+  var plan=queue.planNDRange(kernel, extent.length, extent);
+  queue.enqueuePaddedNDRangeKernel(kernel, extent.length, null, extent, extentArg);
+  queue.enqueueReadBuffer(buffer, true, 0, data.byteLength, data);
+  log(name+" over "+extent.join("x")+": globals "+plan.globals.join("x")+", locals "+plan.locals.join("x"));
+
+  for(var d=0;d<extent.length;d++) {
+    if(plan.globals[d]<extent[d] || plan.globals[d]%plan.locals[d]!==0)
+      throw new Error(name+": globals "+plan.globals+" do not cover "+extent+" in groups of "+plan.locals);
+  }
+  for(var i=0;i<n;i++) {
+    if(data[i]!==i+1)
+      throw new Error(name+": element "+i+" is "+data[i]+", expected "+(i+1));
+  }
+  kernel.release();
+  buffer.release();
+}
+
+[1, 7, 997, 100003].forEach(function(n) { check("fill1", [n], 1); });
+[[1, 1], [640, 481], [1001, 3]].forEach(function(e) { check("fill2", e, "extent"); });
+[[17, 13, 5]].forEach(function(e) { check("fill3", e, "w"); });
+
+// given locals are kept when the kernel can use them
+var kernel=program.createKernel("fill1");
+var plan=queue.planNDRange(kernel, 1, [1000], [8]);
+if(plan.locals[0]!==8 || plan.globals[0]!==1000)
+  throw new Error("planNDRange should keep legal locals: "+JSON.stringify(plan));
+kernel.release();
+
+program.release();
+queue.release();
+ctx.release();
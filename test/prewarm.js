@@ -0,0 +1,111 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Startup pre-warm from a manifest.
+//
+// Pre-warms a manifest of generated programs with WebCL.prewarm(), printing
+// progress and the compile time of each program, then checks that the
+// programs and kernels are handed out by createCachedProgram() and
+// acquireKernel() without building anything again, even with a program
+// budget the pre-warmed programs exceed.
+//
+// usage: node prewarm.js [programs] [concurrency]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var PROGRAMS = parseInt(process.argv[2]) || 16;
+var CONCURRENCY = parseInt(process.argv[3]) || 4;
+
+var ctx=null;
+try {
+  ctx=WebCL.createContext({
+    deviceType: WebCL.DEVICE_TYPE_ALL,
+    platform: WebCL.getPlatforms()[0]
+  });
+}
+catch(ex) {
+  throw new Error("Can't create CL context");
+}
+
+// measure compiles, not the binary cache
+WebCL.setProgramCache(null);
+
+// pre-warmed programs are pinned, a budget below one program keeps them all
+ctx.setProgramLibraryBudget(1);
+
+var manifest={ context: ctx, concurrency: CONCURRENCY, programs: [] };
+for(var i=0;i<PROGRAMS;i++) {
+  manifest.programs.push({
+    name: "filter"+i,
+    source: [
+      "__kernel void filter"+i+"(__global const float *in, __global float *out)",
+      "{",
+      "  size_t id = get_global_id(0);",
+      "  out[id] = in[id] * "+(i+1)+".0f + WEIGHT;",
+      "}",
+      "__kernel void clear"+i+"(__global float *out) { out[get_global_id(0)] = 0; }"
+    ].join("\n"),
+    options: "-D WEIGHT=0.5f",
+    // the second kernel is found with createKernelsInProgram()
+    kernels: (i%2) ? undefined : [ "filter"+i ]
+  });
+}
+
+manifest.onProgress=function(progress) {
+  var p=progress.program;
+  log("["+progress.done+"/"+progress.total+"] "+p.name+": compiled in "+p.compileTime.toFixed(1)+
+      " ms, "+p.kernels.length+" kernels in "+p.kernelTime.toFixed(2)+" ms");
+};
+
+WebCL.prewarm(manifest).then(function(report) {
+  var compile=0;
+  report.programs.forEach(function(p) { compile+=p.compileTime; });
+  log("ready after "+report.elapsed.toFixed(1)+" ms ("+compile.toFixed(1)+" ms of compiles)");
+
+  // requests now find everything built
+  var before=ctx.getProgramLibraryStats();
+  manifest.programs.forEach(function(entry, i) {
+    var program=ctx.createCachedProgram(entry.source, entry.options);
+    program.acquireKernel("filter"+i).release();
+    program.release();
+  });
+  var after=ctx.getProgramLibraryStats();
+  log("library stats: "+JSON.stringify(after));
+  if(after.misses!==before.misses || after.kernelMisses!==before.kernelMisses)
+    throw new Error("pre-warmed programs and kernels should not be built again");
+  if(after.evictions!==0 || after.programsPinned!==PROGRAMS)
+    throw new Error("pre-warmed programs should be pinned");
+
+  ctx.release();
+}).catch(function(err) {
+  log(err.stack);
+  if(err.report) log(JSON.stringify(err.report.programs.map(function(p) { return p.error && p.error.build; })));
+  process.exit(1);
+});
@@ -0,0 +1,98 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// On-disk program binary cache.
+//
+// Builds the same program twice in fresh contexts with the cache pointed
+// at a temporary directory. The first build compiles from source and
+// stores the binaries, the second loads them from disk. Prints both build
+// times with the cache statistics, then invalidates the cache.
+//
+// usage: node program_cache.js [cache directory]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+  fs=require('fs');
+  os=require('os');
+  path=require('path');
+}
+
+var dir = process.argv[2] || path.join(os.tmpdir(), 'webcl-program-cache-'+process.pid);
+WebCL.setProgramCache(dir);
+WebCL.invalidateProgramCache();
+
+var source = [
+  "__kernel void saxpy(float a, __global const float *x, __global float *y, uint n)",
+  "{",
+  "  size_t i = get_global_id(0);",
+  "  if(i < n) y[i] = a*x[i] + y[i];",
+  "}"
+].join("\n");
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e3 + dt[1]/1e6; // ms
+}
+
+function build() {
+  var ctx=WebCL.createContext({
+    deviceType: WebCL.DEVICE_TYPE_ALL,
+    platform: WebCL.getPlatforms()[0]
+  });
+  var program=ctx.createProgram(source);
+  var t=process.hrtime();
+  program.build(null, "-cl-fast-relaxed-math");
+  var dt=elapsed(t);
+
+  // kernels work the same whether the program came from the cache or not
+  var kernel=program.createKernel("saxpy");
+  var binaries=program.getInfo(WebCL.PROGRAM_BINARIES);
+  binaries.forEach(function(binary) {
+    if(!(binary instanceof Uint8Array) || binary.length===0)
+      throw new Error("PROGRAM_BINARIES should be non-empty Uint8Arrays");
+  });
+  kernel.release();
+  program.release();
+  ctx.release();
+  return dt;
+}
+
+var tSource=build();
+var stats=WebCL.getProgramCacheStats();
+log("source build: "+tSource.toFixed(2)+" ms ("+stats.stores+" binaries stored, "+stats.bytesWritten+" bytes)");
+
+var tCached=build();
+stats=WebCL.getProgramCacheStats();
+log("cached build: "+tCached.toFixed(2)+" ms ("+(tSource/tCached).toFixed(1)+"x)");
+log("cache stats: "+JSON.stringify(stats));
+if(stats.hits===0)
+  throw new Error("the second build did not load from the cache");
+
+log("invalidated "+WebCL.invalidateProgramCache()+" entries");
+if(!process.argv[2] && fs.existsSync(dir))
+  fs.rmdirSync(dir);
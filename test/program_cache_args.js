@@ -0,0 +1,123 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Kernel arguments of programs loaded from the program binary cache.
+//
+// Programs created from binaries usually have no argument info, which
+// setArgs() with numbers, __local sizes and bind() rely on. The cache
+// keeps the argument descriptors of the source build, so the same kernel
+// must run the same way whether its program was compiled or loaded.
+//
+// usage: node program_cache_args.js
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+  fs=require('fs');
+  os=require('os');
+  path=require('path');
+}
+
+var N = 1024, LOCAL = 64;
+
+var dir = path.join(os.tmpdir(), 'webcl-program-cache-args-'+process.pid);
+WebCL.setProgramCache(dir);
+WebCL.invalidateProgramCache();
+
+var source = [
+  "__kernel void scale(__global const float *in, __global float *out, __local float *tmp, float s, uint n)",
+  "{",
+  "  size_t i = get_global_id(0), l = get_local_id(0);",
+  "  tmp[l] = i < n ? in[i] : 0;",
+  "  barrier(CLK_LOCAL_MEM_FENCE);",
+  "  if(i < n) out[i] = tmp[LOCAL-1-l] * s;",
+  "}"
+].join("\n");
+
+function check(output, name) {
+  for(var i=0;i<N;i++) {
+    // each work-group reverses its items
+    var expected=(i-i%LOCAL + LOCAL-1-i%LOCAL)*3;
+    if(output[i]!==expected) {
+      log(name+": FAILED at "+i+": "+output[i]+" != "+expected);
+      process.exit(1);
+    }
+  }
+}
+
+function run(name) {
+  var ctx=WebCL.createContext({
+    deviceType: WebCL.DEVICE_TYPE_ALL,
+    platform: WebCL.getPlatforms()[0]
+  });
+  var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+  var queue=ctx.createCommandQueue(device, 0);
+
+  var size=N*Float32Array.BYTES_PER_ELEMENT;
+  var input=new Float32Array(N), output=new Float32Array(N);
+  for(var i=0;i<N;i++) input[i]=i;
+  var inBuffer=ctx.createBuffer(WebCL.MEM_READ_ONLY, size);
+  var outBuffer=ctx.createBuffer(WebCL.MEM_WRITE_ONLY, size);
+  queue.enqueueWriteBuffer(inBuffer, true, 0, size, input);
+
+  var program=ctx.createProgram(source);
+  program.build([device], "-cl-kernel-arg-info -D LOCAL="+LOCAL);
+  var kernel=program.createKernel("scale");
+
+  if(kernel.getArgIndex("s")!==3)
+    throw new Error(name+": argument names are missing");
+
+  kernel.setArgs([inBuffer, outBuffer, new Uint32Array([LOCAL*4]), 3, N]);
+  queue.enqueueNDRangeKernel(kernel, 1, null, [N], [LOCAL]);
+  queue.enqueueReadBuffer(outBuffer, true, 0, size, output);
+  check(output, name+" setArgs");
+
+  output=new Float32Array(N);
+  queue.enqueueWriteBuffer(outBuffer, true, 0, size, output);
+  kernel.bind({ in: inBuffer, out: outBuffer, tmp: new Uint32Array([LOCAL*4]), s: 3, n: N });
+  queue.enqueueNDRangeKernel(kernel, 1, null, [N], [LOCAL]);
+  queue.enqueueReadBuffer(outBuffer, true, 0, size, output);
+  check(output, name+" bind");
+
+  kernel.release();
+  program.release();
+  queue.release();
+  ctx.release();
+}
+
+run("source build");
+run("cached build");
+
+var stats=WebCL.getProgramCacheStats();
+log("cache stats: "+JSON.stringify(stats));
+if(stats.hits===0)
+  throw new Error("the second build did not load from the cache");
+log("PASSED");
+
+WebCL.invalidateProgramCache();
+if(fs.existsSync(dir))
+  fs.rmdirSync(dir);
@@ -0,0 +1,138 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Shared programs and pooled kernels.
+//
+// Several "modules" ask their context for the same program source, once
+// with createProgram()+build() and once with createCachedProgram(). The
+// cached path builds the program once and hands out pooled kernels; prints
+// the cost per request with the library statistics, then checks that
+// released handles are dead and that a small budget evicts programs nobody
+// holds.
+//
+// usage: node program_library.js [requests]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var REQUESTS = parseInt(process.argv[2]) || 100;
+
+var ctx=null;
+try {
+  ctx=WebCL.createContext({
+    deviceType: WebCL.DEVICE_TYPE_ALL,
+    platform: WebCL.getPlatforms()[0]
+  });
+}
+catch(ex) {
+  throw new Error("Can't create CL context");
+}
+
+function source(i) {
+  return [
+    "// module "+i,
+    "__kernel void scale(__global float *x, float a)",
+    "{",
+    "  x[get_global_id(0)] *= a;",
+    "}"
+  ].join("\n");
+}
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e3 + dt[1]/1e6; // ms
+}
+
+// every request uses the same source
+function run(getProgram, getKernel) {
+  var t=process.hrtime();
+  for(var i=0;i<REQUESTS;i++) {
+    var program=getProgram(source(0));
+    var kernel=getKernel(program);
+    kernel.release();
+    program.release();
+  }
+  return elapsed(t)/REQUESTS;
+}
+
+var tPlain=run(function(src) {
+    var p=ctx.createProgram(src);
+    p.build(null, "-cl-mad-enable");
+    return p;
+  },
+  function(p) { return p.createKernel("scale"); });
+
+var tCached=run(function(src) { return ctx.createCachedProgram(src, "-cl-mad-enable"); },
+  function(p) { return p.acquireKernel("scale"); });
+
+var stats=ctx.getProgramLibraryStats();
+log("createProgram:       "+tPlain.toFixed(3)+" ms/request");
+log("createCachedProgram: "+tCached.toFixed(3)+" ms/request ("+(tPlain/tCached).toFixed(1)+"x)");
+log("library stats: "+JSON.stringify(stats));
+if(stats.misses!==1 || stats.kernelMisses!==1)
+  throw new Error("the program and its kernel should have been built once");
+
+// two users of a program get distinct kernels and handles on one program
+var misses=stats.misses;
+var p1=ctx.createCachedProgram(source(0), "-cl-mad-enable");
+var p2=ctx.createCachedProgram(source(0), "-cl-mad-enable");
+if(ctx.getProgramLibraryStats().misses!==misses)
+  throw new Error("same source and options should share one program");
+var k1=p1.acquireKernel("scale");
+var k2=p2.acquireKernel("scale");
+if(k1===k2)
+  throw new Error("kernels in use should not be handed out twice");
+
+// released handles are dead, they don't alias the next user's kernel or
+// give up another holder's reference
+k1.release();
+k1.release();
+var k3=p1.acquireKernel("scale");
+if(k3===k1)
+  throw new Error("a released kernel handle should not be handed out again");
+var failed=false;
+try { k1.setArg(1, new Float32Array([2])); } catch(ex) { failed=true; }
+if(!failed)
+  throw new Error("a released kernel handle should not reach the pooled kernel");
+k2.release(); k3.release();
+p1.release(); p1.release();
+if(ctx.getProgramLibraryStats().programsInUse!==1)
+  throw new Error("releasing a program handle twice should release it once");
+p2.release();
+
+// a budget below one program keeps none of the idle ones
+ctx.setProgramLibraryBudget(1);
+for(var i=1;i<=4;i++)
+  ctx.createCachedProgram(source(i)).release();
+stats=ctx.getProgramLibraryStats();
+log("after budget of 1 byte: "+JSON.stringify(stats));
+if(stats.programs!==0)
+  throw new Error("idle programs should be evicted over budget");
+
+ctx.release();
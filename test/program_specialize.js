@@ -0,0 +1,128 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Kernel specialization.
+//
+// Builds variants of one tiled kernel with program.specialize() for a few
+// TILE sizes and element types, checks that specializing again with the
+// same constants returns the cached variant and that each variant computes
+// the right result with the options the program itself was built with.
+//
+// usage: node program_specialize.js
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var N=1024;
+
+var ctx=null;
+try {
+  ctx=WebCL.createContext({
+    deviceType: WebCL.DEVICE_TYPE_ALL,
+    platform: WebCL.getPlatforms()[0]
+  });
+}
+catch(ex) {
+  throw new Error("Can't create CL context");
+}
+var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+var queue=ctx.createCommandQueue(device, 0);
+
+// each work-item sums TILE consecutive elements, scaled by SCALE
+var program=ctx.createProgram([
+  "#ifndef TILE",
+  "#define TILE 1",
+  "#endif",
+  "#ifndef T",
+  "#define T float",
+  "#endif",
+  "__kernel void sum(__global const T *x, __global T *y)",
+  "{",
+  "  size_t i = get_global_id(0);",
+  "  T s = 0;",
+  "  for (int j = 0; j < TILE; j++)",
+  "    s += x[i * TILE + j];",
+  "  y[i] = s * SCALE;",
+  "}"
+].join("\n"));
+
+// variants are built with these options too
+var SCALE=3;
+program.build([device], "-D SCALE="+SCALE);
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e3 + dt[1]/1e6; // ms
+}
+
+var types={ 'float': Float32Array, 'int': Int32Array };
+[4, 16, 64].forEach(function(tile) {
+  Object.keys(types).forEach(function(T) {
+    var Type=types[T];
+    var t=process.hrtime();
+    var variant=program.specialize({ TILE: tile, T: T });
+    var tBuild=elapsed(t);
+    t=process.hrtime();
+    if(program.specialize({ T: T, TILE: tile })!==variant)
+      throw new Error("same constants should return the cached variant");
+    var tCached=elapsed(t);
+
+    var x=new Type(N), y=new Type(N/tile);
+    for(var i=0;i<N;i++) x[i]=i%7;
+    var bx=ctx.createBuffer(WebCL.MEM_READ_ONLY | WebCL.MEM_COPY_HOST_PTR, x.byteLength, x);
+    var by=ctx.createBuffer(WebCL.MEM_WRITE_ONLY, y.byteLength);
+
+    var kernel=variant.acquireKernel("sum");
+    kernel.setArg(0, bx);
+    kernel.setArg(1, by);
+    queue.enqueueNDRangeKernel(kernel, 1, null, [N/tile], null);
+    queue.enqueueReadBuffer(by, true, 0, y.byteLength, y);
+    kernel.release();
+
+    for(var i=0;i<N/tile;i++) {
+      var s=0;
+      for(var j=0;j<tile;j++) s+=(i*tile+j)%7;
+      s*=SCALE;
+      if(y[i]!==s)
+        throw new Error("TILE="+tile+" T="+T+": y["+i+"]="+y[i]+", expected "+s);
+    }
+    log("TILE="+tile+" T="+T+": built in "+tBuild.toFixed(3)+" ms, cached lookup "+tCached.toFixed(3)+" ms");
+    bx.release();
+    by.release();
+  });
+});
+
+var threw=false;
+try { program.specialize({ 'A B': 1 }); } catch(ex) { threw=true; }
+if(!threw)
+  throw new Error("invalid constant names should be rejected");
+
+program.release();
+queue.release();
+ctx.release();
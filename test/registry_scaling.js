@@ -0,0 +1,88 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Native object registry scaling.
+//
+// Creates a growing number of live buffers and measures how the cost of
+// handle lookups (getInfo returning a wrapped object) and of releasing
+// objects evolves with the registry size. Both should stay flat.
+//
+// usage: node registry_scaling.js [max_objects]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+
+var MAX_OBJECTS = parseInt(process.argv[2]) || 100000;
+var LOOKUPS     = 10000;
+
+var ctx=null;
+try {
+  ctx=WebCL.createContext({
+    deviceType: WebCL.DEVICE_TYPE_ALL,
+    platform: WebCL.getPlatforms()[0]
+  });
+}
+catch(ex) {
+  throw new Error("Can't create CL context");
+}
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e3 + dt[1]/1e6; // ms
+}
+
+var buffers=[];
+log("objects\tlookup (ns/op)\trelease (ns/op)");
+
+for(var n=10; n<=MAX_OBJECTS; n*=10) {
+  // grow the registry to n live buffers
+  while(buffers.length < n)
+    buffers.push(ctx.createBuffer(WebCL.MEM_READ_WRITE, 16));
+
+  // lookups: MEM_CONTEXT resolves the cl_context back to its wrapper
+  var t=process.hrtime();
+  for(var i=0;i<LOOKUPS;i++)
+    buffers[(i*7919) % n].getInfo(WebCL.MEM_CONTEXT);
+  var tLookup=elapsed(t)*1e6/LOOKUPS;
+
+  // release/recreate a sample from the middle of the registry
+  var count=Math.min(LOOKUPS, n);
+  t=process.hrtime();
+  for(var i=0;i<count;i++) {
+    var j=(i*7919) % n;
+    buffers[j].release();
+    buffers[j]=ctx.createBuffer(WebCL.MEM_READ_WRITE, 16);
+  }
+  var tRelease=elapsed(t)*1e6/count;
+
+  log(n+"\t"+tLookup.toFixed(1)+"\t\t"+tRelease.toFixed(1));
+}
+
+buffers.forEach(function(b) { b.release(); });
+ctx.release();
@@ -0,0 +1,143 @@
+// Copyright (c) 2011-2012, Motorola Mobility, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of the Motorola Mobility, Inc. nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Local work size tuning.
+//
+// Tunes a 2D kernel, prints the time of every local size tried, then
+// compares launches without locals before and after tuning. The results
+// are written to a temporary file and read back, as a second WebCL
+// instance would, by a kernel of a new program built from the same source.
+//
+// usage: node worksize_tuning.js [width] [height]
+
+var nodejs = (typeof window === 'undefined');
+if(nodejs) {
+  WebCL = require('../webcl');
+  log=console.log;
+}
+var fs=require('fs');
+var os=require('os');
+var path=require('path');
+
+var W = parseInt(process.argv[2]) || 1024;
+var H = parseInt(process.argv[3]) || 1024;
+var LAUNCHES = 20;
+
+var file=path.join(os.tmpdir(), 'webcl-worksizes-'+process.pid+'.txt');
+WebCL.setWorkSizeFile(file);
+
+var ctx=null;
+try {
+  ctx=WebCL.createContext({
+    deviceType: WebCL.DEVICE_TYPE_ALL,
+    platform: WebCL.getPlatforms()[0]
+  });
+}
+catch(ex) {
+  throw new Error("Can't create CL context");
+}
+var device=ctx.getInfo(WebCL.CONTEXT_DEVICES)[0];
+var queue=ctx.createCommandQueue(device, 0);
+
+// 3x3 box blur
+var source=[
+  "__kernel void blur(__global const float *src, __global float *dst, int w, int h)",
+  "{",
+  "  int x = get_global_id(0), y = get_global_id(1);",
+  "  float s = 0;",
+  "  for (int j = -1; j <= 1; j++)",
+  "    for (int i = -1; i <= 1; i++)",
+  "      s += src[clamp(y + j, 0, h - 1) * w + clamp(x + i, 0, w - 1)];",
+  "  dst[y * w + x] = s / 9;",
+  "}"
+].join("\n");
+var program=ctx.createProgram(source);
+program.build(null, "-cl-kernel-arg-info");
+var kernel=program.createKernel("blur");
+
+var src=ctx.createBuffer(WebCL.MEM_READ_ONLY, W*H*4);
+var dst=ctx.createBuffer(WebCL.MEM_WRITE_ONLY, W*H*4);
+kernel.setArgs([src, dst, W, H]);
+
+function elapsed(t) {
+  var dt=process.hrtime(t);
+  return dt[0]*1e3 + dt[1]/1e6; // ms
+}
+
+function launches() {
+  var t=process.hrtime();
+  for(var i=0;i<LAUNCHES;i++)
+    queue.enqueueNDRangeKernel(kernel, 2, null, [W, H]);
+  queue.finish();
+  return elapsed(t)/LAUNCHES;
+}
+
+var before=launches();
+var result=queue.tuneNDRangeKernel(kernel, 2, null, [W, H]);
+result.candidates.forEach(function(c) {
+  log("  "+(c.locals ? c.locals.join("x") : "driver")+": "+(c.time/1e3).toFixed(1)+" us");
+});
+log("best: "+(result.locals ? result.locals.join("x") : "driver")+", "+(result.time/1e3).toFixed(1)+" us");
+var after=launches();
+log("without locals: "+before.toFixed(3)+" ms before tuning, "+after.toFixed(3)+" ms after");
+
+var stats=WebCL.getWorkSizeStats();
+log("tuning stats: "+JSON.stringify(stats));
+if(stats.entries!==1 || stats.tuned!==1)
+  throw new Error("the kernel should have one tuned entry");
+if(result.locals && stats.hits<LAUNCHES)
+  throw new Error("launches without locals should use the tuned ones");
+if(!fs.existsSync(file))
+  throw new Error("tuned local sizes should be saved to "+file);
+
+// the file is read back by a fresh load, and a kernel of the same source
+// and options finds its entry there
+WebCL.setWorkSizeFile(file);
+if(WebCL.getWorkSizeStats().entries!==1)
+  throw new Error("saved local sizes should be loaded from "+file);
+
+var program2=ctx.createProgram(source);
+program2.build(null, "-cl-kernel-arg-info");
+var kernel2=program2.createKernel("blur");
+kernel2.setArgs([src, dst, W, H]);
+var hits=WebCL.getWorkSizeStats().hits;
+queue.enqueueNDRangeKernel(kernel2, 2, null, [W, H]);
+queue.finish();
+if(WebCL.getWorkSizeStats().hits!==hits+1)
+  throw new Error("a launch without locals should use the reloaded local sizes");
+kernel2.release();
+program2.release();
+
+WebCL.clearWorkSizes();
+if(fs.existsSync(file))
+  throw new Error("clearWorkSizes() should remove "+file);
+
+src.release();
+dst.release();
+kernel.release();
+program.release();
+queue.release();
+ctx.release();
@@ -80,6 +80,21 @@ function isArray(obj) {
   return Object.prototype.toString.call(obj) === '[object Array]';
 }
 
+// sizes and offsets may be Numbers or BigInts. Natives take doubles, which
+// hold every byte count exactly up to 2^53.
+function isSize(v) {
+  return typeof v === 'number' || typeof v === 'bigint';
+}
+
+function toSize(v) {
+  if (typeof v === 'bigint') {
+    if (v < 0 || v > Number.MAX_SAFE_INTEGER)
+      throw new RangeError('size '+v+' out of range');
+    return Number(v);
+  }
+  return v;
+}
+
 var _getPlatforms = cl.getPlatforms;
 cl.getPlatforms = function () {
   if (!(arguments.length === 0)) {
@@ -115,8 +130,9 @@ cl.createContext = function (properties, data, callback) {
 
 var _waitForEvents = cl.waitForEvents;
 cl.waitForEvents = function (events, callback) {
-  if (!(arguments.length === 1 && typeof events === 'object' )) {
-    throw new TypeError('Expected waitForEvents(WebCLEvent[] events)');
+  if (!(arguments.length >= 1 && typeof events === 'object' &&
+      (typeof callback === 'undefined' || typeof callback === 'function'))) {
+    throw new TypeError('Expected waitForEvents(WebCLEvent[] events, optional function whenFinished)');
   }
   return _waitForEvents(events, callback);
 }
@@ -126,6 +142,146 @@ cl.releaseAll = function () {
   return _releaseAll();
 }
 
+// Directory of the on-disk program binary cache, null disables the cache.
+// The cache is off unless a directory is given here or in
+// $WEBCL_PROGRAM_CACHE. Programs that #include files or are built with -I
+// options are never cached.
+cl.setProgramCache = function (directory) {
+  if (!(arguments.length === 1 && (typeof directory === 'string' || directory === null))) {
+    throw new TypeError('Expected setProgramCache(String directory or null)');
+  }
+  return cl._setProgramCacheDirectory(directory);
+}
+
+cl.getProgramCacheStats = function () {
+  return cl._getProgramCacheStats();
+}
+
+// removes all cached binaries, returns the number of entries removed
+cl.invalidateProgramCache = function () {
+  return cl._invalidateProgramCache();
+}
+
+// Local work sizes found by WebCLCommandQueue.tuneNDRangeKernel() are
+// saved to this file (null keeps them in memory only) and used by later
+// enqueueNDRangeKernel() calls without locals.
+cl.setWorkSizeFile = function (file) {
+  if (!(arguments.length === 1 && (typeof file === 'string' || file === null))) {
+    throw new TypeError('Expected setWorkSizeFile(String file or null)');
+  }
+  return cl._setWorkSizeFile(file);
+}
+
+cl.getWorkSizeStats = function () {
+  return cl._getWorkSizeStats();
+}
+
+// forgets all tuned local sizes and removes the file
+cl.clearWorkSizes = function () {
+  return cl._clearWorkSizes();
+}
+
+// Builds the programs of a manifest and creates their kernels ahead of the
+// first request:
+//   WebCL.prewarm({
+//     context: ctx,                      // default context of the programs
+//     programs: [ { name, source, options, devices, kernels, context } ],
+//     concurrency: 4,                    // builds in flight
+//     onProgress: function (progress) {}
+//   })
+// Builds run on worker threads (see WebCLProgram.buildAsync). Programs built
+// for all devices of their context are shared with later
+// createCachedProgram(source, options) calls and pinned, so the context's
+// program budget never evicts them. One kernel per name (all kernels if
+// none are listed) is left in their pool for acquireKernel().
+// onProgress receives { done, total, program } after each program, the
+// promise resolves with { elapsed, programs: [ { name, program, fromCache,
+// compileTime, kernelTime, kernels } ] } once everything is built and
+// rejects with an Error carrying that report as err.report if any failed.
+cl.prewarm = function (manifest) {
+  if (!(arguments.length === 1 && manifest && typeof manifest === 'object' &&
+      (isArray(manifest) || isArray(manifest.programs)) &&
+      (typeof manifest.onProgress === 'undefined' || typeof manifest.onProgress === 'function'))) {
+    throw new TypeError('Expected WebCL.prewarm(Object manifest)');
+  }
+  var entries = isArray(manifest) ? manifest : manifest.programs;
+  var concurrency = manifest.concurrency || 4;
+  entries.forEach(function (entry) {
+    if (!(typeof entry.source === 'string' && checkObjectType(entry.context || manifest.context, 'WebCLContext'))) {
+      throw new TypeError('Expected prewarm entries with a string source and a WebCLContext');
+    }
+  });
+
+  var start=process.hrtime();
+  function ms(t) {
+    var dt=process.hrtime(t);
+    return dt[0]*1e3 + dt[1]/1e6;
+  }
+
+  return new Promise(function (resolve, reject) {
+    var report={ elapsed: 0, programs: new Array(entries.length) };
+    var next=0, done=0, failed=false;
+
+    function warm(index) {
+      var entry=entries[index], ctx=entry.context || manifest.context;
+      var result={ name: entry.name || 'program '+index, program: null, fromCache: false,
+                   compileTime: 0, kernelTime: 0, kernels: [] };
+      report.programs[index]=result;
+
+      var program=ctx.createProgram(entry.source), t=process.hrtime();
+      return program.buildAsync(entry.devices, entry.options).then(function (build) {
+        result.compileTime=ms(t);
+        result.fromCache=build.fromCache;
+        result.program=program;
+        if(!entry.devices)
+          ctx.addCachedProgram(program, true);
+
+        t=process.hrtime();
+        var names=entry.kernels || program.createKernelsInProgram().map(function (kernel) {
+          var name=kernel.getInfo(cl.KERNEL_FUNCTION_NAME);
+          kernel.release();
+          return name;
+        });
+        names.forEach(function (name) {
+          program.acquireKernel(name).release();
+        });
+        result.kernelTime=ms(t);
+        result.kernels=names;
+      }, function (err) {
+        result.compileTime=ms(t);
+        result.error=err;
+        failed=true;
+      });
+    }
+
+    function schedule() {
+      if(next>=entries.length) {
+        if(done===entries.length) {
+          report.elapsed=ms(start);
+          if(failed) {
+            var err=new Error('prewarm failed for some programs');
+            err.report=report;
+            reject(err);
+          }
+          else
+            resolve(report);
+        }
+        return;
+      }
+      var index=next++;
+      warm(index).then(function () {
+        done++;
+        if(manifest.onProgress)
+          manifest.onProgress({ done: done, total: entries.length, program: report.programs[index] });
+        schedule();
+      }).catch(reject);
+    }
+
+    for(var i=0;i<concurrency;i++)
+      schedule();
+  });
+}
+
 //////////////////////////////
 //WebCLCommandQueue object
 //////////////////////////////
@@ -140,21 +296,80 @@ cl.WebCLCommandQueue.prototype.getInfo=function (param_name) {
   return this._getInfo(param_name);
 }
 
-cl.WebCLCommandQueue.prototype.enqueueNDRangeKernel=function (kernel, offsets, globals, locals, event_list, event) {
+cl.WebCLCommandQueue.prototype.enqueueNDRangeKernel=function (kernel, workDim, offsets, globals, locals, event_list, event) {
   if (!(arguments.length>= 4 && checkObjectType(kernel, 'WebCLKernel') &&
-      typeof offsets === 'object' && typeof globals === 'object' && typeof locals === 'object' &&
+      typeof workDim === 'number' &&
+      (offsets === null || typeof offsets === 'undefined' || typeof offsets === 'object') &&
+      typeof globals === 'object' &&
+      (locals === null || typeof locals === 'undefined' || typeof locals === 'object') &&
+      (typeof event_list === 'undefined' || typeof event_list === 'object') &&
+      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
+      )) {
+    throw new TypeError('Expected WebCLCommandQueue.enqueueNDRangeKernel(WebCLKernel kernel, uint workDim, ' +
+        'WebCLRange offsets, WebCLRange globals, WebCLRange locals, WebCLEvent[] event_list, WebCLEvent event)');
+  }
+  return this._enqueueNDRangeKernel(kernel, workDim, offsets, globals, locals, event_list, event);
+}
+
+// Runs kernel with its current arguments for the local sizes its device
+// allows and keeps the fastest for these globals. Returns { locals, time,
+// candidates }, times in ns per launch and locals null when the driver's
+// own choice was fastest.
+cl.WebCLCommandQueue.prototype.tuneNDRangeKernel=function (kernel, workDim, offsets, globals, iterations) {
+  if (!(arguments.length >= 4 && checkObjectType(kernel, 'WebCLKernel') &&
+      typeof workDim === 'number' &&
+      (offsets === null || typeof offsets === 'undefined' || typeof offsets === 'object') &&
+      typeof globals === 'object' &&
+      (typeof iterations === 'undefined' || typeof iterations === 'number')
+      )) {
+    throw new TypeError('Expected WebCLCommandQueue.tuneNDRangeKernel(WebCLKernel kernel, uint workDim, ' +
+        'WebCLRange offsets, WebCLRange globals, optional uint iterations)');
+  }
+  return this._tuneNDRangeKernel(kernel, workDim, offsets, globals, iterations);
+}
+
+// Launch shape of kernel over extent on this queue's device: locals are
+// the kernel's required ones, the given ones if the kernel can use them,
+// the tuned ones or else a power-of-two group of up to 256 work-items, and
+// globals are extent padded to a multiple of locals. Returns { globals,
+// locals }.
+cl.WebCLCommandQueue.prototype.planNDRange=function (kernel, workDim, extent, locals) {
+  if (!(arguments.length >= 3 && checkObjectType(kernel, 'WebCLKernel') &&
+      typeof workDim === 'number' && typeof extent === 'object' &&
+      (locals === null || typeof locals === 'undefined' || typeof locals === 'object')
+      )) {
+    throw new TypeError('Expected WebCLCommandQueue.planNDRange(WebCLKernel kernel, uint workDim, ' +
+        'WebCLRange extent, optional WebCLRange locals)');
+  }
+  return this._planNDRange(kernel, workDim, extent, locals);
+}
+
+// Launches kernel over extent, which need not be a multiple of any work-group
+// size, with the globals of planNDRange(). The kernel gets the true extent
+// in argument extentArg (an index or a name), either as an integer vector
+// or as workDim integer arguments in a row, and must skip work-items past it.
+cl.WebCLCommandQueue.prototype.enqueuePaddedNDRangeKernel=function (kernel, workDim, offsets, extent, extentArg, event_list, event) {
+  if (!(arguments.length >= 5 && checkObjectType(kernel, 'WebCLKernel') &&
+      typeof workDim === 'number' &&
+      (offsets === null || typeof offsets === 'undefined' || typeof offsets === 'object') &&
+      typeof extent === 'object' &&
+      (typeof extentArg === 'number' || typeof extentArg === 'string') &&
       (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
       )) {
-    throw new TypeError('Expected WebCLCommandQueue.enqueueNDRangeKernel(WebCLKernel kernel, int[3] offsets, int[3] globals, int[3] locals, WebCLEvent[] event_list, WebCLEvent event)');
+    throw new TypeError('Expected WebCLCommandQueue.enqueuePaddedNDRangeKernel(WebCLKernel kernel, uint workDim, ' +
+        'WebCLRange offsets, WebCLRange extent, uint or String extentArg, WebCLEvent[] event_list, WebCLEvent event)');
+  }
+  if (typeof extentArg === 'string') {
+    extentArg = kernel.getArgIndex(extentArg);
   }
-  return this._enqueueNDRangeKernel(kernel, offsets, globals, locals, event_list, event);
+  return this._enqueuePaddedNDRangeKernel(kernel, workDim, offsets, extent, extentArg, event_list, event);
 }
 
 cl.WebCLCommandQueue.prototype.enqueueTask=function (kernel, event_list, event) {
   if (!(arguments.length >= 1 && checkObjectType(kernel, 'WebCLKernel') &&
     (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
     )) {
     throw new TypeError('Expected WebCLCommandQueue.enqueueTask(WebCLKernel kernel, WebCLEvent[] event_list, WebCLEvent event)');
   }
@@ -165,15 +380,15 @@ cl.WebCLCommandQueue.prototype.enqueueWriteBuffer=function (buffer, blocking_wri
     if (!(arguments.length >= 5 &&
       checkObjectType(buffer, 'WebCLBuffer') &&
       (typeof blocking_write === 'boolean' || typeof blocking_write === 'number') &&
-      typeof offset === 'number' && typeof cb === 'number' &&
+      isSize(offset) && isSize(cb) &&
       typeof ptr === 'object' &&
       (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
       )) {
         throw new TypeError('Expected WebCLCommandQueue.enqueueWriteBuffer(WebCLBuffer buffer, boolean blocking_write, ' +
             'uint offset, uint cb, ArrayBuffer ptr, WebCLEvent[] event_list, WebCLEvent event)');
     }
-    return this._enqueueWriteBuffer(buffer, blocking_write, offset, cb, ptr, event_list, event);
+    return this._enqueueWriteBuffer(buffer, blocking_write, toSize(offset), toSize(cb), ptr, event_list, event);
 }
 
 cl.WebCLCommandQueue.prototype.enqueueReadBuffer=function (buffer, blocking_read, offset, cb, ptr, event_list, event) {
@@ -181,15 +396,15 @@ cl.WebCLCommandQueue.prototype.enqueueReadBuffer=function (buffer, blocking_read
   if (!(arguments.length >= 5 &&
     checkObjectType(buffer, 'WebCLBuffer') &&
     (typeof blocking_read === 'boolean' || typeof blocking_read === 'number') &&
-    typeof offset === 'number' && typeof cb === 'number' &&
+    isSize(offset) && isSize(cb) &&
     typeof ptr === 'object' &&
     (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
     )) {
       throw new TypeError('Expected WebCLCommandQueue.enqueueReadBuffer(WebCLBuffer buffer, boolean blocking_read, ' +
           'uint offset, uint cb, ArrayBuffer ptr, WebCLEvent[] event_list, WebCLEvent event)');
     }
-    return this._enqueueReadBuffer(buffer, blocking_read, offset, cb, ptr, event_list, event);
+    return this._enqueueReadBuffer(buffer, blocking_read, toSize(offset), toSize(cb), ptr, event_list, event);
 }
 
 cl.WebCLCommandQueue.prototype.enqueueCopyBuffer=function (src_buffer, dst_buffer,
@@ -198,16 +413,16 @@ cl.WebCLCommandQueue.prototype.enqueueCopyBuffer=function (src_buffer, dst_buffe
   if (!(arguments.length >= 5 && 
       checkObjectType(src_buffer, 'WebCLBuffer') &&
       checkObjectType(dst_buffer, 'WebCLBuffer') &&
-      typeof src_offset === 'number' && typeof dst_offset === 'number' && typeof size === 'number' &&
+      isSize(src_offset) && isSize(dst_offset) && isSize(size) &&
       (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
   )) {
     throw new TypeError('Expected WebCLCommandQueue.enqueueCopyBuffer(WebCLBuffer src_buffer, WebCLBuffer dst_buffer, ' +
         'int src_offset, int dst_offset, int size, ' +
         'WebCLEvent[] event_list, WebCLEvent event)');
   }
   return this._enqueueCopyBuffer(src_buffer, dst_buffer,
-                                 src_offset, dst_offset, size,
+                                 toSize(src_offset), toSize(dst_offset), toSize(size),
                                  event_list, event);
 }
 
@@ -224,7 +439,7 @@ cl.WebCLCommandQueue.prototype.enqueueWriteBufferRect=function (buffer, blocking
       typeof host_row_pitch === 'number' && typeof host_slice_pitch === 'number' &&
       typeof ptr === 'object' &&
       (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
       )) {
         throw new TypeError('Expected WebCLCommandQueue.enqueueWriteBufferRect(WebCLBuffer memory_object, ' +
             'boolean blocking_write, uint[3] buffer_origin, uint[3] host_origin, uint[3] region, ' +
@@ -253,7 +468,7 @@ cl.WebCLCommandQueue.prototype.enqueueReadBufferRect=function (buffer, blocking_
       typeof host_row_pitch === 'number' && typeof host_slice_pitch === 'number' &&
       typeof ptr === 'object' &&
       (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
       )) {
         throw new TypeError('Expected WebCLCommandQueue.enqueueReadBufferRect(WebCLBuffer buffer, ' +
             'boolean blocking_write, uint[3] buffer_origin, uint[3] host_origin, uint[3] region, ' +
@@ -280,7 +495,7 @@ cl.WebCLCommandQueue.prototype.enqueueCopyBufferRect=function (src_buffer, dst_b
     typeof src_row_pitch === 'number' && typeof src_slice_pitch === 'number' &&
     typeof dst_row_pitch === 'number' && typeof dst_slice_pitch === 'number' &&
     (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
   )) {
     throw new TypeError('Expected WebCLCommandQueue.enqueueCopyBufferRect(WebCLBuffer src_buffer, WebCLBuffer dst_buffer, ' +
         'uint[3] src_origin, uint[3] dst_origin, uint[3] region, ' +
@@ -305,7 +520,7 @@ cl.WebCLCommandQueue.prototype.enqueueWriteImage=function (image, blocking_write
     typeof slice_pitch === 'number' &&
     typeof ptr === 'object' &&
     (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
   )) {
     throw new TypeError('Expected WebCLCommandQueue.enqueueWriteImage(WebCLImage image, boolean blocking_write, ' +
       'int[3] origin, int[3] region, int row_pitch, int slice_pitch, ArrayBuffer ptr, WebCLEvent[] event_list, WebCLEvent event)');
@@ -323,7 +538,7 @@ cl.WebCLCommandQueue.prototype.enqueueReadImage=function (image, blocking_read,
     typeof slice_pitch === 'number' &&
     typeof ptr === 'object' &&
     (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
   )) {
     throw new TypeError('Expected WebCLCommandQueue.enqueueReadImage(WebCLImage image, boolean blocking_write, ' +
         'uint[3] region, uint row_pitch, uint slice_pitch, ' +
@@ -341,7 +556,7 @@ cl.WebCLCommandQueue.prototype.enqueueCopyImage=function (src_image, dst_image,
     typeof dst_origin === 'object' &&
     typeof region === 'object' &&
     (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
   )) {
     throw new TypeError('Expected WebCLCommandQueue.enqueueCopyImage(WebCLImage src_image, WebCLImage dst_image, ' +
         'uint[3] src_origin, uint[3] dst_origin, uint[3] region, ' +
@@ -359,7 +574,7 @@ cl.WebCLCommandQueue.prototype.enqueueCopyImageToBuffer=function (src_image, dst
     typeof region === 'object' &&
     typeof dst_offset === 'number' &&
     (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
   )) {
     throw new TypeError('Expected WebCLCommandQueue.enqueueCopyImageToBuffer(WebCLImage src_image, WebCLBuffer dst_buffer, ' +
         'uint[3] src_origin, uint[3] region, uint dst_offset, ' +
@@ -377,7 +592,7 @@ cl.WebCLCommandQueue.prototype.enqueueCopyBufferToImage=function (src_buffer, ds
     typeof dst_origin === 'object' &&
     typeof region === 'object' &&
     (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
   )) {
     throw new TypeError('Expected WebCLCommandQueue.enqueueCopyBufferToImage(WebCLBuffer src_buffer, WebCLImage dst_image, ' +
         'uint src_offset, uint[3] dst_origin, uint[4] region, WebCLEvent[] event_list, WebCLEvent event)');
@@ -390,15 +605,37 @@ cl.WebCLCommandQueue.prototype.enqueueMapBuffer=function (memory_object, blockin
     checkObjectType(memory_object, 'WebCLBuffer') &&
     (typeof blocking === 'boolean' || typeof blocking === 'number') &&
     typeof flags === 'number' && 
-    typeof offset === 'number' && 
-    typeof size === 'number' && 
+    isSize(offset) &&
+    isSize(size) &&
     (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
   )) {
     throw new TypeError('Expected WebCLCommandQueue.enqueueMapBuffer(WebCLBuffer memory_object, boolean blocking, CLenum flags, uint offset, uint size, WebCLEvent[] event_list, WebCLEvent event)');
   }
 
-  return this._enqueueMapBuffer(memory_object, blocking, flags, offset, size, event_list, event);
+  return this._enqueueMapBuffer(memory_object, blocking, flags, toSize(offset), toSize(size), event_list, event);
+}
+
+// Maps a buffer created with MEM_USE_HOST_PTR or MEM_ALLOC_HOST_PTR, which
+// drivers map in place without copying, for per frame map/unmap loops.
+// The view stays attached after enqueueUnmapMemObject and the next map of
+// the same region returns it again, as long as the driver maps it at the
+// same address; it is detached when the address changes or the buffer is
+// released. It may only be accessed while mapped.
+cl.WebCLCommandQueue.prototype.enqueueMapBufferPersistent=function (memory_object, blocking, flags, offset, size, event_list, event) {
+  if (!(arguments.length >= 5 &&
+    checkObjectType(memory_object, 'WebCLBuffer') &&
+    (typeof blocking === 'boolean' || typeof blocking === 'number') &&
+    typeof flags === 'number' &&
+    isSize(offset) &&
+    isSize(size) &&
+    (typeof event_list === 'undefined' || typeof event_list === 'object') &&
+    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
+  )) {
+    throw new TypeError('Expected WebCLCommandQueue.enqueueMapBufferPersistent(WebCLBuffer memory_object, boolean blocking, CLenum flags, uint offset, uint size, WebCLEvent[] event_list, WebCLEvent event)');
+  }
+
+  return this._enqueueMapBuffer(memory_object, blocking, flags, toSize(offset), toSize(size), event_list, event, true);
 }
 
 cl.WebCLCommandQueue.prototype.enqueueMapImage=function (memory_object, blocking, flags, origin, region, event_list, event) {
@@ -409,7 +646,7 @@ cl.WebCLCommandQueue.prototype.enqueueMapImage=function (memory_object, blocking
     typeof origin === 'number' && 
     typeof region === 'object' && 
     (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
   )) {
     throw new TypeError('Expected WebCLCommandQueue.enqueueMapImage(WebCLImage memory_object, boolean blocking, CLenum flags, uint origin, WebCLRegion region, WebCLEvent[] event_list, WebCLEvent event)');
   }
@@ -421,9 +658,9 @@ cl.WebCLCommandQueue.prototype.enqueueUnmapMemObject=function (memory_object, re
     (checkObjectType(memory_object, 'WebCLBuffer') || checkObjectType(memory_object, 'WebCLImage')) &&
     typeof region === 'object' && 
     (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+    (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
   )) {
-    throw new TypeError('Expected WebCLCommandQueue.enqueueUnmapMemObject(WebCLMemoryObject memory_object, ArrayBuffer region, WebCLEvent[] event_list, WebCLEvent event)');
+    throw new TypeError('Expected WebCLCommandQueue.enqueueUnmapMemObject(WebCLMemoryObject memory_object, ArrayBufferView region, WebCLEvent[] event_list, WebCLEvent event)');
   }
   return this._enqueueUnmapMemObject(memory_object, region, event_list, event);
 }
@@ -431,7 +668,7 @@ cl.WebCLCommandQueue.prototype.enqueueUnmapMemObject=function (memory_object, re
 cl.WebCLCommandQueue.prototype.enqueueMarker=function (event_list, event) {
   if (!(arguments.length >= 0 &&
       (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
       )) {
     throw new TypeError('Expected WebCLCommandQueue.enqueueMarker(WebCLEvent[] event_list, WebCLEvent event)');
   }
@@ -449,13 +686,61 @@ cl.WebCLCommandQueue.prototype.enqueueWaitForEvents=function (event_wait_list) {
 cl.WebCLCommandQueue.prototype.enqueueBarrier=function (event_list, event) {
   if (!(arguments.length >= 0 &&
       (typeof event_list === 'undefined' || typeof event_list === 'object') &&
-      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
       )) {
     throw new TypeError('Expected WebCLCommandQueue.enqueueBarrier(WebCLEvent[] event_list, WebCLEvent event)');
   }
   return this._enqueueBarrier(event_list, event);
 }
 
+cl.WebCLCommandQueue.prototype.submit=function (list, event_list, event) {
+  if (!(arguments.length >= 1 && checkObjectType(list, 'WebCLCommandList') &&
+      (typeof event_list === 'undefined' || typeof event_list === 'object') &&
+      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
+      )) {
+    throw new TypeError('Expected WebCLCommandQueue.submit(WebCLCommandList list, WebCLEvent[] event_list, WebCLEvent event)');
+  }
+  return this._submit(list, event_list, event);
+}
+
+cl.WebCLCommandQueue.prototype.beginCapture=function () {
+  if (!(arguments.length === 0)) {
+    throw new TypeError('Expected WebCLCommandQueue.beginCapture()');
+  }
+  return this._beginCapture();
+}
+
+cl.WebCLCommandQueue.prototype.endCapture=function () {
+  if (!(arguments.length === 0)) {
+    throw new TypeError('Expected WebCLCommandQueue.endCapture()');
+  }
+  return this._endCapture();
+}
+
+cl.WebCLCommandQueue.prototype.replay=function (graph, event_list, event) {
+  if (!(arguments.length >= 1 && checkObjectType(graph, 'WebCLCommandGraph') &&
+      (typeof event_list === 'undefined' || typeof event_list === 'object') &&
+      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
+      )) {
+    throw new TypeError('Expected WebCLCommandQueue.replay(WebCLCommandGraph graph, WebCLEvent[] event_list, WebCLEvent event)');
+  }
+  return this._replay(graph, event_list, event);
+}
+
+// Blocking reads and writes of at least options.threshold bytes from
+// host arrays are copied through options.chunks pinned buffers of
+// options.chunkSize bytes. Omitted options are left unchanged. threshold 0
+// disables staging, as is the default on devices sharing host memory.
+cl.WebCLCommandQueue.prototype.setStagingOptions=function (options) {
+  if (!(arguments.length === 1 && typeof options === 'object' && options !== null &&
+      (typeof options.threshold === 'undefined' || isSize(options.threshold)) &&
+      (typeof options.chunkSize === 'undefined' || isSize(options.chunkSize)) &&
+      (typeof options.chunks === 'undefined' || typeof options.chunks === 'number'))) {
+    throw new TypeError('Expected WebCLCommandQueue.setStagingOptions({ int threshold, int chunkSize, int chunks })');
+  }
+  return this._setStagingOptions(toSize(options.threshold), toSize(options.chunkSize), options.chunks);
+}
+
 cl.WebCLCommandQueue.prototype.flush=function () {
   if (!(arguments.length === 0)) {
     throw new TypeError('Expected WebCLCommandQueue.flush()');
@@ -464,8 +749,8 @@ cl.WebCLCommandQueue.prototype.flush=function () {
 }
 
 cl.WebCLCommandQueue.prototype.finish=function (callback) {
-  if (!(arguments.length === 0)) {
-    throw new TypeError('Expected WebCLCommandQueue.finish()');
+  if (!(typeof callback === 'undefined' || typeof callback === 'function')) {
+    throw new TypeError('Expected WebCLCommandQueue.finish(optional function whenFinished)');
   }
   return this._finish(callback);
 }
@@ -477,7 +762,7 @@ cl.WebCLCommandQueue.prototype.enqueueAcquireGLObjects=function (mem_objects, ev
   if (!(arguments.length >= 1 && 
       typeof mem_objects === 'object' && 
       (typeof event_list==='undefined' || typeof event_list === 'object') &&
-      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
   )) {
     throw new TypeError('Expected WebCLEvent WebCLGL.enqueueAcquireGLObjects(WebCLMemoryObject[] mem_objects, WebCLEvent[] event_list, WebCLEvent event)');
   }
@@ -491,13 +776,154 @@ cl.WebCLCommandQueue.prototype.enqueueReleaseGLObjects=function (mem_objects, ev
   if (!(arguments.length >= 1 && 
       typeof mem_objects === 'object' && 
       (typeof event_list==='undefined' || typeof event_list === 'object') &&
-      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent'))
+      (typeof event === 'undefined' || checkObjectType(event, 'WebCLEvent') || typeof event === 'function')
   )) {
     throw new TypeError('Expected WebCLEvent WebCLGL.enqueueReleaseGLObjects(WebCLMemoryObject[] mem_objects, WebCLEvent[] event_list, WebCLEvent event)');
   }
   return this._enqueueReleaseGLObjects(mem_objects, event_list, event);
 }
 
+// Promise returning variants of the enqueue methods, e.g.
+//   queue.enqueueReadBufferAsync(buffer, false, 0, size, data).then(...)
+// take the same arguments minus the event. The command is given a native
+// completion callback instead of a WebCLEvent, the promise resolves with the
+// value returned by the enqueue (the mapped region for map calls) once the
+// command has completed, and rejects with the error status otherwise.
+// Read and write transfers are always non-blocking, their host array is kept
+// alive natively until the promise settles.
+function makeAsync(enqueue, event_index) {
+  return function () {
+    var queue=this, args=Array.prototype.slice.call(arguments, 0, event_index);
+    return new Promise(function (resolve, reject) {
+      var result;
+      args[event_index]=function (status) {
+        if(status<0) {
+          var err=new Error('EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST');
+          err.code=status;
+          reject(err);
+        }
+        else
+          resolve(result);
+      };
+      result=enqueue.apply(queue, args);
+    });
+  }
+}
+
+if (typeof Promise !== 'undefined') {
+  var asyncEnqueues = {
+    enqueueNDRangeKernel: 6,
+    enqueueTask: 2,
+    enqueueWriteBuffer: 6,
+    enqueueReadBuffer: 6,
+    enqueueCopyBuffer: 6,
+    enqueueWriteBufferRect: 11,
+    enqueueReadBufferRect: 11,
+    enqueueCopyBufferRect: 10,
+    enqueueWriteImage: 8,
+    enqueueReadImage: 8,
+    enqueueCopyImage: 6,
+    enqueueCopyImageToBuffer: 6,
+    enqueueCopyBufferToImage: 6,
+    enqueueMapBuffer: 6,
+    enqueueMapImage: 6,
+    enqueueUnmapMemObject: 3,
+    enqueueBarrier: 1,
+    enqueueAcquireGLObjects: 2,
+    enqueueReleaseGLObjects: 2,
+    submit: 2,
+    replay: 2
+  };
+  for (var name in asyncEnqueues) {
+    cl.WebCLCommandQueue.prototype[name+'Async']=makeAsync(cl.WebCLCommandQueue.prototype[name], asyncEnqueues[name]);
+  }
+
+  // the native marker only takes its event
+  cl.WebCLCommandQueue.prototype.enqueueMarkerAsync=makeAsync(cl.WebCLCommandQueue.prototype._enqueueMarker, 0);
+}
+
+//////////////////////////////
+//WebCLCommandList object
+//////////////////////////////
+cl.WebCLCommandList.prototype.release=function () {
+  return this._release();
+}
+
+cl.WebCLCommandList.prototype.clear=function () {
+  return this._clear();
+}
+
+cl.WebCLCommandList.prototype.enqueueWriteBuffer=function (buffer, blocking_write, offset, cb, ptr) {
+  if (!(arguments.length === 5 &&
+      checkObjectType(buffer, 'WebCLBuffer') &&
+      (typeof blocking_write === 'boolean' || typeof blocking_write === 'number') &&
+      isSize(offset) && isSize(cb) &&
+      typeof ptr === 'object'
+      )) {
+    throw new TypeError('Expected WebCLCommandList.enqueueWriteBuffer(WebCLBuffer buffer, boolean blocking_write, ' +
+        'uint offset, uint cb, ArrayBuffer ptr)');
+  }
+  return this._enqueueWriteBuffer(buffer, blocking_write, toSize(offset), toSize(cb), ptr);
+}
+
+cl.WebCLCommandList.prototype.enqueueReadBuffer=function (buffer, blocking_read, offset, cb, ptr) {
+  if (!(arguments.length === 5 &&
+      checkObjectType(buffer, 'WebCLBuffer') &&
+      (typeof blocking_read === 'boolean' || typeof blocking_read === 'number') &&
+      isSize(offset) && isSize(cb) &&
+      typeof ptr === 'object'
+      )) {
+    throw new TypeError('Expected WebCLCommandList.enqueueReadBuffer(WebCLBuffer buffer, boolean blocking_read, ' +
+        'uint offset, uint cb, ArrayBuffer ptr)');
+  }
+  return this._enqueueReadBuffer(buffer, blocking_read, toSize(offset), toSize(cb), ptr);
+}
+
+cl.WebCLCommandList.prototype.enqueueCopyBuffer=function (src_buffer, dst_buffer, src_offset, dst_offset, size) {
+  if (!(arguments.length === 5 &&
+      checkObjectType(src_buffer, 'WebCLBuffer') &&
+      checkObjectType(dst_buffer, 'WebCLBuffer') &&
+      isSize(src_offset) && isSize(dst_offset) && isSize(size)
+      )) {
+    throw new TypeError('Expected WebCLCommandList.enqueueCopyBuffer(WebCLBuffer src_buffer, WebCLBuffer dst_buffer, ' +
+        'uint src_offset, uint dst_offset, uint size)');
+  }
+  return this._enqueueCopyBuffer(src_buffer, dst_buffer, toSize(src_offset), toSize(dst_offset), toSize(size));
+}
+
+cl.WebCLCommandList.prototype.enqueueNDRangeKernel=function (kernel, workDim, offsets, globals, locals) {
+  if (!(arguments.length >= 4 && checkObjectType(kernel, 'WebCLKernel') &&
+      typeof workDim === 'number' &&
+      (offsets === null || typeof offsets === 'object') && typeof globals === 'object' &&
+      (locals === null || typeof locals === 'undefined' || typeof locals === 'object')
+      )) {
+    throw new TypeError('Expected WebCLCommandList.enqueueNDRangeKernel(WebCLKernel kernel, uint workDim, ' +
+        'uint[] offsets, uint[] globals, optional uint[] locals)');
+  }
+  return this._enqueueNDRangeKernel(kernel, workDim, offsets, globals, locals);
+}
+
+//////////////////////////////
+//WebCLCommandGraph object
+//////////////////////////////
+cl.WebCLCommandGraph.prototype.release=function () {
+  return this._release();
+}
+
+cl.WebCLCommandGraph.prototype.getSlot=function (slot) {
+  if (!(arguments.length === 1 && typeof slot === 'number')) {
+    throw new TypeError('Expected WebCLCommandGraph.getSlot(uint slot)');
+  }
+  return this._getSlot(slot);
+}
+
+cl.WebCLCommandGraph.prototype.setSlot=function (slot, buffer) {
+  if (!(arguments.length === 2 && typeof slot === 'number' && checkObjectType(buffer, 'WebCLBuffer'))) {
+    throw new TypeError('Expected WebCLCommandGraph.setSlot(uint slot, WebCLBuffer buffer)');
+  }
+  return this._setSlot(slot, buffer);
+}
+
 //////////////////////////////
 //WebCLDevice object
 //////////////////////////////
@@ -585,6 +1011,41 @@ cl.WebCLContext.prototype.createProgram=function (sources) {
   return this._createProgram(sources);
 }
 
+// Built program shared by every caller passing the same source and options.
+// Each call returns its own handle, to be released once; released handles
+// can't be used any more, while the program stays built until the context's
+// program budget is exceeded.
+cl.WebCLContext.prototype.createCachedProgram=function (source, options) {
+  if (!(arguments.length >= 1 && typeof source === 'string' &&
+      (options==null || typeof options === 'string'))) {
+    throw new TypeError('Expected WebCLContext.createCachedProgram(string source, optional string options)');
+  }
+  return this._createCachedProgram(source, options);
+}
+
+// Shares a program built from source for all devices of the context (e.g.
+// with buildAsync) with later createCachedProgram() calls for its source and
+// options. Pinned programs are never evicted by the program budget. Returns
+// false if the program can't be shared or one is already.
+cl.WebCLContext.prototype.addCachedProgram=function (program, pinned) {
+  if (!(arguments.length >= 1 && checkObjectType(program, 'WebCLProgram') &&
+      (typeof pinned === 'undefined' || typeof pinned === 'boolean'))) {
+    throw new TypeError('Expected WebCLContext.addCachedProgram(WebCLProgram program, optional boolean pinned)');
+  }
+  return this._addCachedProgram(program, !!pinned);
+}
+
+cl.WebCLContext.prototype.setProgramLibraryBudget=function (maxBytes) {
+  if (!(arguments.length === 1 && isSize(maxBytes))) {
+    throw new TypeError('Expected WebCLContext.setProgramLibraryBudget(int maxBytes)');
+  }
+  return this._setProgramLibraryBudget(toSize(maxBytes));
+}
+
+cl.WebCLContext.prototype.getProgramLibraryStats=function () {
+  return this._getProgramLibraryStats();
+}
+
 // TODO
 cl.WebCLContext.prototype.createProgramWithBinaries=function (devices, binaries) {
   if (!(arguments.length === 2 && typeof devices === 'object' && typeof binaries === 'object')) {
@@ -602,11 +1063,56 @@ cl.WebCLContext.prototype.createCommandQueue=function (device, properties) {
 }
 
 cl.WebCLContext.prototype.createBuffer=function (flags, size, host_ptr) {
-  if (!(arguments.length >= 2 && typeof flags === 'number' && typeof size === 'number' && 
+  if (!(arguments.length >= 2 && typeof flags === 'number' && isSize(size) &&
       (host_ptr === null || typeof host_ptr === 'undefined' || typeof host_ptr === 'object') )) {
     throw new TypeError('Expected WebCLContext.createBuffer(CLenum flags, int size, optional ArrayBuffer host_ptr)');
   }
-  return this._createBuffer(flags, size, host_ptr);
+  return this._createBuffer(flags, toSize(size), host_ptr);
+}
+
+// Buffers from createPooledBuffer() are rounded up to a power of two size
+// class and go back to the context's pool on release(), to be handed out
+// again by the next request of the same class and flags. Release them only
+// once the commands using them have finished and no command list refers to
+// them; buffers that are mapped or have sub-buffers are not recycled.
+cl.WebCLContext.prototype.createPooledBuffer=function (flags, size) {
+  if (!(arguments.length === 2 && typeof flags === 'number' && isSize(size))) {
+    throw new TypeError('Expected WebCLContext.createPooledBuffer(CLenum flags, int size)');
+  }
+  return this._createPooledBuffer(flags, toSize(size));
+}
+
+// limits.maxBytes caps the bytes kept in the pool, limits.maxBuffersPerClass
+// the buffers kept per size class. 0 or undefined means unlimited.
+cl.WebCLContext.prototype.setBufferPoolLimits=function (limits) {
+  if (!(arguments.length === 1 && typeof limits === 'object' && limits !== null &&
+      (typeof limits.maxBytes === 'undefined' || isSize(limits.maxBytes)) &&
+      (typeof limits.maxBuffersPerClass === 'undefined' || typeof limits.maxBuffersPerClass === 'number'))) {
+    throw new TypeError('Expected WebCLContext.setBufferPoolLimits({ int maxBytes, int maxBuffersPerClass })');
+  }
+  return this._setBufferPoolLimits(toSize(limits.maxBytes || 0), limits.maxBuffersPerClass || 0);
+}
+
+cl.WebCLContext.prototype.trimBufferPool=function (maxBytes) {
+  if (!(typeof maxBytes === 'undefined' || isSize(maxBytes))) {
+    throw new TypeError('Expected WebCLContext.trimBufferPool(optional int maxBytes)');
+  }
+  return this._trimBufferPool(toSize(maxBytes || 0));
+}
+
+cl.WebCLContext.prototype.getBufferPoolStats=function () {
+  return this._getBufferPoolStats();
+}
+
+// One buffer of about size bytes, carved into sub-buffers by
+// WebCLBufferArena.allocate(). minBlock defaults to the devices'
+// MEM_BASE_ADDR_ALIGN.
+cl.WebCLContext.prototype.createBufferArena=function (flags, size, minBlock) {
+  if (!(arguments.length >= 2 && typeof flags === 'number' && isSize(size) &&
+      (typeof minBlock === 'undefined' || typeof minBlock === 'number'))) {
+    throw new TypeError('Expected WebCLContext.createBufferArena(CLenum flags, int size, optional int minBlock)');
+  }
+  return this._createBufferArena(flags, toSize(size), minBlock);
 }
 
 cl.WebCLContext.prototype.createImage=function (flags, descriptor, host_ptr) {
@@ -636,6 +1142,13 @@ cl.WebCLContext.prototype.createUserEvent=function () {
   return this._createUserEvent();
 }
 
+cl.WebCLContext.prototype.createCommandList=function () {
+  if (!(arguments.length === 0)) {
+    throw new TypeError('Expected WebCLContext.createCommandList()');
+  }
+  return this._createCommandList();
+}
+
 cl.WebCLContext.prototype.getSupportedImageFormats=function (flags, image_type) {
   if (!(arguments.length === 2 && typeof flags === 'number' && typeof image_type === 'number')) {
     throw new TypeError('Expected WebCLContext.getSupportedImageFormats(CLenum flags, CLenum image_type)');
@@ -713,6 +1226,67 @@ cl.WebCLEvent.prototype.setCallback=function (execution_status, fct, args) {
   return this._setCallback(execution_status, fct, args);
 }
 
+//////////////////////////////
+//WebCLUserEvent object
+//////////////////////////////
+cl.WebCLUserEvent.prototype.release=function () {
+  return this._release();
+}
+
+cl.WebCLUserEvent.prototype.getInfo=function (param_name) {
+  if (!(arguments.length === 1 && typeof param_name === 'number')) {
+    throw new TypeError('Expected WebCLUserEvent.getInfo(CLenum param_name)');
+  }
+  return this._getInfo(param_name);
+}
+
+cl.WebCLUserEvent.prototype.getProfilingInfo=function (param_name) {
+  if (!(arguments.length === 1 && typeof param_name === 'number')) {
+    throw new TypeError('Expected WebCLUserEvent.getProfilingInfo(CLenum param_name)');
+  }
+  return this._getProfilingInfo(param_name);
+}
+
+cl.WebCLUserEvent.prototype.setUserEventStatus=function (execution_status) {
+  if (!(arguments.length === 1 && typeof execution_status === 'number')) {
+    throw new TypeError('Expected WebCLUserEvent.setUserEventStatus(CLenum execution_status)');
+  }
+  return this._setStatus(execution_status);
+}
+
+cl.WebCLUserEvent.prototype.setCallback=function (execution_status, fct, args) {
+  if (!(arguments.length >= 2 && typeof execution_status === 'number' &&
+      typeof fct === 'function')) {
+    throw new TypeError('Expected WebCLUserEvent.setCallback(CLenum execution_status, function callback, any args)');
+  }
+  return this._setCallback(execution_status, fct, args);
+}
+
+//////////////////////////////
+//WebCLEventList object
+//////////////////////////////
+cl.WebCLEventList.prototype.release=function () {
+  return this._release();
+}
+
+cl.WebCLEventList.prototype.set=function (events) {
+  if (!(arguments.length === 1 && isArray(events))) {
+    throw new TypeError('Expected WebCLEventList.set(WebCLEvent[] events)');
+  }
+  return this._set(events);
+}
+
+cl.WebCLEventList.prototype.add=function (event) {
+  if (!(arguments.length === 1 && (checkObjectType(event, 'WebCLEvent') || checkObjectType(event, 'WebCLUserEvent')))) {
+    throw new TypeError('Expected WebCLEventList.add(WebCLEvent event)');
+  }
+  return this._add(event);
+}
+
+cl.WebCLEventList.prototype.clear=function () {
+  return this._clear();
+}
+
 //////////////////////////////
 //WebCLKernel object
 //////////////////////////////
@@ -743,6 +1317,121 @@ cl.WebCLKernel.prototype.setArg=function (index, value, type) {
   return this._setArg(index, value, type);
 }
 
+// Sets all arguments of the kernel in one call. values[i] is anything
+// setArg() takes for argument i, or a number converted to its scalar type.
+// Arguments left undefined (or null) are read from packed, an ArrayBuffer
+// laid out as given by getArgLayout(), if present; otherwise they keep their
+// current value.
+cl.WebCLKernel.prototype.setArgs=function (values, packed) {
+  if (!(arguments.length >= 1 && isArray(values) &&
+      (packed==null || typeof packed === 'object'))) {
+    throw new TypeError('Expected WebCLKernel.setArgs(any[] values, optional ArrayBuffer packed)');
+  }
+  return this._setArgs(values, packed);
+}
+
+// { size, args: [ { index, offset, size, type } ] }: offset of each by-value
+// scalar or vector argument in the packed buffer of setArgs()
+cl.WebCLKernel.prototype.getArgLayout=function () {
+  return this._getArgLayout();
+}
+
+// index of the argument named name, -1 if there is none. Argument names
+// need a program built with -cl-kernel-arg-info on some platforms.
+cl.WebCLKernel.prototype.getArgIndex=function (name) {
+  if (!(arguments.length === 1 && typeof name === 'string')) {
+    throw new TypeError('Expected WebCLKernel.getArgIndex(String name)');
+  }
+  return this._getArgIndex(name);
+}
+
+// Sets arguments by name: kernel.bind({ out: buffer, scale: 2 })
+cl.WebCLKernel.prototype.bind=function (values) {
+  if (!(arguments.length === 1 && values && typeof values === 'object')) {
+    throw new TypeError('Expected WebCLKernel.bind(Object values)');
+  }
+  return this._bind(values);
+}
+
+// Binding of named arguments resolved once, applied with a single setArgs
+// call per launch:
+//   var binding=kernel.createBinding({ out: buffer, n: 1024 });
+//   binding.set('scale', 2).apply();
+cl.WebCLKernel.prototype.createBinding=function (values) {
+  if (!(values==null || typeof values === 'object')) {
+    throw new TypeError('Expected WebCLKernel.createBinding(optional Object values)');
+  }
+  return new WebCLKernelBinding(this, values);
+}
+
+function WebCLKernelBinding(kernel, values) {
+  this.kernel=kernel;
+  this.indices={};
+  this.values=[];
+  for (var name in values) {
+    if (values.hasOwnProperty(name))
+      this.set(name, values[name]);
+  }
+}
+
+WebCLKernelBinding.prototype.set=function (name, value) {
+  var index=this.indices[name];
+  if (index===undefined) {
+    index=this.kernel._getArgIndex(name);
+    if (index<0) {
+      throw new Error('Unknown kernel argument '+name);
+    }
+    this.indices[name]=index;
+  }
+  this.values[index]=value;
+  return this;
+}
+
+WebCLKernelBinding.prototype.apply=function () {
+  return this.kernel._setArgs(this.values);
+}
+
+cl.WebCLKernelBinding=WebCLKernelBinding;
+
+// setArg fast paths, for arguments whose kind is known ahead:
+//   setArgMem(i, buffer or image), setArgSampler(i, sampler),
+//   setArgInt/Uint/Float/Double(i, number), setArgLocal(i, bytes)
+cl.WebCLKernel.prototype.setArgMem=function (index, mem) {
+  if (!(typeof index === 'number' && typeof mem === 'object')) {
+    throw new TypeError('Expected WebCLKernel.setArgMem(int index, WebCLMemoryObject mem)');
+  }
+  return this._setArgMem(index, mem);
+}
+
+cl.WebCLKernel.prototype.setArgSampler=function (index, sampler) {
+  if (!(typeof index === 'number' && typeof sampler === 'object')) {
+    throw new TypeError('Expected WebCLKernel.setArgSampler(int index, WebCLSampler sampler)');
+  }
+  return this._setArgSampler(index, sampler);
+}
+
+function makeSetArgScalar(type) {
+  var setArg=cl.WebCLKernel.prototype['_setArg'+type];
+  return function (index, value) {
+    if (!(typeof index === 'number' && typeof value === 'number')) {
+      throw new TypeError('Expected WebCLKernel.setArg'+type+'(int index, number value)');
+    }
+    return setArg.call(this, index, value);
+  }
+}
+
+var scalarArgTypes = [ 'Int', 'Uint', 'Float', 'Double' ];
+for (var i=0; i<scalarArgTypes.length; i++) {
+  cl.WebCLKernel.prototype['setArg'+scalarArgTypes[i]]=makeSetArgScalar(scalarArgTypes[i]);
+}
+
+cl.WebCLKernel.prototype.setArgLocal=function (index, size) {
+  if (!(typeof index === 'number' && isSize(size))) {
+    throw new TypeError('Expected WebCLKernel.setArgLocal(int index, int size)');
+  }
+  return this._setArgLocal(index, toSize(size));
+}
+
 //////////////////////////////
 //WebCLMappedRegion object
 //////////////////////////////
@@ -770,6 +1459,28 @@ cl.WebCLMemoryObject.prototype.getGLObjectInfo=function () {
   return this._getGLObjectInfo(); // returns a WebGLObjectInfo dictionary
 }
 
+//////////////////////////////
+//WebCLBufferArena object
+//////////////////////////////
+
+cl.WebCLBufferArena.prototype.release=function () {
+  return this._release();
+}
+
+// sub-buffer of at least size bytes. Releasing it returns its block to the
+// arena. flags default to those of the arena.
+cl.WebCLBufferArena.prototype.allocate=function (size, flags) {
+  if (!(arguments.length >= 1 && isSize(size) &&
+      (typeof flags === 'undefined' || typeof flags === 'number'))) {
+    throw new TypeError('Expected WebCLBufferArena.allocate(int size, optional CLenum flags)');
+  }
+  return this._allocate(toSize(size), flags);
+}
+
+cl.WebCLBufferArena.prototype.getStats=function () {
+  return this._getStats();
+}
+
 //////////////////////////////
 //WebCLBuffer object
 //////////////////////////////
@@ -782,6 +1493,8 @@ cl.WebCLBuffer.prototype.createSubBuffer=function (flags, type, region) {
   if (!(arguments.length === 3 && typeof flags === 'number' && typeof type === 'number' && typeof region === 'object')) {
     throw new TypeError('Expected WebCLMemoryObject.createSubBuffer(CLenum flags, CLenum type, WebCLRegion region)');
   }
+  if (typeof region.origin === 'bigint' || typeof region.size === 'bigint')
+    region = { origin: toSize(region.origin), size: toSize(region.size) };
   return this._createSubBuffer(flags, type, region);
 }
 
@@ -907,6 +1620,31 @@ cl.WebCLProgram.prototype.build=function (devices, options, data, callback) {
   return this._build(devices, options, data, callback);
 }
 
+// Builds on a worker thread, so drivers that block in clBuildProgram don't
+// stall the event loop and several programs build in parallel (up to
+// UV_THREADPOOL_SIZE). The promise resolves with
+//   { status, fromCache, devices: [ { device, status, log } ] }
+// and rejects with an Error carrying the same result as err.build.
+cl.WebCLProgram.prototype.buildAsync=function (devices, options) {
+  if (!((devices==null || typeof devices === 'object') &&
+      (options==null || typeof options === 'string'))) {
+    throw new TypeError('Expected WebCLProgram.buildAsync(optional WebCLDevice[] devices, optional String options)');
+  }
+  var program=this;
+  return new Promise(function (resolve, reject) {
+    program._buildAsync(devices, options, function (status, result) {
+      if(status===cl.SUCCESS)
+        resolve(result);
+      else {
+        var err=new Error(result.message);
+        err.code=status;
+        err.build=result;
+        reject(err);
+      }
+    });
+  });
+}
+
 cl.WebCLProgram.prototype.createKernel=function (name) {
   if (!(arguments.length === 1 && typeof name === 'string')) {
     throw new TypeError('Expected WebCLProgram.createKernel(String name)');
@@ -918,6 +1656,67 @@ cl.WebCLProgram.prototype.createKernelsInProgram=function () {
   return this._createKernelsInProgram();
 }
 
+// Kernel from the program's pool, created only if every kernel of that name
+// is in use. kernel.release() returns it to the pool with its arguments;
+// the released handle can't be used any more, the next user gets a new one.
+cl.WebCLProgram.prototype.acquireKernel=function (name) {
+  if (!(arguments.length === 1 && typeof name === 'string')) {
+    throw new TypeError('Expected WebCLProgram.acquireKernel(String name)');
+  }
+  return this._acquireKernel(name);
+}
+
+// Returns a variant of this program built with the given constants passed
+// as -D options, e.g. program.specialize({ TILE: 16, T: 'float' }), after
+// the options the program was built with, if any. Variants
+// are cached per program and option string, so specializing again with the
+// same constants returns the same program. If kernelName is given, a pooled
+// kernel of the variant is returned instead.
+cl.WebCLProgram.prototype.specialize=function (constants, kernelName) {
+  if (!((arguments.length === 1 || arguments.length === 2) &&
+      constants && typeof constants === 'object' && !isArray(constants) &&
+      (typeof kernelName === 'undefined' || typeof kernelName === 'string'))) {
+    throw new TypeError('Expected WebCLProgram.specialize(Object constants, optional String kernelName)');
+  }
+  var options = Object.keys(constants).sort().map(function (name) {
+    var value = constants[name];
+    if (!/^[A-Za-z_]\w*$/.test(name)) {
+      throw new TypeError('Invalid constant name ' + name);
+    }
+    if (typeof value === 'boolean') {
+      value = value ? 1 : 0;
+    }
+    else if (!((typeof value === 'number' && isFinite(value)) ||
+        (typeof value === 'string' && /^\S+$/.test(value)))) {
+      throw new TypeError('Invalid value for constant ' + name);
+    }
+    return '-D ' + name + '=' + value;
+  }).join(' ');
+  var variant = this._createVariant(options);
+  return kernelName === undefined ? variant : variant.acquireKernel(kernelName);
+}
+
+//////////////////////////////
+//WebCLRange object
+//////////////////////////////
+cl.WebCLRange.prototype.release=function () {
+  return this._release();
+}
+
+cl.WebCLRange.prototype.set=function () {
+  if (!(arguments.length >= 1 && arguments.length <= 3)) {
+    throw new TypeError('Expected WebCLRange.set(uint x, optional uint y, optional uint z) or WebCLRange.set(uint[] sizes)');
+  }
+  return this._set.apply(this, arguments);
+}
+
+cl.WebCLRange.prototype.get=function (index) {
+  if (!(arguments.length === 1 && typeof index === 'number')) {
+    throw new TypeError('Expected WebCLRange.get(uint index)');
+  }
+  return this._get(index);
+}
+
 //////////////////////////////
 //WebCLSampler object
 //////////////////////////////